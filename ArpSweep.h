@@ -0,0 +1,172 @@
+// ArpSweep.h
+// Descubrimiento de hosts por ARP en la red local (mismo segmento L2).
+// Envía ARP requests a ritmo fijo para todo el rango y va leyendo la tabla
+// etharp de lwIP. Encuentra también los equipos que ignoran el ping, y
+// devuelve su MAC.
+//
+// La tabla ARP de lwIP es pequeña (ARP_TABLE_SIZE, ~10 entradas) y las
+// respuestas nuevas desalojan a las viejas, así que se lee la tabla después
+// de cada petición: con el ritmo por defecto nunca llegan más respuestas
+// entre dos lecturas de las que caben.
+//
+// Las IPs van en uint32_t con el orden "humano" (a.b.c.d -> a<<24 | ...).
+#pragma once
+
+#include <Arduino.h>
+#include "lwip/sockets.h"
+#include "lwip/etharp.h"
+#include "lwip/tcpip.h"
+
+struct ArpHost {
+  uint32_t ip;
+  uint8_t mac[6];
+};
+
+class ArpSweep {
+public:
+  struct Stats {
+    uint32_t requests;
+    uint32_t found;
+    uint32_t requestErrors;
+    unsigned long elapsedMs;
+  };
+
+  uint16_t paceMs = 2;          // ms entre ARP requests
+  uint8_t passes = 2;           // la 2ª pasada sólo pregunta por los que faltan
+  uint16_t settleMs = 500;      // espera final para respuestas tardías
+
+  volatile bool *cancel = nullptr;
+
+  // Bitmap opcional (mismo formato que aliveBits): esos hosts se preguntan
+  // antes que el resto en cada pasada
+  const uint8_t *priority = nullptr;
+
+  // Progreso del barrido en curso (se puede leer desde otra tarea)
+  volatile uint32_t progress = 0;   // peticiones recorridas (todas las pasadas)
+  volatile uint32_t total = 0;
+  volatile uint32_t found = 0;
+
+  // aliveBits: bitmap de (count+7)/8 bytes a cero (bit i -> first32+i).
+  // hosts: hasta maxHosts entradas con IP+MAC, en orden de descubrimiento.
+  // Devuelve false si no hay interfaz de red.
+  bool run(uint32_t first32, uint32_t count, uint32_t skip32, uint8_t *aliveBits,
+           ArpHost *hosts, size_t maxHosts, Stats *stats = nullptr) {
+    memset(&_st, 0, sizeof(_st));
+    _first = first32;
+    _count = count;
+    _alive = aliveBits;
+    _hosts = hosts;
+    _maxHosts = maxHosts;
+    _nHosts = 0;
+    progress = 0;
+    total = count * passes;
+    found = 0;
+    unsigned long t0 = millis();
+    if (!netif_default) return false;
+
+    for (uint8_t pass = 0; pass < passes; ++pass) {
+      uint32_t done = 0;
+      // fase 0: hosts de 'priority'; fase 1: el resto
+      for (uint8_t phase = priority ? 0 : 1; phase < 2; ++phase) {
+        for (uint32_t i = 0; i < count; ++i) {
+          if (cancel && *cancel) break;
+          bool pri = priority && (priority[i >> 3] & (1 << (i & 7)));
+          if (pri != (phase == 0)) continue;
+          uint32_t ip = first32 + i;
+          progress = pass * count + ++done;
+          if (ip == skip32 || isAlive(i)) continue;
+          request(ip);
+          collect();
+          delay(paceMs);
+        }
+      }
+    }
+    unsigned long settleStart = millis();
+    while (millis() - settleStart < settleMs && !(cancel && *cancel)) {
+      collect();
+      delay(10);
+    }
+
+    _st.elapsedMs = millis() - t0;
+    if (stats) *stats = _st;
+    return true;
+  }
+
+  size_t hostCount() const { return _nHosts; }
+
+private:
+  struct RequestCall {
+    struct tcpip_api_call_data call;   // debe ir primero
+    uint32_t ip;
+  };
+  struct SnapshotCall {
+    struct tcpip_api_call_data call;
+    uint8_t n;
+    uint32_t ip[ARP_TABLE_SIZE];
+    uint8_t mac[ARP_TABLE_SIZE][6];
+  };
+
+  Stats _st;
+  uint32_t _first = 0;
+  uint32_t _count = 0;
+  uint8_t *_alive = nullptr;
+  ArpHost *_hosts = nullptr;
+  size_t _maxHosts = 0;
+  size_t _nHosts = 0;
+
+  bool isAlive(uint32_t i) const { return _alive[i >> 3] & (1 << (i & 7)); }
+
+  // etharp_* no es thread-safe: se ejecuta en el hilo tcpip
+  static err_t requestFn(struct tcpip_api_call_data *c) {
+    RequestCall *rc = (RequestCall *)c;
+    if (!netif_default) return -1;
+    ip4_addr_t a;
+    ip4_addr_set_u32(&a, htonl(rc->ip));
+    return etharp_request(netif_default, &a);
+  }
+
+  static err_t snapshotFn(struct tcpip_api_call_data *c) {
+    SnapshotCall *sc = (SnapshotCall *)c;
+    sc->n = 0;
+    for (size_t i = 0; i < ARP_TABLE_SIZE; ++i) {
+      ip4_addr_t *ip;
+      struct netif *nif;
+      struct eth_addr *eth;
+      if (!etharp_get_entry(i, &ip, &nif, &eth)) continue;   // sólo entradas estables
+      sc->ip[sc->n] = ntohl(ip4_addr_get_u32(ip));
+      memcpy(sc->mac[sc->n], eth->addr, 6);
+      sc->n++;
+    }
+    return 0;
+  }
+
+  bool request(uint32_t ip) {
+    RequestCall rc;
+    rc.ip = ip;
+    if (tcpip_api_call(requestFn, &rc.call) != ERR_OK) {
+      _st.requestErrors++;
+      return false;
+    }
+    _st.requests++;
+    return true;
+  }
+
+  void collect() {
+    SnapshotCall sc;
+    if (tcpip_api_call(snapshotFn, &sc.call) != ERR_OK) return;
+    for (uint8_t k = 0; k < sc.n; ++k) {
+      uint32_t ip = sc.ip[k];
+      if (ip < _first || ip - _first >= _count) continue;
+      uint32_t i = ip - _first;
+      if (isAlive(i)) continue;
+      _alive[i >> 3] |= (uint8_t)(1 << (i & 7));
+      _st.found++;
+      found = _st.found;
+      if (_nHosts < _maxHosts) {
+        _hosts[_nHosts].ip = ip;
+        memcpy(_hosts[_nHosts].mac, sc.mac[k], 6);
+        _nHosts++;
+      }
+    }
+  }
+};
@@ -0,0 +1,228 @@
+// CommandRouter.h
+// Comandos de Telegram en una tabla ordenada por nombre (en flash), común a
+// los sketches. El router:
+//   - busca el comando por búsqueda binaria, sin copiar ni pasar a
+//     minúsculas el texto (compara sin distinguir mayúsculas),
+//   - acepta "/cmd", "cmd" y "/cmd@nombre_del_bot",
+//   - da los argumentos como StrView (puntero + longitud) sobre el texto
+//     original: nada de String ni reservas de heap,
+//   - comprueba quién puede usar cada comando y su tiempo mínimo entre usos
+//     (a quien no es el dueño sólo le contestan los comandos CMD_CHAT),
+//   - genera /help con la tabla (las entradas sin ayuda son alias ocultos).
+//
+//   void cmdStatus(const CommandContext &ctx);
+//   constexpr Command COMMANDS[] = {    // ordenados por nombre, en minúsculas
+//     { "estado", cmdStatus, nullptr, "estado ahora", CMD_OWNER, 3 },
+//     { "status", cmdStatus, nullptr, nullptr, CMD_OWNER, 3 },    // alias
+//   };
+//   static_assert(commandsSorted(COMMANDS), "COMMANDS debe ir ordenada");
+//   CommandRouter<sizeof(COMMANDS) / sizeof(COMMANDS[0])> router(COMMANDS, reply);
+//   router.dispatch(upd.text, upd.chatId, upd.fromId, upd.fromName);
+#pragma once
+
+#include <Arduino.h>
+#include "TextBuffer.h"
+
+// ---- vista de texto (sin copia) ----
+
+struct StrView {
+  const char *p;
+  size_t n;
+
+  bool empty() const { return n == 0; }
+
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+  StrView trim() const {
+    size_t a = 0, b = n;
+    while (a < b && isSpace(p[a])) a++;
+    while (b > a && isSpace(p[b - 1])) b--;
+    return StrView{ p + a, b - a };
+  }
+
+  // Quita y devuelve la primera palabra; this queda con el resto (sin espacios delante)
+  StrView nextToken() {
+    StrView t = trim();
+    size_t k = 0;
+    while (k < t.n && !isSpace(t.p[k])) k++;
+    StrView tok{ t.p, k };
+    *this = StrView{ t.p + k, t.n - k }.trim();
+    return tok;
+  }
+
+  bool equalsNoCase(const char *s) const {
+    size_t k = 0;
+    for (; k < n && s[k]; ++k) {
+      if (tolower((unsigned char)p[k]) != s[k]) return false;
+    }
+    return k == n && s[k] == '\0';
+  }
+
+  // Número entero sin signo; false si hay algo más que dígitos o se sale
+  bool toULong(unsigned long &out) const {
+    if (n == 0 || n > 9) return false;
+    unsigned long v = 0;
+    for (size_t k = 0; k < n; ++k) {
+      if (p[k] < '0' || p[k] > '9') return false;
+      v = v * 10 + (p[k] - '0');
+    }
+    out = v;
+    return true;
+  }
+
+  // Copia terminada en '\0' (para APIs que la necesitan); false si no cabe
+  bool copyTo(char *out, size_t size) const {
+    if (n + 1 > size) return false;
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return true;
+  }
+};
+
+// ---- tabla de comandos ----
+
+// Quién puede usar el comando
+enum CommandAccess : uint8_t {
+  CMD_CHAT,     // cualquiera en el chat configurado (en un grupo, todos sus miembros)
+  CMD_OWNER     // sólo el usuario dueño (en un chat privado es el mismo)
+};
+
+struct CommandContext {
+  StrView args;             // lo que sigue al nombre, sin espacios alrededor
+  int64_t chatId;
+  int64_t fromId;
+  const char *fromName;
+};
+
+typedef void (*CommandHandler)(const CommandContext &ctx);
+
+struct Command {
+  const char *name;         // en minúsculas, sin '/'
+  CommandHandler handler;
+  const char *usage;        // argumentos para /help (nullptr = ninguno)
+  const char *help;         // nullptr = alias, no sale en /help
+  CommandAccess access;
+  uint16_t cooldownS;       // tiempo mínimo entre usos (0 = sin límite)
+};
+
+// Comparación de nombres en tiempo de compilación (C++11: recursiva)
+constexpr bool commandNameLess(const char *a, const char *b) {
+  return *a != *b ? (uint8_t)*a < (uint8_t)*b : (*a != '\0' && commandNameLess(a + 1, b + 1));
+}
+
+template <size_t N>
+constexpr bool commandsSorted(const Command (&t)[N], size_t i = 1) {
+  return i >= N || (commandNameLess(t[i - 1].name, t[i].name) && commandsSorted(t, i + 1));
+}
+
+template <size_t N>
+class CommandRouter {
+public:
+  enum Result { DONE, HELP, UNKNOWN, LIMITED, IGNORED };
+
+  int64_t chatId = 0;       // chat autorizado
+  int64_t ownerId = 0;      // usuario para CMD_OWNER (0 = todo el chat es dueño)
+  const char *title = "Comandos:";
+  const char *unknownText = "Comando desconocido. /help para ayuda.";
+
+  CommandRouter(const Command (&table)[N], bool (*reply)(const char *text)) : _t(table), _reply(reply) {}
+
+  // Ejecuta el comando del texto. Los mensajes de chats no autorizados, y
+  // los de otros usuarios salvo para comandos CMD_CHAT, se ignoran sin
+  // responder (no se delata el bot).
+  Result dispatch(const char *text, int64_t chat, int64_t from, const char *fromName) {
+    if (chat != chatId) return IGNORED;
+    bool owner = ownerId == 0 || from == ownerId;
+    CommandContext ctx;
+    ctx.args = StrView{ text, strlen(text) };
+    StrView name = ctx.args.nextToken();
+    if (name.n > 0 && name.p[0] == '/') name = StrView{ name.p + 1, name.n - 1 };
+    for (size_t k = 0; k < name.n; ++k) {
+      if (name.p[k] == '@') name.n = k;     // /cmd@bot en grupos
+    }
+    ctx.chatId = chat;
+    ctx.fromId = from;
+    ctx.fromName = fromName ? fromName : "";
+
+    int i = find(name);
+    if (i < 0) {
+      if (!owner) return IGNORED;
+      if (name.equalsNoCase("help") || name.equalsNoCase("ayuda")) {
+        sendHelp();
+        return HELP;
+      }
+      _reply(unknownText);
+      return UNKNOWN;
+    }
+    const Command &c = _t[i];
+    if (c.access == CMD_OWNER && !owner) return IGNORED;
+    if (c.cooldownS) {
+      int k = primary(i);               // los alias comparten el límite
+      unsigned long now = millis();
+      unsigned long wait = c.cooldownS * 1000UL;
+      if (_last[k] && now - _last[k] < wait) {
+        TextBuffer<80> msg;
+        msg.printf("Espera %lu s para repetir /%s.", (wait - (now - _last[k]) + 999) / 1000, _t[k].name);
+        _reply(msg.c_str());
+        return LIMITED;
+      }
+      _last[k] = now ? now : 1;
+    }
+    c.handler(ctx);
+    return DONE;
+  }
+
+  // Lista de comandos (sin alias) con sus argumentos y ayuda
+  template <class Out>
+  void printHelp(Out &out) const {
+    out.print(title);
+    for (size_t i = 0; i < N; ++i) {
+      if (!_t[i].help) continue;
+      out.printf("\n/%s", _t[i].name);
+      if (_t[i].usage) out.printf(" %s", _t[i].usage);
+      out.printf(" - %s", _t[i].help);
+    }
+    out.print("\n/help - mostrar esto");   // no va en la tabla
+  }
+
+private:
+  const Command *_t;
+  bool (*_reply)(const char *text);
+  unsigned long _last[N] = {};          // millis() del último uso (0 = nunca)
+
+  // Búsqueda binaria sin distinguir mayúsculas
+  int find(StrView name) const {
+    int lo = 0, hi = (int)N - 1;
+    while (lo <= hi) {
+      int mid = (lo + hi) / 2;
+      int c = compare(name, _t[mid].name);
+      if (c == 0) return mid;
+      if (c < 0) hi = mid - 1;
+      else lo = mid + 1;
+    }
+    return -1;
+  }
+
+  static int compare(StrView a, const char *b) {
+    for (size_t k = 0; k < a.n; ++k) {
+      uint8_t ca = (uint8_t)tolower((unsigned char)a.p[k]), cb = (uint8_t)b[k];
+      if (ca != cb) return ca < cb ? -1 : 1;   // incluye b acabado (cb == 0)
+    }
+    return b[a.n] == '\0' ? 0 : -1;
+  }
+
+  // Entrada con ayuda y el mismo handler (el comando "principal" de un alias)
+  int primary(int i) const {
+    if (_t[i].help) return i;
+    for (size_t k = 0; k < N; ++k) {
+      if (_t[k].handler == _t[i].handler && _t[k].help) return (int)k;
+    }
+    return i;
+  }
+
+  void sendHelp() {
+    TextBuffer<1024> msg;
+    printHelp(msg);
+    _reply(msg.c_str());
+  }
+};
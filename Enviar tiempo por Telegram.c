@@ -3,8 +3,12 @@
 
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include "TelegramOutbox.h"
+#include "TextBuffer.h"
+#include "SleepScheduler.h"
+#include "FastConnect.h"
+#include "WeatherRules.h"
 
 // ========== CONFIG (RELLENA) ==========
 const char* SSID = "SSID";
@@ -13,134 +17,463 @@ const char* PASS = "PASS";
 const char* TELEGRAM_BOT_TOKEN = "TOKEN"; // pon aquí el token nuevo
 const long   TELEGRAM_CHAT_ID  = CHAT_ID;                 // pon aquí tu chat_id numérico
 const char* OPENWEATHER_KEY = "KEY";
-const char* CIUDAD = "Madrid,ES";
-const unsigned long INTERVAL_MS = 60UL * 60UL * 1000UL; // 1 hora
+// IDs de ciudad de OpenWeather (el número de la URL en openweathermap.org/city/...)
+const uint32_t CIUDADES[] = {
+  3117735,  // Madrid
+  3128760,  // Barcelona
+  2509954,  // Valencia
+};
+const unsigned long INTERVAL_MS = 15UL * 60UL * 1000UL; // 15 min (en deep sleep entre consultas)
+const uint32_t FORECAST_REFRESH_S = 3UL * 3600UL;       // la previsión sólo se pide cada 3 h
+// Sólo se manda mensaje si salta (o termina) un aviso o el tiempo cambia de
+// verdad: temperatura, humedad o tipo de tiempo (despejado, nubes, lluvia...)
+const int16_t REPORT_TEMP_DELTA10 = 20;                 // 2,0 °C
+const uint8_t REPORT_HUMIDITY_DELTA = 15;               // puntos de humedad
+// Avisos por ciudad (ver WeatherRules.h): valor, horas (0 = ahora), nombre,
+// avisar también al terminar
+const WeatherRule REGLAS[] = {
+  { RULE_TEMP_ABOVE, 350, 0, "calor", true },               // ahora >= 35 °C
+  { RULE_TEMP_BELOW, 0, 12, "helada prevista", true },      // <= 0 °C en 12 h
+  { RULE_RAIN, 60, 6, "lluvia probable", true },            // prob. >= 60 % en 6 h
+  { RULE_HUMIDITY_CHANGE, 25, 0, "humedad", false },        // 25 puntos desde el último aviso
+};
 bool use_insecure = true; // en desarrollo true; en producción usa setCACert()
+// Servidor de OpenWeather (cambiable al compilar, p. ej. por uno de pruebas local)
+#ifndef OPENWEATHER_HOST
+#define OPENWEATHER_HOST "api.openweathermap.org"
+#endif
+#ifndef OPENWEATHER_PORT
+#define OPENWEATHER_PORT 443
+#endif
 // =======================================
 
-// ----------------- utility: urlencode (declarada antes de usar) -----------------
-String urlencode(const String &str) {
-  String encoded = "";
-  char buf[4];
-  for (size_t i = 0; i < str.length(); i++) {
-    char c = str[i];
-    if ( ('a' <= c && c <= 'z') ||
-         ('A' <= c && c <= 'Z') ||
-         ('0' <= c && c <= '9') ) {
-      encoded += c;
-    } else if (c == ' ') {
-      encoded += '+';
-    } else {
-      sprintf(buf, "%%%02X", (uint8_t)c);
-      encoded += buf;
-    }
+// ----------------- send Telegram (cola en segundo plano) -----------------
+TelegramOutbox outbox; // tarea de fondo con conexión keep-alive a api.telegram.org
+
+// Encola el mensaje y vuelve enseguida; la tarea lo envía (con reintentos)
+bool sendTelegramMessage(const char *text) {
+  if (!outbox.send(TELEGRAM_CHAT_ID, text)) {
+    Serial.println("Telegram: cola llena, mensaje descartado");
+    return false;
   }
-  return encoded;
+  return true;
 }
 
-// ----------------- send Telegram (usa urlencode) -----------------
-bool sendTelegramMessage(const String &text) {
-  WiFiClientSecure client;
+// ----------------- red: conexión rápida y caché DNS -----------------
+RTC_DATA_ATTR FastConnect::State netState;   // BSSID/canal del último AP
+RTC_DATA_ATTR DnsCache::State dnsState;      // IPs de OpenWeather y Telegram
+FastConnect net(netState);
+DnsCache dns(dnsState);
+
+// ----------------- HTTP GET helper -----------------
+// GET por HTTPS conectando a la IP de la caché DNS (con el nombre para SNI).
+// Deja 'client' al principio del cuerpo para leerlo en streaming.
+// HTTP/1.0 para que el servidor no use chunked.
+bool httpGetBegin(const char* host, const char* pathQuery, WiFiClientSecure &client) {
   if (use_insecure) client.setInsecure();
-  HTTPClient https;
-  String url = String("https://api.telegram.org/bot") + TELEGRAM_BOT_TOKEN + "/sendMessage";
-  if (!https.begin(client, url)) {
-    Serial.println("Telegram: HTTPS begin failed");
+  IPAddress ip;
+  if (!dns.resolve(host, ip)) {
+    Serial.println("DNS failed");
+    return false;
+  }
+  if (!client.connect(ip, OPENWEATHER_PORT, host, nullptr, nullptr, nullptr)) {
+    Serial.println("HTTPS connect failed");
+    dns.forget(host);
+    return false;
+  }
+  TextBuffer<512> req;
+  req.printf("GET %s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n", pathQuery, host);
+  netMarkFirstByte();
+  if (req.truncated() || client.write((const uint8_t *)req.c_str(), req.length()) != req.length()) {
+    Serial.println("GET write failed");
     return false;
   }
-  https.addHeader("Content-Type", "application/x-www-form-urlencoded");
-  String body = "chat_id=" + String(TELEGRAM_CHAT_ID) + "&text=" + urlencode(text);
-  int code = https.POST(body);
-  String resp = https.getString();
-  Serial.printf("Telegram code=%d resp=%s\n", code, resp.c_str());
-  https.end();
-  return (code == 200 || code == 201);
+
+  client.setTimeout(10000);
+  char status[48];
+  size_t n = client.readBytesUntil('\n', status, sizeof(status) - 1);
+  status[n] = '\0';
+  const char *code = strchr(status, ' ');
+  if (!code || atoi(code + 1) != 200) {
+    Serial.printf("GET failed: %s\n", status);
+    return false;
+  }
+  return client.find("\r\n\r\n");   // fin de cabeceras
 }
 
-// ----------------- HTTP GET helper -----------------
-String httpGet(const char* host, const char* pathQuery) {
+// ----------------- varias ciudades -----------------
+// Se piden por lotes con /data/2.5/group (hasta 20 IDs por petición) y se
+// parsea la lista ciudad a ciudad desde el socket. De cada ciudad se guarda
+// la última lectura y la última que se informó: sólo entran en el informe
+// las que se alejan de esta lo bastante (REPORT_*).
+const size_t N_CIUDADES = sizeof(CIUDADES) / sizeof(CIUDADES[0]);
+const size_t GROUP_MAX = 20;   // límite de IDs del endpoint group
+
+struct CityReading {
+  uint32_t dt;          // hora de la observación en OpenWeather (0 = nunca)
+  int16_t temp10;       // décimas de °C
+  int16_t feels10;
+  uint8_t humidity;
+  uint8_t kind;         // tipo de tiempo (weatherKind)
+  char name[24];
+  // lo último que se informó
+  bool reported;
+  int16_t repTemp10;
+  uint8_t repHumidity;
+  uint8_t repKind;
+};
+RTC_DATA_ATTR CityReading cityCache[N_CIUDADES];   // se conserva en deep sleep
+
+// Sólo para el informe de este despertar (en RAM, no ocupan RTC)
+char cityDesc[N_CIUDADES][32];
+bool cityChanged[N_CIUDADES];   // lectura nueva que se aleja de lo informado
+size_t citiesChanged = 0;
+size_t citiesSame = 0;
+size_t alertsFired = 0;
+
+int cityIndex(uint32_t id) {
+  for (size_t i = 0; i < N_CIUDADES; ++i) {
+    if (CIUDADES[i] == id) return (int)i;
+  }
+  return -1;
+}
+
+// Tipo de tiempo a partir del id de OpenWeather: el grupo (2 tormenta,
+// 3 llovizna, 5 lluvia, 6 nieve, 7 niebla...) y 800 despejado / 80x nubes
+uint8_t weatherKind(uint16_t id) {
+  return id > 800 ? 9 : (uint8_t)(id / 100);
+}
+
+// Una ciudad de la lista: actualiza la caché y la marca si cambió lo
+// bastante desde el último informe (la línea se escribe después)
+void handleCity(JsonDocument &city) {
+  int i = cityIndex(city["id"] | 0UL);
+  if (i < 0) return;
+  CityReading &c = cityCache[i];
+  uint32_t dt = city["dt"] | 0UL;
+  if (dt != 0 && dt == c.dt) {   // misma observación que la última vez
+    citiesSame++;
+    return;
+  }
+  float temp = city["main"]["temp"] | 0.0;
+  float feels = city["main"]["feels_like"] | 0.0;
+  c.dt = dt;
+  c.temp10 = (int16_t)lroundf(temp * 10);
+  c.feels10 = (int16_t)lroundf(feels * 10);
+  c.humidity = (uint8_t)(city["main"]["humidity"] | 0);
+  c.kind = weatherKind(city["weather"][0]["id"] | 0);
+  strlcpy(c.name, city["name"] | "??", sizeof(c.name));
+  strlcpy(cityDesc[i], city["weather"][0]["description"] | "sin datos", sizeof(cityDesc[i]));
+  bool changed = !c.reported || abs(c.temp10 - c.repTemp10) >= REPORT_TEMP_DELTA10 ||
+                 abs((int)c.humidity - c.repHumidity) >= REPORT_HUMIDITY_DELTA || c.kind != c.repKind;
+  if (!changed) {
+    citiesSame++;
+    return;
+  }
+  citiesChanged++;
+  cityChanged[i] = true;
+}
+
+// Pide un lote de ciudades y procesa la respuesta. false si falló.
+bool fetchGroup(size_t first, size_t count) {
+  TextBuffer<320> path;
+  path.print("/data/2.5/group?id=");
+  for (size_t i = 0; i < count; ++i) path.printf("%s%lu", i ? "," : "", (unsigned long)CIUDADES[first + i]);
+  path.printf("&units=metric&lang=es&appid=%s", OPENWEATHER_KEY);
+
   WiFiClientSecure client;
-  if (use_insecure) client.setInsecure();
-  HTTPClient https;
-  String url = String("https://") + host + pathQuery;
-  if (!https.begin(client, url)) {
-    Serial.println("HTTPS begin failed");
-    return "";
-  }
-  int httpCode = https.GET();
-  String payload = "";
-  if (httpCode > 0) {
-    payload = https.getString();
-  } else {
-    Serial.printf("GET failed, error: %s\n", https.errorToString(httpCode).c_str());
+  if (!httpGetBegin(OPENWEATHER_HOST, path.c_str(), client)) return false;
+  if (!client.find("\"list\":[")) return false;
+
+  // sólo los campos que se usan: el resto del JSON ni se guarda
+  StaticJsonDocument<256> filter;
+  filter["id"] = true;
+  filter["dt"] = true;
+  filter["name"] = true;
+  filter["main"]["temp"] = true;
+  filter["main"]["feels_like"] = true;
+  filter["main"]["humidity"] = true;
+  filter["weather"][0]["id"] = true;
+  filter["weather"][0]["description"] = true;
+
+  StaticJsonDocument<512> city;
+  bool ok = true;
+  if (client.peek() != ']') {
+    do {
+      DeserializationError err = deserializeJson(city, client, DeserializationOption::Filter(filter));
+      if (err) {
+        Serial.print("JSON parse error: "); Serial.println(err.c_str());
+        ok = false;
+        break;
+      }
+      handleCity(city);
+    } while (client.findUntil(",", "]"));   // ',' -> otra ciudad; ']' -> fin
   }
-  https.end();
-  return payload;
+  client.stop();
+  return ok;
 }
 
-unsigned long lastSend = 0;
+// ----------------- previsión y avisos -----------------
+// La previsión (pasos de 3 h) se pide por ciudad sólo cada
+// FORECAST_REFRESH_S y se guarda en RTC; las reglas se evalúan en cada
+// despertar con la lectura actual y esa previsión, sin más peticiones.
+const uint8_t FORECAST_STEPS = 8;   // 24 h
 
-void setup() {
-  Serial.begin(115200);
-  delay(200);
-  Serial.println("Inicio ESP32-C3 Weather->Telegram (corregido)");
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(SSID, PASS);
-  Serial.print("Conectando WiFi");
-  unsigned long start = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - start < 20000) {
-    Serial.print('.');
-    delay(300);
-  }
-  Serial.println();
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("WiFi conectado.");
-    Serial.print("IP: "); Serial.println(WiFi.localIP());
-  } else {
-    Serial.println("ERROR: no conectado a WiFi.");
+struct CityForecast {
+  uint32_t fetchedAt;   // dt de la observación cuando se pidió (0 = nunca)
+  int32_t tzOffset;     // s respecto a UTC, para la hora local de los avisos
+  uint8_t n;
+  ForecastStep steps[FORECAST_STEPS];
+};
+const size_t N_REGLAS = sizeof(REGLAS) / sizeof(REGLAS[0]);
+RTC_DATA_ATTR CityForecast forecastCache[N_CIUDADES];
+RTC_DATA_ATTR RuleState ruleState[N_CIUDADES][N_REGLAS];
+WeatherRules rules(REGLAS);
+
+// Pide la previsión de una ciudad y la deja en la caché. false si falló
+// (la caché anterior se queda como estaba).
+bool fetchForecast(size_t i) {
+  TextBuffer<192> path;
+  path.printf("/data/2.5/forecast?id=%lu&units=metric&cnt=%u&appid=%s", (unsigned long)CIUDADES[i],
+              (unsigned)FORECAST_STEPS, OPENWEATHER_KEY);
+
+  WiFiClientSecure client;
+  if (!httpGetBegin(OPENWEATHER_HOST, path.c_str(), client)) return false;
+  if (!client.find("\"list\":[")) return false;
+
+  StaticJsonDocument<192> filter;
+  filter["dt"] = true;
+  filter["main"]["temp"] = true;
+  filter["main"]["humidity"] = true;
+  filter["pop"] = true;
+  filter["rain"]["3h"] = true;
+
+  CityForecast fc = {};
+  StaticJsonDocument<256> step;
+  if (client.peek() != ']') {
+    do {
+      DeserializationError err = deserializeJson(step, client, DeserializationOption::Filter(filter));
+      if (err) {
+        Serial.print("JSON parse error: "); Serial.println(err.c_str());
+        client.stop();
+        return false;
+      }
+      if (fc.n >= FORECAST_STEPS) continue;
+      ForecastStep &s = fc.steps[fc.n++];
+      s.dt = step["dt"] | 0UL;
+      s.temp10 = (int16_t)lroundf((step["main"]["temp"] | 0.0) * 10);
+      s.humidity = (uint8_t)(step["main"]["humidity"] | 0);
+      s.pop = (uint8_t)lroundf((step["pop"] | 0.0) * 100);
+      s.rain10 = (uint16_t)lroundf((step["rain"]["3h"] | 0.0) * 10);
+    } while (client.findUntil(",", "]"));
   }
+  // "city" va detrás de "list": de ahí sólo la zona horaria
+  if (client.find("\"timezone\":")) fc.tzOffset = client.parseInt();
+  client.stop();
+  fc.fetchedAt = cityCache[i].dt;
+  forecastCache[i] = fc;
+  return true;
 }
 
-void loop() {
-  unsigned long now = millis();
-  if (now - lastSend < INTERVAL_MS) {
-    delay(200);
-    return;
+// Renueva las previsiones caducadas de las ciudades con datos. false si
+// alguna no se pudo pedir (se sigue con la anterior).
+bool refreshForecasts() {
+  bool ok = true;
+  for (size_t i = 0; i < N_CIUDADES; ++i) {
+    const CityReading &c = cityCache[i];
+    if (c.dt == 0) continue;   // todavía sin lectura
+    const CityForecast &fc = forecastCache[i];
+    if (fc.fetchedAt != 0 && c.dt - fc.fetchedAt < FORECAST_REFRESH_S) continue;
+    if (!fetchForecast(i)) {
+      Serial.printf("ERROR: sin previsión para %s\n", c.name);
+      ok = false;
+    }
   }
+  return ok;
+}
 
-  String path = String("/data/2.5/weather?q=") + CIUDAD + "&units=metric&lang=es&appid=" + OPENWEATHER_KEY;
-  String body = httpGet("api.openweathermap.org", path.c_str());
-  if (body.length() == 0) {
-    Serial.println("ERROR: respuesta vacía de OpenWeather.");
-    lastSend = now;
-    return;
+// ----------------- ciclo con deep sleep -----------------
+// Cada INTERVAL_MS: despertar, conectar, consultar, evaluar los avisos,
+// enviar si hay algo y volver a dormir. Entre consultas el chip está en deep
+// sleep (radio y CPU apagadas).
+const unsigned long RETRY_MS = 5UL * 60UL * 1000UL;   // si falla WiFi o la consulta
+const unsigned long WIFI_TIMEOUT_MS = 15000;
+const unsigned long FLUSH_TIMEOUT_MS = 20000;         // espera a que salga el mensaje
+
+RTC_DATA_ATTR SleepScheduler::State sleepState;       // se conserva en deep sleep
+SleepScheduler sched(sleepState);
+
+// Todo lo que va en RTC_DATA_ATTR tiene que caber en la RTC del ESP32-C3
+// (8 KB, compartidos con IDF). Unos 170 B por ciudad: con muchas, recortar
+// FORECAST_STEPS o la lista.
+const size_t RTC_BUDGET = 6 * 1024;
+static_assert(sizeof(cityCache) + sizeof(forecastCache) + sizeof(ruleState) + sizeof(netState) +
+                  sizeof(dnsState) + sizeof(sleepState) <= RTC_BUDGET,
+              "demasiadas ciudades para la memoria RTC");
+
+// Copia de lo que se da por informado al empezar, para deshacerlo
+CityReading cityBefore[N_CIUDADES];
+RuleState rulesBefore[N_CIUDADES][N_REGLAS];
+
+// El informe no se entregó: ciudades y avisos volverán a salir en el reintento
+void forgetReportedCities() {
+  memcpy(cityCache, cityBefore, sizeof(cityCache));
+  memcpy(ruleState, rulesBefore, sizeof(ruleState));
+}
+
+// ----------------- informe por partes -----------------
+// El informe se encola en mensajes de hasta TEXT_MAX bytes según se
+// escribe, así no hace falta un buffer para todas las ciudades. Cada bloque
+// entra entero en una parte; lo que no llega a encolarse no se da por
+// informado.
+const size_t ALERT_LINE_MAX = 112;   // línea de aviso más larga (nombre de 23 + etiqueta)
+TextBuffer<TelegramOutbox::TEXT_MAX + 1> reportPart;
+size_t reportParts = 0;
+
+bool reportFlush() {
+  if (reportPart.length() == 0) return true;
+  // la cola tiene SLOTS mensajes: si está llena, esperar a que salgan
+  if (outbox.pending() >= TelegramOutbox::SLOTS && !outbox.flush(FLUSH_TIMEOUT_MS)) return false;
+  Serial.print("-> ");
+  Serial.println(reportPart.c_str());
+  if (!sendTelegramMessage(reportPart.c_str())) return false;
+  reportParts++;
+  reportPart.clear();
+  return true;
+}
+
+// Añade un bloque (una o varias líneas); false si no se pudo encolar
+bool reportAdd(const char *text) {
+  size_t n = strlen(text);
+  if (n > reportPart.capacity()) return false;
+  if (reportPart.length() + n > reportPart.capacity() && !reportFlush()) return false;
+  reportPart.print(text);
+  return true;
+}
+
+// Evalúa las reglas de cada ciudad con datos y añade sus avisos. Si no se
+// pueden encolar, las reglas de esa ciudad vuelven a como estaban.
+bool reportAlerts() {
+  bool ok = true;
+  for (size_t i = 0; i < N_CIUDADES; ++i) {
+    const CityReading &c = cityCache[i];
+    if (c.dt == 0) continue;
+    const CityForecast &fc = forecastCache[i];
+    TextBuffer<16 + N_REGLAS * ALERT_LINE_MAX> lines;
+    if (alertsFired == 0) lines.print("Avisos:\n");
+    WeatherNow now = { c.dt, c.temp10, c.humidity };
+    uint8_t n = rules.evaluate(c.name, now, fc.steps, fc.n, fc.tzOffset, ruleState[i], lines);
+    if (n == 0) continue;
+    if (lines.truncated() || !reportAdd(lines.c_str())) {
+      memcpy(ruleState[i], rulesBefore[i], sizeof(ruleState[i]));
+      ok = false;
+      continue;
+    }
+    alertsFired += n;
   }
+  return ok;
+}
 
-  StaticJsonDocument<1024> doc;
-  DeserializationError err = deserializeJson(doc, body);
-  if (err) {
-    Serial.print("JSON parse error: "); Serial.println(err.c_str());
-    lastSend = now;
-    return;
+// Añade una línea por ciudad que cambió; sólo las que se encolan quedan
+// como informadas
+bool reportChanges() {
+  size_t written = 0;
+  for (size_t i = 0; i < N_CIUDADES; ++i) {
+    if (!cityChanged[i]) continue;
+    CityReading &c = cityCache[i];
+    TextBuffer<160> line;
+    if (written == 0) line.print("Tiempo:\n");
+    line.printf("%s: %s, %.1f°C (sensación %.1f°C), humedad %u%%\n", c.name, cityDesc[i],
+                c.temp10 / 10.0, c.feels10 / 10.0, (unsigned)c.humidity);
+    if (!reportAdd(line.c_str())) return false;
+    c.reported = true;
+    c.repTemp10 = c.temp10;
+    c.repHumidity = c.humidity;
+    c.repKind = c.kind;
+    written++;
   }
+  return true;
+}
 
-  const char* name = doc["name"] | "??";
-  float temp = doc["main"]["temp"] | 0.0;
-  float feels = doc["main"]["feels_like"] | 0.0;
-  int humidity = doc["main"]["humidity"] | 0;
-  const char* desc = doc["weather"][0]["description"] | "sin datos";
+// Consulta todas las ciudades, evalúa los avisos y encola el informe con
+// los avisos y las ciudades que han cambiado (nada si no hay ninguno), en
+// tantos mensajes como haga falta. false si algo falló; 'queued' indica si
+// se encoló algo.
+bool reportWeather(bool &queued) {
+  queued = false;
+  reportPart.clear();
+  reportParts = 0;
+  citiesChanged = citiesSame = alertsFired = 0;
+  memset(cityChanged, 0, sizeof(cityChanged));
+  memcpy(cityBefore, cityCache, sizeof(cityCache));
+  memcpy(rulesBefore, ruleState, sizeof(ruleState));
+  bool ok = true;
+  for (size_t first = 0; first < N_CIUDADES; first += GROUP_MAX) {
+    size_t count = N_CIUDADES - first < GROUP_MAX ? N_CIUDADES - first : GROUP_MAX;
+    if (!fetchGroup(first, count)) {
+      Serial.println("ERROR: sin respuesta válida de OpenWeather.");
+      ok = false;   // se sigue con los demás lotes; lo que falte, en el reintento
+    }
+  }
+  // todas las peticiones antes de encolar nada: una sola conexión TLS a la vez
+  if (!refreshForecasts()) ok = false;
 
-  String mensaje = String("Tiempo en ") + name + ": " + desc + ". ";
-  mensaje += String("T=") + String(temp,1) + "°C (sensación " + String(feels,1) + "°C). ";
-  mensaje += "Humedad " + String(humidity) + "%.";
+  bool sent = reportAlerts();
+  sent = sent && reportChanges();
+  if (sent && alertsFired == 0 && citiesChanged == 0) {
+    Serial.printf("Sin cambios ni avisos (%u ciudades), no se envía nada\n", (unsigned)citiesSame);
+    return ok;
+  }
+  if (sent) {
+    TextBuffer<256> tail;
+    if (citiesChanged && citiesSame) tail.printf("(%u sin cambios)\n", (unsigned)citiesSame);
+    tail.printf("Red: WiFi %lu ms (%s), primer byte a %lu ms.", net.connectMs(),
+                net.lastWasFast() ? "rápida" : "completa", netFirstByteMs());
+    if (sched.cycles() > 0) {
+      tail.print("\n");
+      sched.printTo(tail);   // ciclo de trabajo y energía del ciclo anterior
+    }
+    sent = reportAdd(tail.c_str()) && reportFlush();
+  }
+  queued = reportParts > 0;
+  if (!sent) {
+    Serial.println("Fallo envío Telegram");
+    forgetReportedCities();   // lo ya encolado puede repetirse en el reintento
+    return false;
+  }
+  Serial.printf("Encolado OK (%u mensajes)\n", (unsigned)reportParts);
+  return ok;
+}
 
-  Serial.println("-> " + mensaje);
-  if (sendTelegramMessage(mensaje)) {
-    Serial.println("Enviado OK");
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Inicio ESP32-C3 Weather->Telegram (deep sleep)");
+  sched.begin();
+  sharedDnsCache() = &dns;          // también para la conexión de Telegram
+  outbox.begin(TELEGRAM_BOT_TOKEN);
+  Serial.println("Conectando WiFi");
+
+  bool ok = false;
+  if (net.connect(SSID, PASS, WIFI_TIMEOUT_MS)) {
+    Serial.printf("WiFi conectado en %lu ms (%s). IP: ", net.connectMs(), net.lastWasFast() ? "BSSID guardado" : "completo");
+    Serial.println(WiFi.localIP());
+    bool queued;
+    ok = reportWeather(queued);
+    // no dormir con el mensaje todavía en la cola
+    if (queued && (!outbox.flush(FLUSH_TIMEOUT_MS) || outbox.stats().sent == 0)) {
+      Serial.println("Telegram no confirmó el envío a tiempo");
+      forgetReportedCities();
+      ok = false;
+    }
   } else {
-    Serial.println("Fallo envío Telegram");
+    Serial.println("ERROR: no conectado a WiFi.");
   }
 
-  lastSend = now;
+  Serial.printf("Despierto %lu ms, a dormir\n", millis());
+  Serial.flush();
+  sched.sleep(ok ? INTERVAL_MS : RETRY_MS);   // no vuelve: al despertar empieza en setup()
 }
 
+void loop() {
+  // no se llega aquí: setup() termina siempre en deep sleep
+}
@@ -1,24 +1,77 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
-#include <HTTPClient.h>
-#include <ESPping.h>     // ESPping library
+#include <Preferences.h>
+#include "IcmpSweep.h"   // barrido ICMP concurrente (lwIP raw)
+#include "ArpSweep.h"    // descubrimiento por ARP (red local)
+#include "TelegramOutbox.h"
+#include "TelegramPoller.h"
+#include "TelegramUpdateParser.h"
+#include "TelegramWebhook.h"  // comandos por POST (opcional, en vez del long-poll)
+#include "TextBuffer.h"     // mensajes en buffers fijos (sin String)
+#include "HeapMetrics.h"    // heap, fragmentación y pilas para 'estado'
+#include "FastConnect.h"    // conexión WiFi rápida y caché DNS
+#include "KnownHosts.h"     // hosts del último escaneo (en NVS) para informar de cambios
+#include "PortScan.h"       // connect() TCP concurrentes para 'puertos'
+#include "HostNames.h"      // nombres por DNS inverso, mDNS y NetBIOS (con caché)
+#include "CommandRouter.h"  // tabla de comandos, /help, permisos y límites
+#include "MetricsServer.h"  // /metrics para Prometheus (opcional)
 
 const char* SSID = "SSID";
 // Si tu contraseña contiene una barra invertida '\' -> usa doble '\\'
 const char* PASS = "PASS";
 const char* TELEGRAM_BOT_TOKEN = "TOKEN"; // pon aquí el token nuevo
 const long   TELEGRAM_CHAT_ID  = CHAT_ID; 
+// Webhook (opcional): 0 = long-poll de getUpdates. Con un puerto, los
+// comandos llegan por POST desde un proxy inverso con HTTPS (ver
+// TelegramWebhook.h) y no se hace ninguna petición mientras no hay mensajes.
+const uint16_t WEBHOOK_PORT = 0;
+const char* WEBHOOK_PATH = "/tg";
+const char* WEBHOOK_SECRET = "";          // secret_token de setWebhook (obligatorio: sin él no arranca)
+// Endpoint /metrics para Prometheus (ver MetricsServer.h): 0 = desactivado
+const uint16_t METRICS_PORT = 0;          // p. ej. 9100
+// Puertos que prueba 'puertos <ip|all>' (máx. 32: un bit por puerto)
+const uint16_t PUERTOS[] = { 21, 22, 23, 25, 53, 80, 110, 139, 143, 443, 445, 554,
+                             1883, 3306, 3389, 5000, 5900, 8080, 8443, 8883 };
 // ------------------------------------------------
 
-WiFiClientSecure tlsClient;
-unsigned long lastTelegramCheck = 0;
-const unsigned long TELEGRAM_POLL_INTERVAL = 3000; // ms
+TelegramOutbox outbox;    // cola de envío con tarea propia (no bloquea)
+TelegramLongPoll poller;  // getUpdates long-poll en su propia conexión
+TelegramUpdateParser updParser;
+TelegramWebhook hook;     // si WEBHOOK_PORT: servidor HTTP en lugar del long-poll
+const uint16_t LONG_POLL_TIMEOUT_S = 25; // s que Telegram retiene getUpdates sin updates
 long lastUpdateId = 0; // offset para getUpdates
 
+HeapMetrics heapMon;
+AllocCounter sendAllocs;  // heap en el camino de envío (tarea de la cola)
+AllocCounter pollAllocs;  // heap al atender cada respuesta de getUpdates
+const unsigned long HEAP_CHECK_MS = 5000;
+unsigned long lastHeapCheck = 0;
+MetricsServer<6144> metrics;  // página de /metrics en un buffer fijo
+
+// Red: BSSID/canal del último AP e IPs ya resueltas (en RTC, ver FastConnect.h)
+RTC_DATA_ATTR FastConnect::State netState;
+RTC_DATA_ATTR DnsCache::State dnsState;
+FastConnect net(netState);
+DnsCache dns(dnsState);
+
 // CONTROL DE ESCANEOS
-volatile bool scanning = false;        // bloqueo para evitar escaneos concurrentes
+volatile bool scanning = false;        // hay una tarea de escaneo en marcha
 bool scannedOnConnect = false;         // para evitar re-escaneo al reconectar varias veces
 unsigned long lastScanMillis = 0;
+IcmpSweep sweep;                       // ventana de pings en vuelo (ajustable: sweep.window, sweep.retries)
+ArpSweep arpSweep;                     // ARP requests a ritmo fijo (ajustable: arpSweep.paceMs)
+const size_t MAX_ARP_HOSTS = 512;      // hosts con MAC que se guardan para el informe
+Preferences prefs;
+KnownHosts known;                      // vivos en el último escaneo: se sondean primero
+
+PortScan portScan;                     // ventana de connect() en vuelo (ajustable: portScan.window)
+const size_t N_PUERTOS = sizeof(PUERTOS) / sizeof(PUERTOS[0]);
+static_assert(N_PUERTOS <= PortScan::MAX_PORTS, "PUERTOS: máximo PortScan::MAX_PORTS (32) puertos");
+const size_t MAX_PORT_HOSTS = 256;     // hosts como máximo en 'puertos all'
+HostNames names;                       // nombres de los hosts vivos, con TTL entre escaneos
+const uint8_t NAMES_BUDGET_PCT = 25;   // los nombres alargan el escaneo como mucho un 25 %
+
+enum ScanMode { SCAN_ICMP, SCAN_ARP, SCAN_PORTS };
 const unsigned long MIN_SCAN_INTERVAL_MS = 60UL * 1000UL; // cooldown mínimo entre escaneos (60s)
 
 // helpers para IP <-> uint32
@@ -29,64 +82,149 @@ IPAddress uint32ToIP(uint32_t v) {
   return IPAddress((uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v);
 }
 
-// URL-encode (básico)
-String urlEncode(const String &str) {
-  String encoded = "";
-  char c;
-  char buf[5];
-  for (size_t i = 0; i < str.length(); i++) {
-    c = str[i];
-    if ( (c >= '0' && c <= '9') ||
-         (c >= 'a' && c <= 'z') ||
-         (c >= 'A' && c <= 'Z') ||
-         c == '-' || c == '_' || c == '.' || c == '~') {
-      encoded += c;
-    } else if (c == ' ') {
-      encoded += "%20";
-    } else {
-      snprintf(buf, sizeof(buf), "%%%02X", (unsigned char)c);
-      encoded += buf;
-    }
-  }
-  return encoded;
+// Enviar mensaje simple a Telegram: se encola y lo envía la tarea de fondo
+// (une mensajes seguidos, respeta el límite por chat y reintenta)
+bool telegramSendMessage(const char *text) {
+  return outbox.send(TELEGRAM_CHAT_ID, text);
 }
 
-// Enviar mensaje simple a Telegram
-bool telegramSendMessage(const String &text) {
-  HTTPClient http;
-  String url = String("https://api.telegram.org/bot") + TELEGRAM_BOT_TOKEN +
-               "/sendMessage?chat_id=" + String(TELEGRAM_CHAT_ID) + "&text=" + urlEncode(text);
+// Mensajes de respuesta: caben en un mensaje de la cola
+typedef TextBuffer<TelegramOutbox::TEXT_MAX + 1> Message;
 
-  tlsClient.setInsecure(); // no validar cert (más simple). Considera usar CA si quieres validar.
-  http.begin(tlsClient, url);
-  int code = http.GET();
-  String payload = http.getString();
-  http.end();
-  return (code >= 200 && code < 300);
+int compareArpHost(const void *a, const void *b) {
+  uint32_t ia = ((const ArpHost *)a)->ip, ib = ((const ArpHost *)b)->ip;
+  return ia < ib ? -1 : (ia > ib ? 1 : 0);
 }
 
-// Lanza escaneo de la subred obteniendo máscara desde WiFi
-// Nota: función bloqueante (como antes). Está protegida por 'scanning' y por cooldown.
-void scanSubnetAndNotify() {
-  // Si ya está en escaneo, no hacemos nada.
-  if (scanning) return;
+// MAC de un host ya descubierto por ARP (hosts ordenado por IP), o nullptr
+const uint8_t *findArpMac(const ArpHost *hosts, size_t n, uint32_t ip) {
+  ArpHost key;
+  key.ip = ip;
+  const ArpHost *h = (const ArpHost *)bsearch(&key, hosts, n, sizeof(ArpHost), compareArpHost);
+  return h ? h->mac : nullptr;
+}
 
-  // cooldown
-  unsigned long now = millis();
-  if ((now - lastScanMillis) < MIN_SCAN_INTERVAL_MS) {
-    unsigned long waitMs = MIN_SCAN_INTERVAL_MS - (now - lastScanMillis);
-    telegramSendMessage("Espera " + String((waitMs + 999) / 1000) + " s antes de volver a escanear.");
-    return;
-  }
+// " (nombre, MAC)" de un host si se conoce algo de eso
+void printHostInfo(Message &msg, uint32_t ip, const uint8_t *mac) {
+  const char *name = names.name(ip);
+  if (!name && !mac) return;
+  msg.print(" (");
+  if (name) msg.print(name);
+  if (name && mac) msg.print(", ");
+  if (mac) msg.printMac(mac);
+  msg.print(")");
+}
 
-  scanning = true;
-  lastScanMillis = now;
+// Trabajo que loop() entrega a la tarea de escaneo
+struct ScanJob {
+  ScanMode mode;
+  uint32_t first32;
+  uint32_t count;
+  uint32_t skip32;          // nuestra IP
+  uint8_t *aliveBits;       // bitmap (count+7)/8, lo libera loop() al recibir el resultado
+  ArpHost *arpHosts;        // sólo en modo ARP
+  size_t maxArp;
+  uint32_t *targets;        // sólo en modo puertos: count IPs
+  uint32_t *openMasks;      // bit p = PUERTOS[p] abierto en targets[i]
+};
+
+// Resultado que la tarea devuelve a loop() por la cola scanResults
+struct ScanResult {
+  ScanJob job;
+  bool ok;
+  bool cancelled;
+  size_t nArp;
+  uint32_t aliveCount;      // en modo puertos: puertos abiertos
+  uint32_t attempts;        // connect() lanzados (modo puertos)
+  uint32_t named;           // nombres nuevos encontrados
+  unsigned long namesMs;    // tiempo buscando nombres (aparte de elapsedMs)
+  unsigned long elapsedMs;
+  uint32_t stackFree;       // pila libre mínima de la tarea de escaneo
+};
+
+ScanJob scanJob;
+QueueHandle_t scanResults = nullptr;   // tarea de escaneo -> loop()
+volatile bool cancelScan = false;
+unsigned long scanStartedAt = 0;
+uint32_t lastScanAlive = 0;            // para 'estado'
+TextBuffer<200> scanIntro;             // 1ª línea del mensaje de progreso en vivo
+const unsigned long PROGRESS_MS = 1000;   // refresco del texto (el outbox limita las ediciones)
+unsigned long lastProgress = 0;
+bool haveLastScan = false;
+
+// Para /metrics: escaneos terminados de cada tipo (índice = ScanMode)
+struct ScanMetrics {
+  uint32_t runs;
+  uint32_t cancelled;
+  uint32_t totalMs;
+  uint32_t lastMs;
+  uint32_t lastFound;       // hosts vivos (puertos abiertos en SCAN_PORTS)
+};
+ScanMetrics scanMetrics[3] = {};
+
+// Busca el nombre de hasta HostNames::ENTRIES IPs (las nuevas primero, que
+// son las que salen en el informe) con un tiempo proporcional al barrido.
+// Sin mínimo: tras un barrido corto casi todo sale de la caché (con TTL).
+void resolveNames(ScanResult &r, const uint32_t *ips, size_t n) {
+  unsigned long budget = r.elapsedMs * NAMES_BUDGET_PCT / 100;
+  names.dnsServer = ipToUint32(WiFi.dnsIP());
+  HostNames::Stats st;
+  r.named = names.resolve(ips, n, budget, &st);
+  r.namesMs = st.elapsedMs;
+}
 
-  IPAddress localIP = WiFi.localIP();
-  IPAddress mask = WiFi.subnetMask();
+void resolveAliveNames(ScanResult &r) {
+  uint32_t *ips = (uint32_t *)malloc(HostNames::ENTRIES * sizeof(uint32_t));
+  if (!ips) return;
+  size_t n = 0;
+  for (uint8_t pass = 0; pass < 2; ++pass) {   // 0: nuevos, 1: ya conocidos
+    for (uint32_t i = 0; i < scanJob.count && n < HostNames::ENTRIES; ++i) {
+      if (!(scanJob.aliveBits[i >> 3] & (1 << (i & 7)))) continue;
+      if (known.known(i) != (pass == 1)) continue;
+      ips[n++] = scanJob.first32 + i;
+    }
+  }
+  resolveNames(r, ips, n);
+  free(ips);
+}
 
-  uint32_t ip32 = ipToUint32(localIP);
-  uint32_t mask32 = ipToUint32(mask);
+// Tarea de escaneo: hace el barrido (bloqueante) y devuelve el resultado por la cola.
+// Mientras tanto loop() sigue atendiendo Telegram.
+void scanTask(void *) {
+  ScanResult r;
+  memset(&r, 0, sizeof(r));
+  r.job = scanJob;
+  if (scanJob.mode == SCAN_ARP) {
+    ArpSweep::Stats st;
+    r.ok = arpSweep.run(scanJob.first32, scanJob.count, scanJob.skip32, scanJob.aliveBits,
+                        scanJob.arpHosts, scanJob.maxArp, &st);
+    r.nArp = arpSweep.hostCount();
+    r.aliveCount = st.found;
+    r.elapsedMs = st.elapsedMs;
+  } else if (scanJob.mode == SCAN_PORTS) {
+    PortScan::Stats st;
+    r.ok = portScan.run(scanJob.targets, scanJob.count, PUERTOS, N_PUERTOS, scanJob.openMasks, &st);
+    r.aliveCount = st.open;
+    r.attempts = st.attempts;
+    r.elapsedMs = st.elapsedMs;
+    if (r.ok && !cancelScan) resolveNames(r, scanJob.targets, min(scanJob.count, (uint32_t)HostNames::ENTRIES));
+  } else {
+    IcmpSweep::Stats st;
+    r.ok = sweep.run(scanJob.first32, scanJob.count, scanJob.skip32, scanJob.aliveBits, &st);
+    r.aliveCount = st.alive;
+    r.elapsedMs = st.elapsedMs;
+  }
+  if (scanJob.mode != SCAN_PORTS && r.ok && !cancelScan) resolveAliveNames(r);
+  r.cancelled = cancelScan;
+  r.stackFree = uxTaskGetStackHighWaterMark(nullptr);
+  xQueueSend(scanResults, &r, portMAX_DELAY);
+  vTaskDelete(nullptr);
+}
+
+// Rango de la subred (sin red ni broadcast, como mucho una /16) desde WiFi
+void subnetRange(uint32_t &first32, uint32_t &hosts) {
+  uint32_t ip32 = ipToUint32(WiFi.localIP());
+  uint32_t mask32 = ipToUint32(WiFi.subnetMask());
   uint32_t net32 = ip32 & mask32;
 
   // calcular bits host
@@ -94,7 +232,6 @@ void scanSubnetAndNotify() {
   for (int i = 0; i < 32; ++i) {
     if (((mask32 >> i) & 1) == 0) hostBits++;
   }
-  uint32_t hosts = 0;
   if (hostBits == 0) {
     hosts = 1;
   } else if (hostBits > 16) {
@@ -104,151 +241,523 @@ void scanSubnetAndNotify() {
     hosts = (1UL << hostBits) - 2; // excluye network y broadcast
   }
   if (hosts == 0) hosts = 1;
+  first32 = net32 + 1;
+}
 
-  // Mensaje inicial de aviso
-  telegramSendMessage("Iniciando escaneo. IP=" + localIP.toString() + " máscara=" + mask.toString() +
-                      " -> " + String(hosts) + " hosts (máx).");
-
-  String aliveList = "";
-  uint32_t maxToScan = hosts;
-
-  for (uint32_t i = 1; i <= maxToScan; ++i) {
-    uint32_t target32 = net32 + i;
-    IPAddress target = uint32ToIP(target32);
-    if (target == localIP) continue; // saltar propia IP
-    bool ok = Ping.ping(target, 1); // 1 intento
-    if (ok) {
-      if (aliveList.length() > 0) aliveList += ", ";
-      aliveList += target.toString();
-      // si la lista se hace enorme podemos enviar parcialmente cada X entradas (opcional)
-      if (aliveList.length() > 800) {
-        telegramSendMessage("Hosts vivos (parcial): " + aliveList);
-        aliveList = "";
-      }
-    }
+// Arranca la tarea con scanJob ya preparado; si no puede, libera sus buffers
+bool startScanTask() {
+  if (!scanResults) scanResults = xQueueCreate(1, sizeof(ScanResult));
+  cancelScan = false;
+  if (scanResults && xTaskCreate(scanTask, "scan", 6144, nullptr, 1, nullptr) == pdPASS) {
+    scanning = true;
+    scanStartedAt = millis();
+    lastProgress = 0;
+    return true;
   }
+  free(scanJob.aliveBits);
+  free(scanJob.arpHosts);
+  free(scanJob.targets);
+  free(scanJob.openMasks);
+  telegramSendMessage("Error: no se pudo iniciar el escaneo (memoria o red).");
+  return false;
+}
 
-  if (aliveList.length() == 0) {
-    telegramSendMessage("Escaneo completado: ningún host respondió al ping.");
-  } else {
-    telegramSendMessage("Escaneo completado. Hosts vivos: " + aliveList);
+// Lanza escaneo de la subred obteniendo máscara desde WiFi.
+// No bloquea: el barrido corre en su propia tarea y el informe lo envía
+// serviceScanResults() desde loop(). Protegida por 'scanning' y por cooldown.
+void scanSubnetAndNotify(ScanMode mode = SCAN_ICMP) {
+  // Si ya está en escaneo, no hacemos nada.
+  if (scanning) return;
+
+  // cooldown
+  unsigned long now = millis();
+  if ((now - lastScanMillis) < MIN_SCAN_INTERVAL_MS) {
+    unsigned long waitMs = MIN_SCAN_INTERVAL_MS - (now - lastScanMillis);
+    Message msg;
+    msg.printf("Espera %lu s antes de volver a escanear.", (waitMs + 999) / 1000);
+    telegramSendMessage(msg.c_str());
+    return;
   }
 
-  scanning = false;
+  IPAddress localIP = WiFi.localIP();
+  IPAddress mask = WiFi.subnetMask();
+  uint32_t first32, hosts;
+  subnetRange(first32, hosts);
+
+  // Barrido concurrente (ICMP) o a ritmo fijo (ARP), resultado en un bitmap
+  memset(&scanJob, 0, sizeof(scanJob));
+  scanJob.mode = mode;
+  scanJob.first32 = first32;
+  scanJob.count = hosts;
+  scanJob.skip32 = ipToUint32(localIP);
+  scanJob.maxArp = (mode == SCAN_ARP) ? min((size_t)hosts, MAX_ARP_HOSTS) : 0;
+  scanJob.aliveBits = (uint8_t *)calloc((hosts + 7) / 8, 1);
+  scanJob.arpHosts = scanJob.maxArp ? (ArpHost *)malloc(scanJob.maxArp * sizeof(ArpHost)) : nullptr;
+  known.use(scanJob.first32, hosts);
+  sweep.priority = known.bits();
+  arpSweep.priority = known.bits();
+
+  if (!scanJob.aliveBits || (scanJob.maxArp && !scanJob.arpHosts)) {
+    free(scanJob.aliveBits);
+    free(scanJob.arpHosts);
+    telegramSendMessage("Error: no se pudo iniciar el escaneo (memoria o red).");
+    return;
+  }
+  if (!startScanTask()) return;
+  lastScanMillis = now;
+
+  // Mensaje de progreso: sale ya y se edita en su sitio (serviceScanProgress)
+  scanIntro.clear();
+  scanIntro.printf("Escaneo %s. IP=", mode == SCAN_ARP ? "ARP" : "ICMP");
+  scanIntro.printIp(localIP);
+  scanIntro.print(" máscara=");
+  scanIntro.printIp(mask);
+  scanIntro.printf(" -> %lu hosts (máx).", (unsigned long)hosts);
+  if (known.hasHistory()) scanIntro.printf(" Primero los %lu conocidos.", (unsigned long)known.knownCount());
+  scanIntro.print(" 'cancelar' para pararlo.");
+  outbox.beginLive(TELEGRAM_CHAT_ID, scanIntro.c_str());
 }
 
-// Comprobar Telegram /getUpdates para recibir comandos simples
-void checkTelegramForCommands() {
-  HTTPClient http;
-  String url = String("https://api.telegram.org/bot") + TELEGRAM_BOT_TOKEN +
-               "/getUpdates?offset=" + String(lastUpdateId + 1) + "&limit=5&timeout=0";
-
-  tlsClient.setInsecure();
-  http.begin(tlsClient, url);
-  int code = http.GET();
-  if (code <= 0) { http.end(); return; }
-  String payload = http.getString();
-  http.end();
-
-  if (payload.indexOf("\"result\":[]") != -1) return;
-
-  // Buscamos cada "update_id" y procesamos; la implementación es simple pero robusta para varios resultados.
-  int idx = 0;
-  while (true) {
-    int pu = payload.indexOf("\"update_id\":", idx);
-    if (pu == -1) break;
-    pu += strlen("\"update_id\":");
-    long updateId = 0;
-    while (pu < (int)payload.length() && isDigit(payload[pu])) {
-      updateId = updateId * 10 + (payload[pu] - '0');
-      pu++;
+// Lanza el escaneo de PUERTOS en una IP o en todos los hosts vivos del
+// último escaneo ('all'). Misma tarea y mismo progreso que el de la subred.
+void scanPortsAndNotify(StrView arg) {
+  if (scanning) return;
+  uint32_t first32, hosts;
+  subnetRange(first32, hosts);
+  known.use(first32, hosts);     // carga de NVS lo del último escaneo
+
+  memset(&scanJob, 0, sizeof(scanJob));
+  scanJob.mode = SCAN_PORTS;
+  IPAddress ip;
+  char ipText[16];
+  if (arg.equalsNoCase("all") || arg.equalsNoCase("todos")) {
+    if (!known.hasHistory() || known.knownCount() == 0) {
+      telegramSendMessage("No hay hosts conocidos: lanza antes 'escanear'.");
+      return;
     }
-    if (updateId <= lastUpdateId) {
-      idx = pu;
-      continue;
+    uint32_t n = min(known.knownCount(), (uint32_t)MAX_PORT_HOSTS);
+    scanJob.targets = (uint32_t *)malloc(n * sizeof(uint32_t));
+    for (uint32_t i = 0; scanJob.targets && i < known.count() && scanJob.count < n; ++i) {
+      if (known.known(i)) scanJob.targets[scanJob.count++] = known.first() + i;
     }
-    lastUpdateId = updateId;
+  } else if (arg.copyTo(ipText, sizeof(ipText)) && ip.fromString(ipText)) {
+    scanJob.targets = (uint32_t *)malloc(sizeof(uint32_t));
+    if (scanJob.targets) scanJob.targets[scanJob.count++] = ipToUint32(ip);
+  } else {
+    telegramSendMessage("Uso: 'puertos <ip>' o 'puertos all' (hosts vivos del último escaneo).");
+    return;
+  }
+  scanJob.openMasks = (uint32_t *)malloc(scanJob.count * sizeof(uint32_t));
+  if (!scanJob.targets || !scanJob.openMasks) {
+    free(scanJob.targets);
+    free(scanJob.openMasks);
+    telegramSendMessage("Error: no se pudo iniciar el escaneo (memoria o red).");
+    return;
+  }
+  if (!startScanTask()) return;
+
+  scanIntro.clear();
+  scanIntro.print("Puertos en ");
+  if (scanJob.count == 1) scanIntro.printIp(uint32ToIP(scanJob.targets[0]));
+  else scanIntro.printf("%lu hosts", (unsigned long)scanJob.count);
+  scanIntro.printf(": %u puertos, %u conexiones a la vez. 'cancelar' para pararlo.", (unsigned)N_PUERTOS,
+                   (unsigned)portScan.window);
+  outbox.beginLive(TELEGRAM_CHAT_ID, scanIntro.c_str());
+}
 
-    // buscar chat.id cercano a este update
-    int pc = payload.indexOf("\"chat\":{\"id\":", pu);
-    if (pc == -1) {
-      idx = pu;
+// Informe del escaneo de puertos: una línea por host con algo abierto
+void reportPortResult(const ScanResult &r) {
+  const ScanJob &job = r.job;
+  if (!r.ok) {
+    telegramSendMessage("Error: no se pudo hacer el escaneo de puertos (sin sockets libres).");
+    return;
+  }
+  unsigned long ms = r.elapsedMs ? r.elapsedMs : 1;
+  Message msg;
+  msg.printf("%s: %lu puertos abiertos. %lu conexiones en %lu.%lu s (%lu/s).",
+             r.cancelled ? "Puertos (cancelado)" : "Puertos", (unsigned long)r.aliveCount,
+             (unsigned long)r.attempts, ms / 1000, (ms % 1000) / 100,
+             (unsigned long)((uint64_t)r.attempts * 1000 / ms));
+  uint32_t closed = 0;
+  for (uint32_t i = 0; i < job.count; ++i) {
+    if (!job.openMasks[i]) {
+      closed++;
       continue;
     }
-    pc += strlen("\"chat\":{\"id\":");
-    long chatId = 0;
-    bool neg = false;
-    // leer posible signo -
-    if (payload[pc] == '-') { neg = true; pc++; }
-    while (pc < (int)payload.length() && isDigit(payload[pc])) {
-      chatId = chatId * 10 + (payload[pc] - '0');
-      pc++;
+    if (msg.length() > 800) {
+      telegramSendMessage(msg.c_str());
+      msg.clear();
+      msg.print("Puertos (sigue):");
     }
-    if (neg) chatId = -chatId;
-
-    // extraer texto del mensaje (si existe)
-    int pt = payload.indexOf("\"text\":\"", pc);
-    if (pt == -1) {
-      idx = pu;
-      continue;
+    msg.print("\n");
+    msg.printIp(uint32ToIP(job.targets[i]));
+    printHostInfo(msg, job.targets[i], nullptr);
+    msg.print(":");
+    for (uint8_t p = 0; p < N_PUERTOS; ++p) {
+      if (job.openMasks[i] & (1UL << p)) msg.printf(" %u", (unsigned)PUERTOS[p]);
     }
-    pt += strlen("\"text\":\"");
-    String text = "";
-    while (pt < (int)payload.length()) {
-      char c = payload[pt++];
-      if (c == '"') break;
-      if (c == '\\' && pt < (int)payload.length()) {
-        char e = payload[pt++];
-        if (e == 'n') text += '\n';
-        else if (e == 'r') text += '\r';
-        else if (e == 't') text += '\t';
-        else if (e == '"') text += '"';
-        else if (e == '\\') text += '\\';
-        else { text += e; }
-      } else {
-        text += c;
-      }
+  }
+  if (closed) msg.printf("\n%lu hosts sin puertos abiertos.", (unsigned long)closed);
+  telegramSendMessage(msg.c_str());
+}
+
+enum HostChange { HOST_JOINED, HOST_LEFT };
+
+// Lista de IPs que cambiaron (con MAC en modo ARP), en orden ascendente; si
+// se hace enorme se envía por partes
+void sendHostList(const ScanResult &r, HostChange which, const char *title) {
+  const ScanJob &job = r.job;
+  Message msg;
+  msg.printf("%s: ", title);
+  const size_t listStart = msg.length();
+  for (uint32_t i = 0; i < job.count; ++i) {
+    bool alive = job.aliveBits[i >> 3] & (1 << (i & 7));
+    if (which == HOST_JOINED ? (!alive || known.known(i)) : (alive || !known.known(i))) continue;
+    if (msg.length() > listStart) msg.print(", ");
+    msg.printIp(uint32ToIP(job.first32 + i));
+    const uint8_t *mac = r.nArp ? findArpMac(job.arpHosts, r.nArp, job.first32 + i) : nullptr;
+    printHostInfo(msg, job.first32 + i, mac);
+    if (msg.length() - listStart > 800) {
+      telegramSendMessage(msg.c_str());
+      msg.clear();
+      msg.printf("%s (sigue): ", title);
     }
-    String cmd = text;
-    cmd.toLowerCase();
-    cmd.trim();
-
-    // Solo responder si viene del chat esperado
-    if (chatId == TELEGRAM_CHAT_ID) {
-      if (cmd == "escanear" || cmd == "/escanear") {
-        // Si ya hay un escaneo en curso o estamos en cooldown, respondemos en lugar de iniciar otro.
-        unsigned long now = millis();
-        if (scanning) {
-          telegramSendMessage("Ya estoy escaneando — espera a que termine.");
-        } else if ((now - lastScanMillis) < MIN_SCAN_INTERVAL_MS) {
-          unsigned long waitSec = (MIN_SCAN_INTERVAL_MS - (now - lastScanMillis) + 999) / 1000;
-          telegramSendMessage("Demasiado pronto. Espera " + String(waitSec) + " s antes del próximo escaneo.");
-        } else {
-          telegramSendMessage("Comando recibido: lanzando escaneo...");
-          scanSubnetAndNotify();
-        }
-      } else {
-        telegramSendMessage("Comando desconocido. Envía 'escanear' o '/escanear' para lanzar el escaneo.");
-      }
+  }
+  if (msg.length() > listStart) telegramSendMessage(msg.c_str());
+}
+
+// Informe final: sólo lo que cambió respecto al escaneo anterior (el
+// primero lista todos). Después el barrido pasa a ser lo conocido.
+void reportScanResult(const ScanResult &r) {
+  const ScanJob &job = r.job;
+  if (!r.ok) {
+    telegramSendMessage("Error: no se pudo hacer el escaneo (socket o interfaz de red).");
+    return;
+  }
+  if (r.nArp) qsort(job.arpHosts, r.nArp, sizeof(ArpHost), compareArpHost);
+
+  KnownHosts::Diff d;
+  known.diff(job.aliveBits, !r.cancelled, d);
+
+  const char *head = r.cancelled ? "Escaneo cancelado" : "Escaneo completado";
+  unsigned long took = (r.elapsedMs + 500) / 1000;
+  Message out;
+  if (r.aliveCount == 0 && d.left == 0) {
+    out.printf("%s: ningún host respondió %s (%lu s)", head,
+               job.mode == SCAN_ARP ? "al ARP." : "al ping.", took);
+  } else if (!known.hasHistory()) {
+    out.printf("%s. %lu hosts vivos. (%lu s)", head, (unsigned long)r.aliveCount, took);
+  } else if (d.joined == 0 && d.left == 0) {
+    out.printf("%s. Sin cambios: %lu hosts vivos. (%lu s)", head, (unsigned long)d.stayed, took);
+  } else {
+    out.printf("%s. %lu nuevos, %lu desaparecidos, %lu siguen. (%lu s)", head, (unsigned long)d.joined,
+               (unsigned long)d.left, (unsigned long)d.stayed, took);
+  }
+  if (r.namesMs) out.printf(" Nombres: %lu nuevos en %lu ms.", (unsigned long)r.named, r.namesMs);
+  telegramSendMessage(out.c_str());
+
+  if (d.joined) sendHostList(r, HOST_JOINED, known.hasHistory() ? "Nuevos" : "Hosts vivos");
+  if (d.left) sendHostList(r, HOST_LEFT, "Desaparecidos");
+  known.update(job.aliveBits, !r.cancelled);
+}
+
+// Recoge el resultado de la tarea de escaneo (si ya terminó) y lo envía
+void serviceScanResults() {
+  ScanResult r;
+  if (!scanResults || xQueueReceive(scanResults, &r, 0) != pdTRUE) return;
+
+  // última versión del mensaje de progreso; el informe va aparte (ése sí avisa)
+  Message live;
+  live.print(scanIntro.c_str());
+  live.printf("\n%s en %lu s: %lu %s.", r.cancelled ? "Cancelado" : "Terminado",
+              (r.elapsedMs + 500) / 1000, (unsigned long)r.aliveCount,
+              r.job.mode == SCAN_PORTS ? "puertos abiertos" : "hosts vivos");
+  outbox.endLive(live.c_str());
+
+  heapMon.noteStack("scan", r.stackFree);
+  ScanMetrics &sm = scanMetrics[r.job.mode];
+  sm.runs++;
+  if (r.cancelled) sm.cancelled++;
+  sm.totalMs += r.elapsedMs + r.namesMs;
+  sm.lastMs = r.elapsedMs + r.namesMs;
+  sm.lastFound = r.aliveCount;
+  if (r.job.mode == SCAN_PORTS) {
+    reportPortResult(r);
+  } else {
+    reportScanResult(r);
+    lastScanAlive = r.aliveCount;
+    haveLastScan = r.ok;
+  }
+  free(r.job.aliveBits);
+  free(r.job.arpHosts);
+  free(r.job.targets);
+  free(r.job.openMasks);
+  scanning = false;
+}
+
+// Progreso del escaneo en curso (lo lee loop() mientras la tarea trabaja)
+void printScanProgress(Message &msg) {
+  if (!scanning) {
+    msg.print("No hay ningún escaneo en curso.");
+    return;
+  }
+  uint32_t done, total, found;
+  if (scanJob.mode == SCAN_PORTS) {
+    done = portScan.progress; total = portScan.total; found = portScan.found;
+  } else if (scanJob.mode == SCAN_ARP) {
+    done = arpSweep.progress; total = arpSweep.total; found = arpSweep.found;
+  } else {
+    done = sweep.progress; total = sweep.total; found = sweep.found;
+  }
+  uint32_t pct = total ? (uint32_t)((uint64_t)done * 100 / total) : 0;
+  unsigned long elapsed = millis() - scanStartedAt;
+  static const char *const NAMES[] = { "ICMP", "ARP", "de puertos" };
+  msg.printf("Escaneo %s: %lu%% (%lu/%lu), %lu %s, %lu s.", NAMES[scanJob.mode], (unsigned long)pct,
+             (unsigned long)done, (unsigned long)total, (unsigned long)found,
+             scanJob.mode == SCAN_PORTS ? "abiertos" : "hosts vivos", elapsed / 1000);
+  if (done == 0 || elapsed < 500) return;
+  uint32_t rate = (uint32_t)((uint64_t)done * 1000 / elapsed);   // sondeos/s
+  unsigned long left = (unsigned long)((uint64_t)(total - done) * elapsed / done / 1000);
+  msg.printf(" %lu/s, quedan ~%lu s.", (unsigned long)rate, left);
+}
+
+// Refresca el mensaje de progreso en vivo mientras dura el escaneo
+void serviceScanProgress() {
+  if (!scanning || millis() - lastProgress < PROGRESS_MS) return;
+  lastProgress = millis();
+  Message msg;
+  msg.print(scanIntro.c_str());
+  msg.print("\n");
+  printScanProgress(msg);
+  outbox.updateLive(msg.c_str());
+}
+
+// Estado del dispositivo y del último escaneo
+void printStatus(Message &msg) {
+  msg.print("Estado\nIP: ");
+  msg.printIp(WiFi.localIP());
+  msg.printf("\nRSSI: %d dBm\n", (int)WiFi.RSSI());
+  msg.printf("Uptime: %lu s\n", millis() / 1000);
+  msg.printf("Red: WiFi %lu ms (%s), primer byte a %lu ms, DNS %lu/%lu en caché\n", net.connectMs(),
+             net.lastWasFast() ? "rápida" : "completa", netFirstByteMs(), (unsigned long)dns.hits(),
+             (unsigned long)(dns.hits() + dns.misses()));
+  heapMon.sample();
+  heapMon.printTo(msg);
+  if (scanning) printScanProgress(msg);
+  else if (haveLastScan) msg.printf("Último escaneo: %lu hosts vivos, hace %lu s. Conocidos: %lu.",
+                                    (unsigned long)lastScanAlive, (millis() - lastScanMillis) / 1000,
+                                    (unsigned long)known.knownCount());
+  else msg.print("Sin escaneos todavía.");
+  if (WEBHOOK_PORT && !hook.started()) {
+    msg.print("\nWebhook desactivado: falta WEBHOOK_SECRET");
+  } else if (WEBHOOK_PORT) {
+    const TelegramWebhook::Stats &h = hook.stats();
+    msg.printf("\nWebhook :%u: %lu updates, %lu rechazados", (unsigned)WEBHOOK_PORT,
+               (unsigned long)h.updates, (unsigned long)(h.rejected + h.timeouts));
+  }
+}
+
+// ---- comandos ----
+
+// Si hay un escaneo en marcha lo dice y devuelve true
+bool replyIfScanning() {
+  if (!scanning) return false;
+  Message msg;
+  msg.print("Ya estoy escaneando — ");
+  printScanProgress(msg);
+  telegramSendMessage(msg.c_str());
+  return true;
+}
+
+void cmdScan(const CommandContext &ctx) {
+  bool arp = ctx.args.equalsNoCase("arp");
+  if (!arp && !ctx.args.empty()) {
+    telegramSendMessage("Uso: 'escanear' (ping) o 'escanear arp' (ARP, con MAC).");
+    return;
+  }
+  // Si ya hay un escaneo en curso o estamos en cooldown, respondemos en lugar de iniciar otro.
+  if (replyIfScanning()) return;
+  unsigned long now = millis();
+  if ((now - lastScanMillis) < MIN_SCAN_INTERVAL_MS) {
+    unsigned long waitSec = (MIN_SCAN_INTERVAL_MS - (now - lastScanMillis) + 999) / 1000;
+    Message msg;
+    msg.printf("Demasiado pronto. Espera %lu s antes del próximo escaneo.", waitSec);
+    telegramSendMessage(msg.c_str());
+    return;
+  }
+  scanSubnetAndNotify(arp ? SCAN_ARP : SCAN_ICMP);
+}
+
+void cmdPorts(const CommandContext &ctx) {
+  if (!replyIfScanning()) scanPortsAndNotify(ctx.args);
+}
+
+void cmdProgress(const CommandContext &) {
+  Message msg;
+  printScanProgress(msg);
+  telegramSendMessage(msg.c_str());
+}
+
+void cmdCancel(const CommandContext &) {
+  if (scanning) {
+    cancelScan = true;
+    telegramSendMessage("Cancelando escaneo...");
+  } else {
+    telegramSendMessage("No hay ningún escaneo en curso.");
+  }
+}
+
+void cmdStatus(const CommandContext &) {
+  Message msg;
+  printStatus(msg);
+  telegramSendMessage(msg.c_str());
+}
+
+// Ordenada por nombre (búsqueda binaria); /help sale de aquí. Se aceptan con
+// y sin '/'. Las entradas sin ayuda son alias. Como siempre en este sketch,
+// se autoriza por chat: en un grupo, cualquiera de sus miembros.
+constexpr Command COMMANDS[] = {
+  { "cancel", cmdCancel, nullptr, nullptr, CMD_CHAT, 0 },
+  { "cancelar", cmdCancel, nullptr, "parar el escaneo en curso", CMD_CHAT, 0 },
+  { "escanear", cmdScan, "[arp]", "buscar hosts por ping (o por ARP, con MAC)", CMD_CHAT, 0 },
+  { "estado", cmdStatus, nullptr, "estado del dispositivo y del último escaneo", CMD_CHAT, 3 },
+  { "progreso", cmdProgress, nullptr, "progreso del escaneo", CMD_CHAT, 2 },
+  { "puertos", cmdPorts, "<ip|all>", "puertos abiertos de un host o de todos los vivos", CMD_CHAT, 10 },
+  { "status", cmdStatus, nullptr, nullptr, CMD_CHAT, 3 },
+};
+static_assert(commandsSorted(COMMANDS), "COMMANDS debe ir ordenada por nombre");
+CommandRouter<sizeof(COMMANDS) / sizeof(COMMANDS[0])> router(COMMANDS, telegramSendMessage);
+
+// sólo mensajes de texto; el router sólo responde en el chat esperado
+void handleUpdate(const TelegramUpdate &upd) {
+  if (!upd.hasMessage || !upd.hasText) return;
+  router.dispatch(upd.text, upd.chatId, upd.fromId, upd.fromName);
+}
+
+// Atiende el long-poll de getUpdates (o el webhook) para recibir comandos
+// simples (no bloquea)
+void checkTelegramForCommands() {
+  if (WEBHOOK_PORT) {
+    if (hook.service()) {
+      lastUpdateId = (long)hook.update().updateId;
+      handleUpdate(hook.update());
     }
+    return;
+  }
+  if (!poller.service()) return;
+  uint32_t allocMark = pollAllocs.begin();
+
+  // Parser en streaming: cada update llega con su propio chat.id y texto
+  updParser.reset();
+  while (updParser.next(poller.transport())) {
+    const TelegramUpdate &upd = updParser.update();
+    if (upd.updateId <= lastUpdateId) continue;
+    lastUpdateId = (long)upd.updateId;
+    poller.ack(lastUpdateId);
+    handleUpdate(upd);
+  }
+  poller.done();
+  pollAllocs.end(allocMark);
+}
 
-    idx = pu;
+// Página de /metrics: dispositivo, Telegram, escaneos y escrituras en NVS
+void renderMetrics(PromWriter &m) {
+  m.family("uptime_seconds", "gauge", "tiempo desde el arranque");
+  m.seconds("uptime_seconds", millis());
+  m.gauge("wifi_rssi_dbm", "RSSI del AP", WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0);
+  m.gauge("wifi_connect_ms", "duración de la última conexión WiFi", net.connectMs());
+  heapMon.sample();
+  heapMon.metricsTo(m);
+
+  TelegramOutbox::Stats o = outbox.stats();
+  m.family("telegram_messages_total", "counter", "mensajes salientes por resultado");
+  m.value("telegram_messages_total", o.sent, "result=\"sent\"");
+  m.value("telegram_messages_total", o.failed, "result=\"failed\"");
+  m.value("telegram_messages_total", o.dropped, "result=\"dropped\"");
+  m.counter("telegram_live_edits_total", "ediciones del mensaje de progreso", o.edits);
+  m.counter("telegram_send_retries_total", "reintentos de envío", o.retries);
+  m.counter("telegram_rate_limited_total", "respuestas 429", o.rateLimited);
+  m.family("telegram_request_seconds", "summary", "duración de las peticiones de envío");
+  m.seconds("telegram_request_seconds_sum", o.requestMs);
+  m.value("telegram_request_seconds_count", o.requests);
+  m.family("telegram_request_last_seconds", "gauge", "duración de la última petición de envío");
+  m.seconds("telegram_request_last_seconds", o.lastRequestMs);
+  if (WEBHOOK_PORT) {
+    const TelegramWebhook::Stats &h = hook.stats();
+    m.counter("telegram_webhook_updates_total", "updates recibidos por webhook", h.updates);
+    m.counter("telegram_webhook_rejected_total", "peticiones rechazadas o a medias", h.rejected + h.timeouts);
+  } else {
+    m.counter("telegram_polls_total", "peticiones getUpdates", poller.polls());
+    m.counter("telegram_poll_errors_total", "getUpdates fallidos", poller.errors());
+    m.family("telegram_poll_last_wait_seconds", "gauge", "espera del último long-poll con respuesta");
+    m.seconds("telegram_poll_last_wait_seconds", poller.lastWaitMs());
   }
+
+  static const char *const MODES[] = { "mode=\"icmp\"", "mode=\"arp\"", "mode=\"ports\"" };
+  m.family("scans_total", "counter", "escaneos terminados");
+  for (int i = 0; i < 3; ++i) m.value("scans_total", scanMetrics[i].runs, MODES[i]);
+  m.family("scans_cancelled_total", "counter", "escaneos cancelados");
+  for (int i = 0; i < 3; ++i) m.value("scans_cancelled_total", scanMetrics[i].cancelled, MODES[i]);
+  m.family("scan_seconds_total", "counter", "tiempo escaneando (con nombres)");
+  for (int i = 0; i < 3; ++i) m.seconds("scan_seconds_total", scanMetrics[i].totalMs, MODES[i]);
+  m.family("scan_last_seconds", "gauge", "duración del último escaneo");
+  for (int i = 0; i < 3; ++i) m.seconds("scan_last_seconds", scanMetrics[i].lastMs, MODES[i]);
+  m.family("scan_last_found", "gauge", "hosts vivos (o puertos abiertos) en el último escaneo");
+  for (int i = 0; i < 3; ++i) m.value("scan_last_found", scanMetrics[i].lastFound, MODES[i]);
+  m.gauge("scan_running", "1 si hay un escaneo en marcha", scanning ? 1 : 0);
+  m.gauge("known_hosts", "hosts conocidos del último escaneo", known.knownCount());
+  m.counter("nvs_writes_total", "escrituras de hosts conocidos en NVS", known.saves());
+}
+
+// Muestra el heap cada HEAP_CHECK_MS y avisa cuando salta un umbral
+void maybeCheckHeap() {
+  unsigned long now = millis();
+  if ((now - lastHeapCheck) < HEAP_CHECK_MS) return;
+  lastHeapCheck = now;
+  heapMon.sample();
+  uint8_t raised = heapMon.checkAlarms();
+  if (!raised) return;
+  Message msg;
+  heapMon.printAlarms(msg, raised);
+  telegramSendMessage(msg.c_str());
 }
 
 void setup() {
   // NO Serial por petición del usuario
 
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(SSID, PASS);
-
-  // esperar a conexión (bloqueante mínimo)
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(250);
+  sharedDnsCache() = &dns;          // las conexiones a Telegram usan la caché DNS
+  outbox.allocs = &sendAllocs;
+  outbox.begin(TELEGRAM_BOT_TOKEN); // no valida cert (más simple)
+  heapMon.watchTask("loop", xTaskGetCurrentTaskHandle());
+  heapMon.watchTask("tg_outbox", outbox.taskHandle());
+  heapMon.watchAllocs("envío", &sendAllocs);
+  heapMon.watchAllocs("poll", &pollAllocs);
+  sweep.cancel = &cancelScan;
+  arpSweep.cancel = &cancelScan;
+  portScan.cancel = &cancelScan;
+  router.chatId = TELEGRAM_CHAT_ID;
+  router.ownerId = 0;                  // sin dueño: vale todo el chat
+  prefs.begin("scanner", false);
+  known.begin(prefs);
+  if (!WEBHOOK_PORT) poller.begin(TELEGRAM_BOT_TOKEN, LONG_POLL_TIMEOUT_S, 5);
+
+  // esperar a conexión: vía rápida (BSSID/canal guardados) y si no la completa
+  while (!net.connect(SSID, PASS, 20000)) {
+    WiFi.disconnect();
+    delay(1000);
+  }
+  if (METRICS_PORT) metrics.begin(METRICS_PORT, renderMetrics);
+  if (WEBHOOK_PORT) {
+    hook.path = WEBHOOK_PATH;
+    hook.secret = WEBHOOK_SECRET;
+    hook.begin(WEBHOOK_PORT);        // sin secreto no arranca: lo dice /estado
   }
 
   // una vez conectado, enviar aviso (solo una vez) y lanzar escaneo inicial
-  telegramSendMessage("Dispositivo conectado. IP: " + WiFi.localIP().toString());
+  Message hello;
+  hello.print("Dispositivo conectado. IP: ");
+  hello.printIp(WiFi.localIP());
+  telegramSendMessage(hello.c_str());
 
   if (!scannedOnConnect) {
     scannedOnConnect = true;
@@ -257,11 +766,17 @@ void setup() {
 }
 
 void loop() {
-  unsigned long now = millis();
-  if (now - lastTelegramCheck >= TELEGRAM_POLL_INTERVAL) {
-    lastTelegramCheck = now;
-    checkTelegramForCommands();
-  }
+  // long-poll o webhook: responde en cuanto llega un comando (también durante un escaneo)
+  checkTelegramForCommands();
+  // informe del escaneo cuando la tarea termina
+  serviceScanResults();
+  // progreso en vivo (un solo mensaje editado)
+  serviceScanProgress();
+  // heap y pilas: alarma si se cruza un umbral
+  maybeCheckHeap();
+  // /metrics: una petición como mucho por vuelta
+  if (METRICS_PORT) metrics.service();
   // loop ligero: no hacemos más (evitamos lanzar escaneos periódicos automáticos)
+  delay(10);
 }
 
@@ -0,0 +1,222 @@
+// FastConnect.h
+// Arranque rápido de la red, para el ciclo de deep sleep y para los
+// reinicios:
+//   - FastConnect: recuerda BSSID y canal del último AP y se conecta directo
+//     (sin escanear). Opcionalmente IP fija o reutilizar la última IP de
+//     DHCP. Si falla, hace el procedimiento completo (escaneo + DHCP).
+//   - DnsCache: direcciones ya resueltas con un TTL, para conectar por IP
+//     (con el nombre para SNI) sin preguntar al DNS en cada arranque.
+//   - netMarkFirstByte(): mide el tiempo desde el arranque (o despertar)
+//     hasta el primer byte enviado a un servidor.
+//
+// Los estados van en memoria RTC (RTC_DATA_ATTR en el sketch): se conservan
+// en deep sleep. La hora para el TTL es la del sistema, que sigue contando
+// mientras el chip duerme.
+#pragma once
+
+#include <WiFi.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+
+// ---- tiempo hasta el primer byte ----
+
+inline unsigned long &netFirstByteSlot() {
+  static unsigned long at = 0;
+  return at;
+}
+
+// Apunta millis() la primera vez que se envía algo (lo llaman los clientes)
+inline void netMarkFirstByte() {
+  if (netFirstByteSlot() == 0) netFirstByteSlot() = millis();
+}
+
+// ms desde el arranque/despertar hasta el primer byte (0 = todavía no)
+inline unsigned long netFirstByteMs() { return netFirstByteSlot(); }
+
+// ---- caché DNS ----
+
+class DnsCache {
+public:
+  enum { ENTRIES = 4, HOST_MAX = 40 };
+
+  struct State {
+    struct Entry {
+      char host[HOST_MAX];
+      uint32_t ip;
+      uint32_t resolvedAt;    // time() al resolver
+    } e[ENTRIES];
+    uint32_t hits;
+    uint32_t misses;
+  };
+
+  uint32_t ttlSec = 3600;     // el TTL real no lo da hostByName(): se usa éste
+
+  explicit DnsCache(State &st) : _st(st) {}
+
+  // Dirección de host: de la caché si no ha caducado, si no del DNS.
+  // Se puede llamar desde varias tareas.
+  bool resolve(const char *host, IPAddress &ip) {
+    uint32_t now = (uint32_t)time(nullptr);
+    portENTER_CRITICAL(&_mux);
+    int i = find(host);
+    bool fresh = i >= 0 && now >= _st.e[i].resolvedAt && now - _st.e[i].resolvedAt < ttlSec;
+    if (fresh) {
+      ip = IPAddress(_st.e[i].ip);
+      _st.hits++;
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (fresh) return true;
+
+    if (!WiFi.hostByName(host, ip) || (uint32_t)ip == 0) return false;
+    portENTER_CRITICAL(&_mux);
+    _st.misses++;
+    i = find(host);
+    if (i < 0) i = oldest();
+    strncpy(_st.e[i].host, host, HOST_MAX - 1);
+    _st.e[i].host[HOST_MAX - 1] = '\0';
+    _st.e[i].ip = (uint32_t)ip;
+    _st.e[i].resolvedAt = now;
+    portEXIT_CRITICAL(&_mux);
+    return true;
+  }
+
+  // La dirección guardada no funcionó: la próxima vez se pregunta al DNS
+  void forget(const char *host) {
+    portENTER_CRITICAL(&_mux);
+    int i = find(host);
+    if (i >= 0) _st.e[i].host[0] = '\0';
+    portEXIT_CRITICAL(&_mux);
+  }
+
+  uint32_t hits() const { return _st.hits; }
+  uint32_t misses() const { return _st.misses; }
+
+private:
+  State &_st;
+  portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  int find(const char *host) const {
+    for (int i = 0; i < ENTRIES; ++i) {
+      if (_st.e[i].host[0] && strncmp(_st.e[i].host, host, HOST_MAX) == 0) return i;
+    }
+    return -1;
+  }
+
+  int oldest() const {
+    int best = 0;
+    for (int i = 0; i < ENTRIES; ++i) {
+      if (!_st.e[i].host[0]) return i;
+      if (_st.e[i].resolvedAt < _st.e[best].resolvedAt) best = i;
+    }
+    return best;
+  }
+};
+
+// Caché compartida por todos los clientes del sketch (nullptr = sin caché)
+inline DnsCache *&sharedDnsCache() {
+  static DnsCache *cache = nullptr;
+  return cache;
+}
+
+// ---- conexión WiFi rápida ----
+
+class FastConnect {
+public:
+  struct State {
+    uint8_t valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip, gateway, mask, dns;   // última configuración (DHCP o fija)
+    uint32_t fastOk;
+    uint32_t fastFailed;
+  };
+
+  unsigned long fastTimeoutMs = 4000;   // si no conecta en este tiempo, vía completa
+  bool reuseLease = false;              // reutilizar la última IP de DHCP como fija
+
+  explicit FastConnect(State &st) : _st(st) {}
+
+  // IP fija (se usa siempre, también en la vía completa)
+  void setStaticIp(IPAddress ip, IPAddress gateway, IPAddress mask, IPAddress dns) {
+    _static = true;
+    _ip = ip;
+    _gw = gateway;
+    _mask = mask;
+    _dns = dns;
+  }
+
+  // Conecta por la vía rápida si hay datos guardados; si no o si falla, por
+  // la completa (hasta timeoutMs). Devuelve true si hay conexión.
+  bool connect(const char *ssid, const char *pass, unsigned long timeoutMs) {
+    unsigned long t0 = millis();
+    _fast = false;
+    WiFi.persistent(false);        // no reescribir la config WiFi en flash en cada begin()
+    WiFi.mode(WIFI_STA);
+
+    if (_st.valid) {
+      applyIpConfig(reuseLease);
+      WiFi.begin(ssid, pass, _st.channel, _st.bssid);
+      if (waitConnected(fastTimeoutMs)) {
+        _fast = true;
+        _st.fastOk++;
+        remember();
+        _connectMs = millis() - t0;
+        return true;
+      }
+      _st.fastFailed++;
+      _st.valid = 0;               // AP cambiado/movido: se vuelve a aprender
+      WiFi.disconnect();
+    }
+
+    applyIpConfig(false);
+    WiFi.begin(ssid, pass);
+    unsigned long spent = millis() - t0;
+    bool ok = waitConnected(timeoutMs > spent ? timeoutMs - spent : 0);
+    if (ok) remember();
+    _connectMs = millis() - t0;
+    return ok;
+  }
+
+  bool lastWasFast() const { return _fast; }
+  unsigned long connectMs() const { return _connectMs; }
+  uint32_t fastOk() const { return _st.fastOk; }
+  uint32_t fastFailed() const { return _st.fastFailed; }
+
+private:
+  State &_st;
+  bool _fast = false;
+  unsigned long _connectMs = 0;
+  bool _static = false;
+  IPAddress _ip, _gw, _mask, _dns;
+
+  void applyIpConfig(bool useLease) {
+    if (_static) {
+      WiFi.config(_ip, _gw, _mask, _dns);
+    } else if (useLease && _st.ip) {
+      WiFi.config(IPAddress(_st.ip), IPAddress(_st.gateway), IPAddress(_st.mask), IPAddress(_st.dns));
+    } else {
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());   // DHCP
+    }
+  }
+
+  bool waitConnected(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED) {
+      if (millis() - start >= timeoutMs) return false;
+      delay(20);
+    }
+    return true;
+  }
+
+  void remember() {
+    uint8_t *bssid = WiFi.BSSID();
+    if (!bssid) return;
+    memcpy(_st.bssid, bssid, 6);
+    _st.channel = (uint8_t)WiFi.channel();
+    _st.ip = (uint32_t)WiFi.localIP();
+    _st.gateway = (uint32_t)WiFi.gatewayIP();
+    _st.mask = (uint32_t)WiFi.subnetMask();
+    _st.dns = (uint32_t)WiFi.dnsIP();
+    _st.valid = 1;
+  }
+};
@@ -0,0 +1,343 @@
+// HeapMetrics.h
+// Salud del heap para equipos que pasan semanas encendidos. getFreeHeap()
+// sola no avisa de la fragmentación: puede haber 80 KB libres y ningún
+// hueco de 16 KB para el siguiente handshake TLS. Aquí se sigue:
+//   - heap libre, mayor bloque libre y mínimo histórico,
+//   - fragmentación (1 - mayor bloque / libre),
+//   - pila libre mínima de cada tarea (high-water mark),
+//   - en caminos concretos (envío, long-poll) con AllocCounter: bloques que
+//     quedan sin liberar y, si IDF tiene los hooks de heap, reservas hechas,
+// y se generan alarmas por umbral (con histéresis para no repetirlas).
+//
+//   HeapMetrics heapMon;
+//   heapMon.watchTask("loop", xTaskGetCurrentTaskHandle());
+//   ...
+//   heapMon.sample();
+//   uint8_t a = heapMon.checkAlarms();   // sólo las que acaban de saltar
+#pragma once
+
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Vigila el heap en un camino de código (entre begin() y end()):
+//   - bloques que quedan reservados al terminar (allocated_blocks antes y
+//     después): sirve para ver Strings o reconexiones que crecen, pero no
+//     ve lo que se reserva y se libera dentro (TLS, por ejemplo) y otra
+//     tarea reservando a la vez mete ruido;
+//   - reservas hechas de verdad, contadas en cada malloc de la tarea que
+//     está dentro del camino. Necesita CONFIG_HEAP_USE_HOOKS (menuconfig de
+//     IDF, ESP-IDF >= 5.1); sin él hooks() es false y esas cifras quedan a 0.
+// Como mucho MAX_ACTIVE caminos dentro a la vez (uno por tarea).
+struct AllocCounter {
+  enum { MAX_ACTIVE = 4 };
+
+  volatile uint32_t runs = 0;          // veces que se ha medido el camino
+  volatile uint32_t leakyRuns = 0;     // veces que quedó algún bloque sin liberar
+  volatile uint32_t leakedBlocks = 0;  // total de bloques sin liberar
+  volatile uint32_t maxLeaked = 0;     // peor caso en una sola pasada
+  volatile uint32_t allocs = 0;        // reservas hechas (con hooks)
+  volatile uint32_t maxAllocs = 0;     // peor pasada (con hooks)
+
+  uint32_t begin() {
+    _inRun = 0;
+    _task = xTaskGetCurrentTaskHandle();
+    enter(this);
+    return allocatedBlocks();
+  }
+
+  void end(uint32_t mark) {
+    uint32_t now = allocatedBlocks();
+    leave(this);
+    _task = nullptr;
+    runs++;
+    allocs += _inRun;
+    if (_inRun > maxAllocs) maxAllocs = _inRun;
+    if (now <= mark) return;
+    uint32_t d = now - mark;
+    leakyRuns++;
+    leakedBlocks += d;
+    if (d > maxLeaked) maxLeaked = d;
+  }
+
+  static constexpr bool hooks() {
+#ifdef CONFIG_HEAP_USE_HOOKS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static uint32_t allocatedBlocks() {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    return (uint32_t)info.allocated_blocks;
+  }
+
+  // Desde el hook de IDF: una reserva en la tarea actual
+  static void countAlloc() {
+    TaskHandle_t t = xTaskGetCurrentTaskHandle();
+    AllocCounter **a = active();
+    for (uint8_t i = 0; i < MAX_ACTIVE; ++i) {
+      AllocCounter *c = a[i];
+      if (c && c->_task == t) c->_inRun++;
+    }
+  }
+
+private:
+  volatile TaskHandle_t _task = nullptr;   // tarea dentro del camino
+  volatile uint32_t _inRun = 0;            // reservas de la pasada en curso
+
+  static AllocCounter **active() {
+    static AllocCounter *a[MAX_ACTIVE] = {};
+    return a;
+  }
+
+  static void enter(AllocCounter *c) {
+    AllocCounter **a = active();
+    for (uint8_t i = 0; i < MAX_ACTIVE; ++i) {
+      if (a[i] == c) return;
+    }
+    for (uint8_t i = 0; i < MAX_ACTIVE; ++i) {
+      AllocCounter *none = nullptr;
+      if (__atomic_compare_exchange_n(&a[i], &none, c, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+    }
+  }
+
+  static void leave(AllocCounter *c) {
+    AllocCounter **a = active();
+    for (uint8_t i = 0; i < MAX_ACTIVE; ++i) {
+      if (a[i] == c) __atomic_store_n(&a[i], (AllocCounter *)nullptr, __ATOMIC_RELEASE);
+    }
+  }
+};
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+// IDF llama a esto en cada reserva (de cualquier tarea); tiene que ser corto
+extern "C" void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+  (void)size;
+  (void)caps;
+  if (ptr) AllocCounter::countAlloc();
+}
+#endif
+
+class HeapMetrics {
+public:
+  enum { MAX_TASKS = 6, MAX_COUNTERS = 4 };
+  enum : uint8_t {
+    ALARM_LOW_FREE = 1,
+    ALARM_FRAGMENTED = 2,
+    ALARM_SMALL_BLOCK = 4,
+    ALARM_LOW_STACK = 8
+  };
+
+  struct Sample {
+    uint32_t freeBytes;
+    uint32_t largestBlock;
+    uint32_t minFreeBytes;     // mínimo desde el arranque
+    uint32_t allocatedBlocks;
+    uint32_t freeBlocks;
+    uint8_t fragPct;           // 0 = todo lo libre es un solo bloque
+  };
+
+  // Umbrales de alarma (0 = desactivado)
+  uint32_t alarmFreeBytes = 24 * 1024;
+  uint8_t alarmFragPct = 60;
+  uint32_t alarmLargestBlock = 16 * 1024;  // lo que pide un handshake TLS
+  uint32_t alarmStackBytes = 512;
+
+  // Tarea que vive todo el tiempo: su pila se mide en cada sample()
+  bool watchTask(const char *name, TaskHandle_t task) {
+    TaskSlot *t = slotFor(name);
+    if (!t) return false;
+    t->task = task;
+    return true;
+  }
+
+  // Tareas que terminan: guardan su pila libre antes de borrarse y quien
+  // recibe el resultado la apunta aquí (se queda el mínimo)
+  void noteStack(const char *name, uint32_t freeBytes) {
+    TaskSlot *t = slotFor(name);
+    if (!t) return;
+    if (t->minFree == 0 || freeBytes < t->minFree) t->minFree = freeBytes;
+    if (t->windowMin == 0 || freeBytes < t->windowMin) t->windowMin = freeBytes;
+  }
+
+  bool watchAllocs(const char *name, AllocCounter *counter) {
+    if (_nCounters >= MAX_COUNTERS) return false;
+    _counters[_nCounters].name = name;
+    _counters[_nCounters].counter = counter;
+    _nCounters++;
+    return true;
+  }
+
+  const Sample &sample() {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    _s.freeBytes = (uint32_t)info.total_free_bytes;
+    _s.largestBlock = (uint32_t)info.largest_free_block;
+    _s.minFreeBytes = (uint32_t)info.minimum_free_bytes;
+    _s.allocatedBlocks = (uint32_t)info.allocated_blocks;
+    _s.freeBlocks = (uint32_t)info.free_blocks;
+    _s.fragPct = _s.freeBytes ? (uint8_t)(100 - (uint64_t)_s.largestBlock * 100 / _s.freeBytes) : 0;
+    // en ESP-IDF el high-water mark va en bytes. Es el mínimo de toda la
+    // vida de la tarea: para la alarma sólo cuenta si bajó desde el último
+    // checkAlarms() (o lo apuntó noteStack()), así se rearma cuando deja de
+    // empeorar. Aquí sólo se acumula: /status o /metrics no vacían la ventana.
+    for (uint8_t i = 0; i < _nTasks; ++i) {
+      TaskSlot &t = _tasks[i];
+      if (!t.task) continue;
+      uint32_t hwm = uxTaskGetStackHighWaterMark(t.task);
+      if (t.minFree == 0 || hwm < t.minFree) {
+        t.minFree = hwm;
+        if (t.windowMin == 0 || hwm < t.windowMin) t.windowMin = hwm;
+      }
+    }
+    return _s;
+  }
+
+  const Sample &last() const { return _s; }
+
+  // Evalúa los umbrales con la última muestra. Devuelve sólo las alarmas
+  // que acaban de saltar; una alarma se rearma cuando el valor se recupera
+  // con 1/8 de margen.
+  uint8_t checkAlarms() {
+    uint8_t now = 0;
+    now |= level(ALARM_LOW_FREE, alarmFreeBytes && _s.freeBytes < alarmFreeBytes,
+                 _s.freeBytes > alarmFreeBytes + alarmFreeBytes / 8);
+    now |= level(ALARM_FRAGMENTED, alarmFragPct && _s.fragPct > alarmFragPct,
+                 _s.fragPct + alarmFragPct / 8 < alarmFragPct);
+    now |= level(ALARM_SMALL_BLOCK, alarmLargestBlock && _s.largestBlock < alarmLargestBlock,
+                 _s.largestBlock > alarmLargestBlock + alarmLargestBlock / 8);
+    // la ventana de pila se cierra aquí, no en sample()
+    _stackWindow = 0;
+    for (uint8_t i = 0; i < _nTasks; ++i) {
+      TaskSlot &t = _tasks[i];
+      if (t.windowMin && (_stackWindow == 0 || t.windowMin < _stackWindow)) _stackWindow = t.windowMin;
+      t.windowMin = 0;
+    }
+    uint32_t stack = _stackWindow;
+    now |= level(ALARM_LOW_STACK, alarmStackBytes && stack && stack < alarmStackBytes,
+                 stack == 0 || stack > alarmStackBytes + alarmStackBytes / 8);
+    uint8_t rising = now & ~_alarms;
+    _alarms = now;
+    return rising;
+  }
+
+  uint8_t alarms() const { return _alarms; }
+
+  // Pila libre más baja de todas las tareas vigiladas desde el arranque (0 = sin datos)
+  uint32_t minStack() const {
+    uint32_t m = 0;
+    for (uint8_t i = 0; i < _nTasks; ++i) {
+      uint32_t v = _tasks[i].minFree;
+      if (v && (m == 0 || v < m)) m = v;
+    }
+    return m;
+  }
+
+  // Bloque de texto para /status (Out: TextBuffer)
+  template <class Out>
+  void printTo(Out &msg) const {
+    msg.printf("Heap libre: %lu B (mín %lu B)\n", (unsigned long)_s.freeBytes, (unsigned long)_s.minFreeBytes);
+    msg.printf("Mayor bloque: %lu B, frag %u%%, %lu bloques en uso\n", (unsigned long)_s.largestBlock,
+               (unsigned)_s.fragPct, (unsigned long)_s.allocatedBlocks);
+    if (_nTasks) {
+      msg.print("Pila libre:");
+      for (uint8_t i = 0; i < _nTasks; ++i) {
+        msg.printf(" %s %lu B%s", _tasks[i].name, (unsigned long)_tasks[i].minFree, i + 1 < _nTasks ? "," : "\n");
+      }
+    }
+    for (uint8_t i = 0; i < _nCounters; ++i) {
+      const AllocCounter *c = _counters[i].counter;
+      msg.printf("Sin liberar %s: %lu bloques en %lu de %lu pasadas (peor %lu)\n", _counters[i].name,
+                 (unsigned long)c->leakedBlocks, (unsigned long)c->leakyRuns, (unsigned long)c->runs,
+                 (unsigned long)c->maxLeaked);
+      if (AllocCounter::hooks()) {
+        msg.printf("Reservas %s: %lu (peor pasada %lu)\n", _counters[i].name, (unsigned long)c->allocs,
+                   (unsigned long)c->maxAllocs);
+      }
+    }
+  }
+
+  // Lo mismo para /metrics (PromWriter de MetricsServer.h)
+  template <class Prom>
+  void metricsTo(Prom &m) const {
+    m.gauge("heap_free_bytes", "heap libre", _s.freeBytes);
+    m.gauge("heap_min_free_bytes", "mínimo de heap libre desde el arranque", _s.minFreeBytes);
+    m.gauge("heap_largest_block_bytes", "mayor bloque libre", _s.largestBlock);
+    m.gauge("heap_fragmentation_percent", "100 - mayor bloque / libre", _s.fragPct);
+    m.gauge("heap_allocated_blocks", "bloques en uso", _s.allocatedBlocks);
+    char labels[40];
+    if (_nTasks) {
+      m.family("task_stack_min_free_bytes", "gauge", "pila libre mínima por tarea");
+      for (uint8_t i = 0; i < _nTasks; ++i) {
+        snprintf(labels, sizeof(labels), "task=\"%s\"", _tasks[i].name);
+        m.value("task_stack_min_free_bytes", _tasks[i].minFree, labels);
+      }
+    }
+    if (_nCounters) {
+      m.family("heap_leaked_blocks_total", "counter", "bloques que quedan sin liberar en caminos vigilados");
+      for (uint8_t i = 0; i < _nCounters; ++i) {
+        snprintf(labels, sizeof(labels), "path=\"%s\"", _counters[i].name);
+        m.value("heap_leaked_blocks_total", _counters[i].counter->leakedBlocks, labels);
+      }
+      if (AllocCounter::hooks()) {
+        m.family("heap_allocs_total", "counter", "reservas de heap hechas en caminos vigilados");
+        for (uint8_t i = 0; i < _nCounters; ++i) {
+          snprintf(labels, sizeof(labels), "path=\"%s\"", _counters[i].name);
+          m.value("heap_allocs_total", _counters[i].counter->allocs, labels);
+        }
+      }
+    }
+  }
+
+  template <class Out>
+  void printAlarms(Out &msg, uint8_t bits) const {
+    if (bits & ALARM_LOW_FREE) msg.printf("⚠️ Heap libre bajo: %lu B\n", (unsigned long)_s.freeBytes);
+    if (bits & ALARM_FRAGMENTED) msg.printf("⚠️ Heap fragmentado: %u%%\n", (unsigned)_s.fragPct);
+    if (bits & ALARM_SMALL_BLOCK) msg.printf("⚠️ Mayor bloque libre: %lu B\n", (unsigned long)_s.largestBlock);
+    if (bits & ALARM_LOW_STACK) msg.printf("⚠️ Pila casi llena: %lu B libres\n", (unsigned long)_stackWindow);
+  }
+
+private:
+  struct TaskSlot {
+    const char *name;
+    TaskHandle_t task;
+    uint32_t minFree;        // desde el arranque
+    uint32_t windowMin;      // nuevo mínimo desde el último checkAlarms() (0 = no bajó)
+  };
+  struct CounterSlot {
+    const char *name;
+    AllocCounter *counter;
+  };
+
+  Sample _s = {};
+  TaskSlot _tasks[MAX_TASKS];
+  uint8_t _nTasks = 0;
+  CounterSlot _counters[MAX_COUNTERS];
+  uint8_t _nCounters = 0;
+  uint8_t _alarms = 0;
+  uint32_t _stackWindow = 0;   // pila libre más baja del último intervalo evaluado (0 = sin datos)
+
+  TaskSlot *slotFor(const char *name) {
+    for (uint8_t i = 0; i < _nTasks; ++i) {
+      if (strcmp(_tasks[i].name, name) == 0) return &_tasks[i];
+    }
+    if (_nTasks >= MAX_TASKS) return nullptr;
+    TaskSlot &t = _tasks[_nTasks++];
+    t.name = name;
+    t.task = nullptr;
+    t.minFree = 0;
+    t.windowMin = 0;
+    return &t;
+  }
+
+  // Bit activo si se cruza el umbral; sigue activo hasta que se recupera
+  uint8_t level(uint8_t bit, bool crossed, bool recovered) const {
+    if (crossed) return bit;
+    if ((_alarms & bit) && !recovered) return bit;
+    return 0;
+  }
+};
@@ -0,0 +1,331 @@
+// HostNames.h
+// Nombres de los hosts de la red por tres vías, consultadas a la vez:
+//   - DNS inverso (PTR a.b.c.d.in-addr.arpa al servidor DNS: el router suele
+//     devolver el nombre que el equipo dio al pedir DHCP),
+//   - mDNS (la misma pregunta PTR, unicast al puerto 5353 del host),
+//   - NetBIOS (Node Status al puerto 137 del host: equipos Windows/Samba).
+//
+// Las consultas van en tandas de BATCH hosts (las tres de cada host a la
+// vez, por UDP sin bloquear) y cada tanda espera como mucho batchTimeoutMs.
+// Los nombres (y también los "sin nombre") quedan en una caché con TTL, así
+// que en los siguientes escaneos sólo se pregunta por hosts nuevos.
+//
+// La caché no tiene mutex: resolve() y name() se llaman desde una sola
+// tarea cada vez (en el escáner, la tarea de escaneo escribe y loop() lee
+// cuando ya ha terminado).
+#pragma once
+
+#include <Arduino.h>
+#include "lwip/sockets.h"
+
+class HostNames {
+public:
+  enum { ENTRIES = 64, NAME_MAX = 32, BATCH = 8 };
+  enum Source : uint8_t { NONE, DNS, MDNS, NETBIOS };   // de más a menos preferida
+
+  struct Stats {
+    uint32_t asked;         // hosts consultados (no estaban en caché)
+    uint32_t named;         // de ésos, con nombre
+    uint32_t cached;        // ya estaban en caché
+    uint32_t sendErrors;
+    unsigned long elapsedMs;
+  };
+
+  uint32_t ttlSec = 3600;
+  uint32_t negativeTtlSec = 600;    // "sin nombre" se vuelve a preguntar antes
+  uint16_t batchTimeoutMs = 600;
+  uint32_t dnsServer = 0;           // a.b.c.d -> a<<24 | ...; 0 = sin DNS inverso
+
+  // Busca el nombre de las IPs que no estén en caché, sin pasar de budgetMs
+  // (las que no dé tiempo quedan sin nombre hasta la próxima). Devuelve las
+  // IPs con nombre nuevo.
+  size_t resolve(const uint32_t *ips, size_t n, unsigned long budgetMs, Stats *stats = nullptr) {
+    Stats st;
+    memset(&st, 0, sizeof(st));
+    unsigned long t0 = millis();
+    int fds[3] = { openUdp(), openUdp(), openUdp() };   // DNS, mDNS, NetBIOS
+    size_t i = 0;
+    while (i < n && millis() - t0 < budgetMs && fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0) {
+      // siguiente tanda: hasta BATCH IPs que falten en la caché
+      _n = 0;
+      for (; i < n && _n < BATCH; ++i) {
+        if (fresh(ips[i])) {
+          st.cached++;
+          continue;
+        }
+        Pending &p = _batch[_n++];
+        p.ip = ips[i];
+        p.id = ++_id;
+        p.source = NONE;
+        p.name[0] = '\0';
+      }
+      if (_n == 0) break;
+
+      for (uint8_t k = 0; k < _n; ++k) {
+        if (!askPtr(fds[0], dnsServer, 53, _batch[k])) st.sendErrors++;
+        if (!askPtr(fds[1], _batch[k].ip, 5353, _batch[k])) st.sendErrors++;
+        if (!askNetbios(fds[2], _batch[k])) st.sendErrors++;
+      }
+
+      unsigned long left = budgetMs - (millis() - t0);
+      unsigned long until = millis() + (left < batchTimeoutMs ? left : batchTimeoutMs);
+      while ((long)(until - millis()) > 0 && !batchDone()) {
+        waitReadable(fds, 20);
+        drain(fds[0], DNS);
+        drain(fds[1], MDNS);
+        drain(fds[2], NETBIOS);
+      }
+      for (uint8_t k = 0; k < _n; ++k) {
+        store(_batch[k]);
+        st.asked++;
+        if (_batch[k].source != NONE) st.named++;
+      }
+    }
+    for (int f = 0; f < 3; ++f) {
+      if (fds[f] >= 0) closesocket(fds[f]);
+    }
+    st.elapsedMs = millis() - t0;
+    if (stats) *stats = st;
+    return st.named;
+  }
+
+  // Nombre en caché (aunque haya caducado), o nullptr si no se conoce
+  const char *name(uint32_t ip) const {
+    const Entry *e = find(ip);
+    return e && e->name[0] ? e->name : nullptr;
+  }
+
+private:
+  struct Entry {
+    uint32_t ip;            // 0 = libre
+    uint32_t at;            // s (millis()/1000) al guardarlo
+    Source source;
+    char name[NAME_MAX];
+  };
+  struct Pending {
+    uint32_t ip;
+    uint16_t id;            // id de la consulta DNS/mDNS y de NetBIOS
+    Source source;
+    char name[NAME_MAX];
+  };
+
+  Entry _cache[ENTRIES] = {};
+  Pending _batch[BATCH];
+  uint8_t _n = 0;
+  uint16_t _id = 0;
+
+  static uint32_t nowSec() { return millis() / 1000; }
+
+  const Entry *find(uint32_t ip) const {
+    for (int k = 0; k < ENTRIES; ++k) {
+      if (_cache[k].ip == ip) return &_cache[k];
+    }
+    return nullptr;
+  }
+
+  bool fresh(uint32_t ip) const {
+    const Entry *e = find(ip);
+    if (!e) return false;
+    return nowSec() - e->at < (e->name[0] ? ttlSec : negativeTtlSec);
+  }
+
+  // En la entrada de esa IP, una libre o la más antigua
+  void store(const Pending &p) {
+    Entry *e = (Entry *)find(p.ip);
+    if (!e) {
+      e = &_cache[0];
+      for (int k = 0; k < ENTRIES; ++k) {
+        if (_cache[k].ip == 0) {
+          e = &_cache[k];
+          break;
+        }
+        if (_cache[k].at < e->at) e = &_cache[k];
+      }
+    }
+    e->ip = p.ip;
+    e->at = nowSec();
+    e->source = p.source;
+    memcpy(e->name, p.name, NAME_MAX);
+  }
+
+  bool batchDone() const {
+    // DNS es la mejor fuente: si todos la tienen no hace falta esperar más
+    for (uint8_t k = 0; k < _n; ++k) {
+      if (_batch[k].source != DNS) return false;
+    }
+    return true;
+  }
+
+  static int openUdp() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+  }
+
+  static bool sendTo(int fd, uint32_t ip, uint16_t port, const uint8_t *pkt, size_t len) {
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(ip);
+    return sendto(fd, pkt, len, 0, (struct sockaddr *)&to, sizeof(to)) == (int)len;
+  }
+
+  static size_t putHeader(uint8_t *pkt, uint16_t id, uint16_t flags) {
+    memset(pkt, 0, 12);
+    pkt[0] = id >> 8;
+    pkt[1] = id & 0xFF;
+    pkt[2] = flags >> 8;
+    pkt[3] = flags & 0xFF;
+    pkt[5] = 1;             // una pregunta
+    return 12;
+  }
+
+  // PTR d.c.b.a.in-addr.arpa (DNS con recursión; mDNS igual, sin ella)
+  bool askPtr(int fd, uint32_t server, uint16_t port, const Pending &p) {
+    if (!server) return true;
+    uint8_t pkt[64];
+    size_t len = putHeader(pkt, p.id, port == 53 ? 0x0100 : 0);
+    for (int b = 0; b < 4; ++b) {
+      char label[4];
+      uint8_t l = (uint8_t)snprintf(label, sizeof(label), "%u", (unsigned)((p.ip >> (8 * b)) & 0xFF));
+      pkt[len++] = l;
+      memcpy(pkt + len, label, l);
+      len += l;
+    }
+    static const uint8_t tail[] = { 7, 'i', 'n', '-', 'a', 'd', 'd', 'r', 4, 'a', 'r', 'p', 'a', 0,
+                                    0, 12, 0, 1 };   // PTR, IN
+    memcpy(pkt + len, tail, sizeof(tail));
+    len += sizeof(tail);
+    return sendTo(fd, server, port, pkt, len);
+  }
+
+  // Node Status (NBSTAT) con el nombre comodín "*"
+  bool askNetbios(int fd, const Pending &p) {
+    uint8_t pkt[50];
+    size_t len = putHeader(pkt, p.id, 0);
+    pkt[len++] = 32;
+    for (int c = 0; c < 16; ++c) {
+      uint8_t b = c == 0 ? '*' : 0;
+      pkt[len++] = 'A' + (b >> 4);
+      pkt[len++] = 'A' + (b & 0x0F);
+    }
+    pkt[len++] = 0;
+    static const uint8_t tail[] = { 0, 0x21, 0, 1 };   // NBSTAT, IN
+    memcpy(pkt + len, tail, sizeof(tail));
+    len += sizeof(tail);
+    return sendTo(fd, p.ip, 137, pkt, len);
+  }
+
+  static void waitReadable(const int *fds, unsigned long maxMs) {
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    int maxFd = -1;
+    for (int f = 0; f < 3; ++f) {
+      FD_SET(fds[f], &rfds);
+      if (fds[f] > maxFd) maxFd = fds[f];
+    }
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = maxMs * 1000;
+    select(maxFd + 1, &rfds, nullptr, nullptr, &tv);
+  }
+
+  void drain(int fd, Source source) {
+    uint8_t buf[512];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    int len;
+    while ((len = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromLen)) > 12) {
+      fromLen = sizeof(from);
+      uint16_t id = (uint16_t)(buf[0] << 8 | buf[1]);
+      uint32_t src = ntohl(from.sin_addr.s_addr);
+      // DNS: por id (responde el servidor); mDNS y NetBIOS: por IP de origen
+      Pending *p = nullptr;
+      for (uint8_t k = 0; k < _n && !p; ++k) {
+        if (source == DNS ? _batch[k].id == id : _batch[k].ip == src) p = &_batch[k];
+      }
+      if (!p || (p->source != NONE && p->source <= source)) continue;
+      char name[NAME_MAX];
+      bool ok = source == NETBIOS ? parseNetbios(buf, len, name) : parsePtr(buf, len, name);
+      if (!ok) continue;
+      p->source = source;
+      memcpy(p->name, name, NAME_MAX);
+    }
+  }
+
+  // Salta un nombre DNS (etiquetas o puntero). 0 si está mal formado.
+  static size_t skipName(const uint8_t *buf, size_t len, size_t pos) {
+    while (pos < len) {
+      uint8_t l = buf[pos];
+      if (l == 0) return pos + 1;
+      if ((l & 0xC0) == 0xC0) return pos + 2 <= len ? pos + 2 : 0;
+      pos += 1 + l;
+    }
+    return 0;
+  }
+
+  // Lee un nombre DNS (con compresión) como "a.b.c", cortado a NAME_MAX
+  static bool readName(const uint8_t *buf, size_t len, size_t pos, char *out) {
+    size_t o = 0;
+    for (int jumps = 0; pos < len && jumps < 8;) {
+      uint8_t l = buf[pos];
+      if (l == 0) break;
+      if ((l & 0xC0) == 0xC0) {
+        if (pos + 1 >= len) return false;
+        pos = ((l & 0x3F) << 8) | buf[pos + 1];
+        jumps++;
+        continue;
+      }
+      if (pos + 1 + l > len) return false;
+      if (o > 0 && o < NAME_MAX - 1) out[o++] = '.';
+      for (uint8_t c = 0; c < l && o < NAME_MAX - 1; ++c) out[o++] = (char)buf[pos + 1 + c];
+      pos += 1 + l;
+    }
+    out[o] = '\0';
+    // sin el ".local" de mDNS
+    if (o > 6 && strcmp(out + o - 6, ".local") == 0) out[o - 6] = '\0';
+    return out[0] != '\0';
+  }
+
+  // Primera respuesta PTR
+  static bool parsePtr(const uint8_t *buf, size_t len, char *out) {
+    uint16_t qd = buf[4] << 8 | buf[5], an = buf[6] << 8 | buf[7];
+    if ((buf[3] & 0x0F) != 0 || an == 0) return false;   // rcode != 0 (NXDOMAIN...)
+    size_t pos = 12;
+    for (uint16_t q = 0; q < qd && pos; ++q) {
+      pos = skipName(buf, len, pos);
+      if (pos) pos += 4;
+    }
+    for (uint16_t a = 0; a < an && pos && pos < len; ++a) {
+      pos = skipName(buf, len, pos);
+      if (!pos || pos + 10 > len) return false;
+      uint16_t type = buf[pos] << 8 | buf[pos + 1];
+      uint16_t rdlen = buf[pos + 8] << 8 | buf[pos + 9];
+      pos += 10;
+      if (type == 12) return readName(buf, len, pos, out);
+      pos += rdlen;
+    }
+    return false;
+  }
+
+  // Primer nombre único (no de grupo) de tipo 0x00 (estación) del NBSTAT
+  static bool parseNetbios(const uint8_t *buf, size_t len, char *out) {
+    size_t pos = skipName(buf, len, 12);
+    if (!pos || pos + 11 > len) return false;
+    uint8_t count = buf[pos + 10];
+    pos += 11;
+    for (uint8_t k = 0; k < count && pos + 18 <= len; ++k, pos += 18) {
+      bool group = buf[pos + 16] & 0x80;
+      if (buf[pos + 15] != 0x00 || group) continue;
+      size_t l = 15;
+      while (l > 0 && buf[pos + l - 1] == ' ') l--;
+      if (l == 0) continue;
+      if (l > NAME_MAX - 1) l = NAME_MAX - 1;
+      memcpy(out, buf + pos, l);
+      out[l] = '\0';
+      return true;
+    }
+    return false;
+  }
+};
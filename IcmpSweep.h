@@ -0,0 +1,281 @@
+// IcmpSweep.h
+// Barrido ICMP concurrente de un rango de IPs sobre un socket raw de lwIP.
+// En vez de un ping bloqueante por host, mantiene una ventana de echo
+// requests en vuelo, empareja las respuestas por id/secuencia y reenvía con
+// un timeout adaptativo (SRTT/RTTVAR como TCP). Un host muerto ya no cuesta
+// un timeout completo de reloj: se solapa con los demás.
+//
+// Las IPs van en uint32_t con el orden "humano" (a.b.c.d -> a<<24 | ...),
+// igual que ipToUint32() en el sketch del escáner.
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "lwip/sockets.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/icmp.h"
+#include "lwip/ip.h"
+
+class IcmpSweep {
+public:
+  enum { MAX_WINDOW = 64, PAYLOAD_LEN = 16 };
+
+  struct Stats {
+    uint32_t probed;        // hosts distintos sondeados
+    uint32_t sent;          // echo requests enviados (incluye reenvíos)
+    uint32_t retransmits;
+    uint32_t alive;
+    uint32_t sendErrors;
+    uint32_t sendGaveUp;    // hosts dados por muertos sin poder enviarles nada
+    bool linkLost;          // se cortó el WiFi a mitad de barrido
+    uint16_t srttMs;        // RTT suavizado al final
+    uint16_t rtoMs;
+    unsigned long elapsedMs;
+  };
+
+  // Ajustes (valores por defecto pensados para una LAN WiFi)
+  uint16_t window = 10;         // echo requests en vuelo (lwIP: ~10 entradas ARP)
+  uint8_t retries = 1;          // reenvíos por host antes de darlo por muerto
+  uint8_t maxSendFails = 3;     // sendto() fallidos seguidos por host antes de descartarlo
+  uint16_t initialRtoMs = 400;
+  uint16_t minRtoMs = 80;
+  uint16_t maxRtoMs = 1500;
+
+  // Si apunta a true durante el barrido, se aborta (lo usa el sketch para cancelar)
+  volatile bool *cancel = nullptr;
+
+  // Bitmap opcional (mismo formato que aliveBits): esos hosts se sondean
+  // antes que el resto (p. ej. los que estaban vivos en el escaneo anterior)
+  const uint8_t *priority = nullptr;
+
+  // Progreso del barrido en curso (se puede leer desde otra tarea)
+  volatile uint32_t progress = 0;   // hosts ya lanzados
+  volatile uint32_t total = 0;
+  volatile uint32_t found = 0;
+
+  // Sondea first32 .. first32+count-1, saltando skip32 (nuestra IP).
+  // aliveBits: bitmap de (count+7)/8 bytes, puesto a cero por quien llama;
+  // el bit i indica que first32+i respondió. Devuelve false si no se pudo
+  // abrir el socket o si se pierde el WiFi durante el barrido.
+  bool run(uint32_t first32, uint32_t count, uint32_t skip32, uint8_t *aliveBits,
+           Stats *stats = nullptr) {
+    memset(&_st, 0, sizeof(_st));
+    progress = 0;
+    total = (skip32 - first32 < count) ? count - 1 : count;
+    found = 0;
+    unsigned long t0 = millis();
+    int fd = socket(AF_INET, SOCK_RAW, IP_PROTO_ICMP);
+    if (fd < 0) return false;
+
+    _id = (uint16_t)esp_random();
+    _seq = 0;
+    _srtt = 0;
+    _rttvar = 0;
+    _rto = initialRtoMs;
+    uint16_t win = window == 0 ? 1 : (window > MAX_WINDOW ? (uint16_t)MAX_WINDOW : window);
+    for (uint16_t s = 0; s < MAX_WINDOW; ++s) _slots[s].active = false;
+
+    _first = first32;
+    _count = count;
+    _skip = skip32;
+    _next = 0;
+    _phase = priority ? 0 : 1;
+    bool more = true;         // quedan hosts sin sondear
+    uint16_t active = 0;
+
+    while (true) {
+      if (cancel && *cancel) break;
+      if (WiFi.status() != WL_CONNECTED) {   // sin red todos los envíos fallarían
+        _st.linkLost = true;
+        break;
+      }
+      unsigned long now = millis();
+
+      // 1) timeouts: reenviar o dar por muerto
+      for (uint16_t s = 0; s < win; ++s) {
+        Slot &sl = _slots[s];
+        if (!sl.active) continue;
+        if (now - sl.sentAt < slotRto(sl)) continue;
+        if (sl.tries > retries || sl.sendFails >= maxSendFails) {
+          if (sl.sendFails >= maxSendFails) _st.sendGaveUp++;
+          sl.active = false;
+          active--;
+          continue;
+        }
+        if (sendProbe(fd, sl, now)) _st.retransmits++;
+      }
+
+      // 2) rellenar la ventana con hosts nuevos
+      for (uint16_t s = 0; s < win && more; ++s) {
+        Slot &sl = _slots[s];
+        if (sl.active) continue;
+        uint32_t idx;
+        if (!(more = nextTarget(idx))) break;
+        sl.active = true;
+        sl.target = first32 + idx;
+        sl.tries = 0;
+        sl.sendFails = 0;
+        progress = progress + 1;
+        active++;
+        _st.probed++;
+        if (!sendProbe(fd, sl, now)) break;   // sin buffers: seguimos tras leer respuestas
+      }
+
+      if (active == 0 && !more) break;
+
+      // 3) esperar respuestas (máx 20 ms) y recogerlas
+      waitReadable(fd, 20);
+      drainReplies(fd, first32, count, aliveBits, win, active);
+      yield();
+    }
+
+    closesocket(fd);
+    _st.srttMs = (uint16_t)_srtt;
+    _st.rtoMs = (uint16_t)_rto;
+    _st.elapsedMs = millis() - t0;
+    if (stats) *stats = _st;
+    return !_st.linkLost;
+  }
+
+private:
+  struct Slot {
+    bool active;
+    uint8_t tries;            // envíos hechos para este host
+    uint8_t sendFails;        // sendto() fallidos seguidos
+    uint16_t seq;             // secuencia del último envío
+    uint32_t target;
+    unsigned long sentAt;
+  };
+
+  Slot _slots[MAX_WINDOW];
+  Stats _st;
+  uint16_t _id = 0;
+  uint16_t _seq = 0;
+  uint32_t _srtt = 0;         // ms (0 = sin muestras aún)
+  uint32_t _rttvar = 0;
+  uint32_t _rto = 400;
+
+  // recorrido del rango: fase 0 = hosts de 'priority', fase 1 = el resto
+  uint32_t _first = 0;
+  uint32_t _count = 0;
+  uint32_t _skip = 0;
+  uint32_t _next = 0;
+  uint8_t _phase = 1;
+
+  bool nextTarget(uint32_t &idx) {
+    while (true) {
+      if (_next >= _count) {
+        if (_phase == 1) return false;
+        _phase = 1;
+        _next = 0;
+        continue;
+      }
+      uint32_t i = _next++;
+      bool pri = priority && (priority[i >> 3] & (1 << (i & 7)));
+      if (pri != (_phase == 0)) continue;
+      if (_first + i == _skip) continue;   // nuestra IP
+      idx = i;
+      return true;
+    }
+  }
+
+  unsigned long slotRto(const Slot &sl) const {
+    // backoff exponencial en los reenvíos del mismo host
+    uint32_t r = _rto << (sl.tries > 1 ? sl.tries - 1 : 0);
+    return r > maxRtoMs ? maxRtoMs : r;
+  }
+
+  bool sendProbe(int fd, Slot &sl, unsigned long now) {
+    uint8_t pkt[sizeof(struct icmp_echo_hdr) + PAYLOAD_LEN];
+    struct icmp_echo_hdr *echo = (struct icmp_echo_hdr *)pkt;
+    sl.seq = ++_seq;
+    ICMPH_TYPE_SET(echo, ICMP_ECHO);
+    ICMPH_CODE_SET(echo, 0);
+    echo->id = htons(_id);
+    echo->seqno = htons(sl.seq);
+    echo->chksum = 0;
+    for (int i = 0; i < PAYLOAD_LEN; ++i) pkt[sizeof(struct icmp_echo_hdr) + i] = (uint8_t)i;
+    echo->chksum = inet_chksum(pkt, sizeof(pkt));
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(sl.target);
+    sl.sentAt = now;
+    if (sendto(fd, pkt, sizeof(pkt), MSG_DONTWAIT, (struct sockaddr *)&to, sizeof(to)) < 0) {
+      // pbufs/ARP llenos: no cuenta como intento, se reintenta tras el RTO
+      // (pero sólo maxSendFails veces: si la red no vuelve, el host se descarta)
+      _st.sendErrors++;
+      sl.sendFails++;
+      return false;
+    }
+    sl.sendFails = 0;
+    sl.tries++;
+    _st.sent++;
+    return true;
+  }
+
+  void waitReadable(int fd, unsigned long maxMs) {
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = maxMs * 1000;
+    select(fd + 1, &rfds, nullptr, nullptr, &tv);
+  }
+
+  void drainReplies(int fd, uint32_t first32, uint32_t count, uint8_t *aliveBits,
+                    uint16_t win, uint16_t &active) {
+    uint8_t buf[64];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    int len;
+    while ((len = recvfrom(fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen)) > 0) {
+      fromLen = sizeof(from);
+      // lwIP entrega el paquete IP completo en sockets raw IPv4
+      struct ip_hdr *iph = (struct ip_hdr *)buf;
+      int ihl = IPH_HL(iph) * 4;
+      if (len < ihl + (int)sizeof(struct icmp_echo_hdr)) continue;
+      struct icmp_echo_hdr *echo = (struct icmp_echo_hdr *)(buf + ihl);
+      if (ICMPH_TYPE(echo) != ICMP_ER || ntohs(echo->id) != _id) continue;
+
+      uint32_t src = ntohl(from.sin_addr.s_addr);
+      if (src < first32 || src - first32 >= count) continue;
+      uint32_t idx = src - first32;
+      uint16_t seq = ntohs(echo->seqno);
+      unsigned long now = millis();
+
+      for (uint16_t s = 0; s < win; ++s) {
+        Slot &sl = _slots[s];
+        if (!sl.active || sl.target != src) continue;
+        // Karn: sólo se mide RTT si no hubo reenvío (no hay ambigüedad)
+        if (sl.tries == 1 && sl.seq == seq) updateRto(now - sl.sentAt);
+        sl.active = false;
+        active--;
+        break;
+      }
+      // también cuentan las respuestas tardías de hosts ya dados por muertos
+      if (!(aliveBits[idx >> 3] & (1 << (idx & 7)))) {
+        aliveBits[idx >> 3] |= (uint8_t)(1 << (idx & 7));
+        _st.alive++;
+        found = _st.alive;
+      }
+    }
+  }
+
+  // RFC 6298 en milisegundos
+  void updateRto(unsigned long rtt) {
+    if (_srtt == 0) {
+      _srtt = rtt ? rtt : 1;
+      _rttvar = rtt / 2;
+    } else {
+      uint32_t diff = _srtt > rtt ? _srtt - rtt : rtt - _srtt;
+      _rttvar = (3 * _rttvar + diff) / 4;
+      _srtt = (7 * _srtt + rtt) / 8;
+    }
+    _rto = _srtt + 4 * _rttvar;
+    if (_rto < minRtoMs) _rto = minRtoMs;
+    if (_rto > maxRtoMs) _rto = maxRtoMs;
+  }
+};
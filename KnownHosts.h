@@ -0,0 +1,142 @@
+// KnownHosts.h
+// Hosts vistos en el último escaneo, como bitmap (bit i -> first32+i, igual
+// que el aliveBits de IcmpSweep/ArpSweep). Ocupa (count+7)/8 bytes: 8 KB
+// con el tope de /16. Se guarda en NVS, así que sobrevive a reinicios.
+//
+// Sirve para dos cosas:
+//   - sondear primero los que estaban vivos (sweep.priority = known.bits()),
+//   - informar sólo de los cambios: nuevos, desaparecidos y los que siguen.
+//
+//   KnownHosts known;
+//   known.begin(prefs);                     // prefs ya abierto
+//   known.use(first32, count);              // carga el bitmap si es la misma red
+//   ... barrido en aliveBits ...
+//   known.diff(aliveBits, complete, d);     // recuento de cambios
+//   known.update(aliveBits, complete);      // y se guarda si ha cambiado
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+class KnownHosts {
+public:
+  struct Diff {
+    uint32_t joined;    // vivos ahora y no antes
+    uint32_t left;      // vivos antes y no ahora (sólo si el barrido fue completo)
+    uint32_t stayed;    // vivos antes y ahora
+  };
+
+  ~KnownHosts() { free(_bits); }
+
+  void begin(Preferences &prefs) { _prefs = &prefs; }
+
+  // Prepara el bitmap para el rango; si la red cambió empieza vacío.
+  // Devuelve false si no hay memoria.
+  bool use(uint32_t first32, uint32_t count) {
+    if (_bits && first32 == _first && count == _count) return true;
+    free(_bits);
+    _bits = (uint8_t *)calloc(bytesFor(count), 1);
+    _first = first32;
+    _count = count;
+    _history = false;
+    if (!_bits) {
+      _count = 0;
+      return false;
+    }
+    load();
+    return true;
+  }
+
+  // true si hay un escaneo anterior de esta misma red
+  bool hasHistory() const { return _history; }
+
+  // Bitmap para IcmpSweep::priority / ArpSweep::priority (nullptr si no hay)
+  const uint8_t *bits() const { return _history ? _bits : nullptr; }
+
+  uint32_t first() const { return _first; }
+  uint32_t count() const { return _count; }
+
+  bool known(uint32_t i) const { return _history && i < _count && test(_bits, i); }
+
+  uint32_t knownCount() const {
+    if (!_history) return 0;
+    uint32_t n = 0;
+    for (size_t b = 0; b < bytesFor(_count); ++b) n += __builtin_popcount(_bits[b]);
+    return n;
+  }
+
+  // Compara un barrido con lo conocido. Si el barrido no se completó
+  // (cancelado) no se cuenta a nadie como desaparecido.
+  void diff(const uint8_t *alive, bool complete, Diff &d) const {
+    memset(&d, 0, sizeof(d));
+    for (uint32_t i = 0; i < _count; ++i) {
+      bool now = test(alive, i), before = known(i);
+      if (now && before) d.stayed++;
+      else if (now) d.joined++;
+      else if (before && complete) d.left++;
+    }
+  }
+
+  // Barrido completo: pasa a ser lo conocido. Parcial: sólo se añaden los
+  // vivos. Se escribe en NVS sólo si algo cambió.
+  void update(const uint8_t *alive, bool complete) {
+    if (!_bits) return;
+    bool changed = !_history;
+    for (size_t b = 0; b < bytesFor(_count); ++b) {
+      uint8_t v = complete ? alive[b] : (uint8_t)(_bits[b] | alive[b]);
+      if (v != _bits[b]) changed = true;
+      _bits[b] = v;
+    }
+    _history = true;
+    if (changed) save();
+  }
+
+  uint32_t saves() const { return _saves; }
+
+private:
+  // Cabecera en una clave aparte: identifica la red y valida el bitmap
+  struct Header {
+    uint32_t first32;
+    uint32_t count;
+    uint32_t sum;       // FNV-1a del bitmap
+  };
+
+  Preferences *_prefs = nullptr;
+  uint8_t *_bits = nullptr;
+  uint32_t _first = 0;
+  uint32_t _count = 0;
+  bool _history = false;
+  uint32_t _saves = 0;
+
+  static size_t bytesFor(uint32_t count) { return (count + 7) / 8; }
+  static bool test(const uint8_t *bits, uint32_t i) { return bits[i >> 3] & (1 << (i & 7)); }
+
+  static uint32_t sum(const uint8_t *p, size_t n) {
+    uint32_t h = 2166136261u;
+    while (n--) h = (h ^ *p++) * 16777619u;
+    return h;
+  }
+
+  void load() {
+    if (!_prefs) return;
+    Header h;
+    size_t n = bytesFor(_count);
+    if (_prefs->getBytes("knownHdr", &h, sizeof(h)) != sizeof(h)) return;
+    if (h.first32 != _first || h.count != _count) return;
+    if (_prefs->getBytesLength("known") != n || _prefs->getBytes("known", _bits, n) != n) return;
+    if (sum(_bits, n) != h.sum) {
+      memset(_bits, 0, n);   // a medio escribir: se empieza de cero
+      return;
+    }
+    _history = true;
+  }
+
+  void save() {
+    if (!_prefs) return;
+    size_t n = bytesFor(_count);
+    Header h = { _first, _count, sum(_bits, n) };
+    if (_prefs->putBytes("known", _bits, n) != n) return;
+    if (_prefs->putBytes("knownHdr", &h, sizeof(h)) != sizeof(h)) return;
+    _saves++;
+  }
+};
@@ -0,0 +1,174 @@
+// MetricsServer.h
+// Endpoint HTTP /metrics en formato de texto de Prometheus, para que un
+// scraper de la red local lea el estado del dispositivo cada pocos segundos
+// sin pasar por Telegram. La página se monta en cada petición sobre un
+// buffer fijo del servidor (N bytes): nada de heap por petición.
+//
+//   void renderMetrics(PromWriter &m) {
+//     m.gauge("wifi_rssi_dbm", "RSSI del AP", WiFi.RSSI());
+//     m.counter("telegram_sent_total", "mensajes enviados", outbox.stats().sent);
+//   }
+//   MetricsServer<2048> metrics;
+//   metrics.begin(9100, renderMetrics);
+//   void loop() { metrics.service(); }
+//
+//   curl http://<ip del ESP32>:9100/metrics
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <stdarg.h>
+
+// ---- escritura de la página ----
+
+class PromWriter {
+public:
+  PromWriter(char *buf, size_t cap) : _buf(buf), _cap(cap) { _buf[0] = '\0'; }
+
+  // Cabecera de una familia (# HELP / # TYPE); luego sus muestras con value()
+  void family(const char *name, const char *type, const char *help) {
+    line("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  }
+
+  // Una muestra; labels sin llaves, p. ej. "task=\"loop\"" (nullptr = sin etiquetas)
+  void value(const char *name, int64_t v, const char *labels = nullptr) {
+    if (labels) line("%s{%s} %lld\n", name, labels, (long long)v);
+    else line("%s %lld\n", name, (long long)v);
+  }
+
+  // Milisegundos como segundos (la unidad de Prometheus), sin float
+  void seconds(const char *name, uint32_t ms, const char *labels = nullptr) {
+    if (labels) line("%s{%s} %lu.%03lu\n", name, labels, (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+    else line("%s %lu.%03lu\n", name, (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+  }
+
+  void gauge(const char *name, const char *help, int64_t v) {
+    family(name, "gauge", help);
+    value(name, v);
+  }
+
+  void counter(const char *name, const char *help, int64_t v) {
+    family(name, "counter", help);
+    value(name, v);
+  }
+
+  size_t size() const { return _len; }
+  bool truncated() const { return _truncated; }
+
+private:
+  char *_buf;
+  size_t _cap;
+  size_t _len = 0;
+  bool _truncated = false;
+
+  // Las líneas que no caben enteras no se escriben: la página sigue siendo
+  // válida, sólo le faltan las últimas métricas
+  void line(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (_truncated) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(_buf + _len, _cap - _len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= _cap - _len) {
+      _buf[_len] = '\0';
+      _truncated = true;
+      return;
+    }
+    _len += n;
+  }
+};
+
+// ---- servidor ----
+
+template <size_t N>
+class MetricsServer {
+public:
+  typedef void (*Render)(PromWriter &out);
+
+  uint16_t requestTimeoutMs = 1000;
+
+  void begin(uint16_t port, Render render) {
+    _render = render;
+    _server.begin(port);
+    _server.setNoDelay(true);
+  }
+
+  // Atiende como mucho una petición pendiente (no bloquea si no hay)
+  bool service() {
+    WiFiClient c = _server.available();
+    if (!c) return false;
+    handle(c);
+    c.stop();
+    return true;
+  }
+
+  // Una petición de un cliente ya conectado: GET /metrics -> página
+  void handle(Client &c) {
+    _deadline = millis() + requestTimeoutMs;
+    char line[96];
+    if (readLine(c, line, sizeof(line)) < 0) return;
+    bool ok = strncmp(line, "GET /metrics", 12) == 0 && (line[12] == ' ' || line[12] == '?');
+    int n;
+    while ((n = readLine(c, line, sizeof(line))) > 0) {}   // cabeceras: no interesan
+    if (n < 0) return;
+    if (!ok) {
+      reply(c, "404 Not Found", nullptr, 0);
+      return;
+    }
+
+    // las del propio endpoint van primero: si la página no cabe, se ve aquí
+    unsigned long t0 = micros();
+    PromWriter w(_page, sizeof(_page));
+    _scrapes++;
+    w.counter("metrics_scrapes_total", "peticiones a /metrics", _scrapes);
+    w.gauge("metrics_page_bytes", "bytes de la página anterior", _lastBytes);
+    w.gauge("metrics_render_us", "tiempo en montar la página anterior", _renderUs);
+    w.gauge("metrics_truncated", "1 si la página anterior no cupo entera (subir N)", _truncated);
+    if (_render) _render(w);
+    _renderUs = micros() - t0;
+    _lastBytes = w.size();
+    _truncated = w.truncated();
+    reply(c, "200 OK", _page, w.size());
+  }
+
+  uint32_t scrapes() const { return _scrapes; }
+
+private:
+  WiFiServer _server;
+  Render _render = nullptr;
+  char _page[N];
+  unsigned long _deadline = 0;
+  uint32_t _scrapes = 0;
+  uint32_t _renderUs = 0;
+  uint32_t _lastBytes = 0;
+  bool _truncated = false;
+
+  // Lee hasta '\n' sin el "\r\n" (lo que no cabe se descarta); -1 si vence
+  // el plazo o se corta la conexión
+  int readLine(Client &c, char *out, size_t size) {
+    size_t len = 0;
+    while (true) {
+      int ch = c.read();
+      if (ch < 0) {
+        if ((long)(millis() - _deadline) >= 0 || !c.connected()) return -1;
+        delay(1);
+        continue;
+      }
+      if (ch == '\n') break;
+      if (ch != '\r' && len + 1 < size) out[len++] = (char)ch;
+    }
+    out[len] = '\0';
+    return (int)len;
+  }
+
+  void reply(Client &c, const char *status, const char *body, size_t len) {
+    char head[128];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %u\r\nConnection: close\r\n\r\n",
+                     status, (unsigned)len);
+    c.write((const uint8_t *)head, n);
+    if (len) c.write((const uint8_t *)body, len);
+    c.flush();
+  }
+};
@@ -0,0 +1,138 @@
+// PersistentState.h
+// Estado persistente con escritura diferida a NVS. El sketch trabaja con
+// una copia en RAM; cada cambio sólo la marca como sucia, y se escribe en
+// flash cuando:
+//   - pasa flushIntervalMs desde el primer cambio sin guardar,
+//   - se acumulan flushAfterChanges cambios,
+//   - o se llama a flush() (antes de dormir o reiniciar).
+//
+// Se guarda como blob en dos claves alternas (A/B), cada una con número de
+// secuencia y CRC32. Al arrancar se queda la válida más reciente: si se va
+// la luz a mitad de una escritura queda la anterior, nunca una mezcla.
+//
+//   struct Config { uint32_t intervalMs; uint8_t enabled; };
+//   PersistentState<Config> state;
+//   state.begin(prefs, defaults);
+//   state.edit().enabled = 1;    // marca sucio
+//   state.service();             // en loop()
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+template <class T>
+class PersistentState {
+public:
+  unsigned long flushIntervalMs = 60000;
+  uint16_t flushAfterChanges = 32;
+
+  struct Stats {
+    uint32_t changes;     // cambios marcados
+    uint32_t writes;      // escrituras a NVS
+    uint32_t writeErrors;
+  };
+
+  // Carga el estado; si no hay copia válida usa 'defaults'. Devuelve true si
+  // había una copia guardada.
+  bool begin(Preferences &prefs, const T &defaults) {
+    _prefs = &prefs;
+    Blob a, b;
+    bool okA = load(keyFor(0), a);
+    bool okB = load(keyFor(1), b);
+    if (okA && (!okB || (int32_t)(a.seq - b.seq) > 0)) {
+      use(a, 0);
+    } else if (okB) {
+      use(b, 1);
+    } else {
+      _data = defaults;
+      _seq = 0;
+      _slot = 1;          // la primera escritura va a A
+      return false;
+    }
+    return true;
+  }
+
+  const T &get() const { return _data; }
+
+  // Acceso para modificar: cuenta como un cambio
+  T &edit() {
+    changed();
+    return _data;
+  }
+
+  void changed() {
+    if (_pending == 0) _dirtySince = millis();
+    if (_pending < 0xFFFF) _pending++;
+    _st.changes++;
+  }
+
+  // Llamar a menudo (loop): escribe si toca por tiempo o por número de cambios
+  void service() {
+    if (_pending == 0) return;
+    if (_pending >= flushAfterChanges || millis() - _dirtySince >= flushIntervalMs) flush();
+  }
+
+  // Escribe ya si hay cambios pendientes
+  bool flush() {
+    if (_pending == 0 || !_prefs) return true;
+    Blob blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.seq = _seq + 1;
+    blob.size = sizeof(T);
+    blob.data = _data;
+    blob.crc = crc32((const uint8_t *)&blob, offsetof(Blob, crc));
+    uint8_t slot = _slot ^ 1;   // la más antigua de las dos
+    if (_prefs->putBytes(keyFor(slot), &blob, sizeof(blob)) != sizeof(blob)) {
+      _st.writeErrors++;
+      return false;
+    }
+    _seq = blob.seq;
+    _slot = slot;
+    _pending = 0;
+    _st.writes++;
+    return true;
+  }
+
+  bool dirty() const { return _pending > 0; }
+  const Stats &stats() const { return _st; }
+
+private:
+  struct Blob {
+    uint32_t seq;
+    uint16_t size;        // sizeof(T) al guardar: descarta blobs de otra versión
+    T data;
+    uint32_t crc;
+  };
+
+  Preferences *_prefs = nullptr;
+  T _data;
+  uint32_t _seq = 0;
+  uint8_t _slot = 0;          // clave con la copia más reciente (0 = A)
+  uint16_t _pending = 0;
+  unsigned long _dirtySince = 0;
+  Stats _st = {};
+
+  static const char *keyFor(uint8_t slot) { return slot ? "stateB" : "stateA"; }
+
+  bool load(const char *key, Blob &b) {
+    memset(&b, 0, sizeof(b));
+    if (_prefs->getBytesLength(key) != sizeof(Blob)) return false;
+    if (_prefs->getBytes(key, &b, sizeof(b)) != sizeof(b)) return false;
+    return b.size == sizeof(T) && b.crc == crc32((const uint8_t *)&b, offsetof(Blob, crc));
+  }
+
+  void use(const Blob &b, uint8_t slot) {
+    _data = b.data;
+    _seq = b.seq;
+    _slot = slot;
+  }
+
+  static uint32_t crc32(const uint8_t *p, size_t n) {
+    uint32_t c = 0xFFFFFFFF;
+    while (n--) {
+      c ^= *p++;
+      for (uint8_t k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+    }
+    return ~c;
+  }
+};
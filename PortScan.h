@@ -0,0 +1,194 @@
+// PortScan.h
+// Escaneo de puertos TCP concurrente sobre sockets de lwIP. En vez de un
+// connect() bloqueante tras otro, mantiene una ventana de connect() no
+// bloqueantes en vuelo, cada uno con su propio timeout, y los atiende con
+// select(). Un puerto filtrado cuesta timeoutMs, pero solapado con los demás.
+//
+// Las IPs van en uint32_t con el orden "humano" (a.b.c.d -> a<<24 | ...),
+// igual que en IcmpSweep.
+#pragma once
+
+#include <Arduino.h>
+#include "lwip/sockets.h"
+
+class PortScan {
+public:
+  enum { MAX_WINDOW = 16, MAX_PORTS = 32 };
+
+  struct Stats {
+    uint32_t attempts;      // connect() lanzados
+    uint32_t open;
+    uint32_t refused;       // RST: el host está pero el puerto cerrado
+    uint32_t timeouts;      // sin respuesta (filtrado o host caído)
+    uint32_t errors;        // sin sockets libres u otros fallos locales
+    unsigned long elapsedMs;
+  };
+
+  // lwIP del ESP32 tiene pocos sockets (CONFIG_LWIP_MAX_SOCKETS, 10 por
+  // defecto) y Telegram ya usa dos: no subir mucho la ventana
+  uint16_t window = 6;
+  uint16_t timeoutMs = 800;     // por intento
+
+  volatile bool *cancel = nullptr;
+
+  // Progreso del escaneo en curso (se puede leer desde otra tarea)
+  volatile uint32_t progress = 0;   // connect() lanzados
+  volatile uint32_t total = 0;
+  volatile uint32_t found = 0;      // puertos abiertos
+
+  // Prueba cada puerto de ports (máx. MAX_PORTS) en cada IP de hosts.
+  // openMasks[i]: bit p a 1 si hosts[i]:ports[p] aceptó la conexión.
+  // Se alternan los hosts (no se machaca uno detrás de otro).
+  // Devuelve false si no se pudo abrir ningún socket.
+  bool run(const uint32_t *hosts, uint32_t nHosts, const uint16_t *ports, uint8_t nPorts,
+           uint32_t *openMasks, Stats *stats = nullptr) {
+    memset(&_st, 0, sizeof(_st));
+    if (nPorts > MAX_PORTS) nPorts = MAX_PORTS;
+    memset(openMasks, 0, nHosts * sizeof(uint32_t));
+    uint32_t n = nHosts * nPorts;
+    progress = 0;
+    total = n;
+    found = 0;
+    unsigned long t0 = millis();
+
+    uint16_t win = window == 0 ? 1 : (window > MAX_WINDOW ? (uint16_t)MAX_WINDOW : window);
+    for (uint16_t s = 0; s < MAX_WINDOW; ++s) _slots[s].fd = -1;
+
+    uint32_t next = 0;
+    uint16_t active = 0;
+    bool ok = true;
+    while (true) {
+      if (cancel && *cancel) break;
+
+      // 1) rellenar la ventana
+      bool starved = false;
+      for (uint16_t s = 0; s < win && next < n; ++s) {
+        Slot &sl = _slots[s];
+        if (sl.fd >= 0) continue;
+        uint32_t host = next % nHosts;
+        uint8_t port = (uint8_t)(next / nHosts);
+        int r = launch(sl, hosts[host], ports[port]);
+        if (r < 0) {                 // sin sockets: esperar a que se libere alguno
+          starved = true;
+          break;
+        }
+        next++;
+        progress = next;
+        _st.attempts++;
+        sl.host = host;
+        sl.port = port;
+        if (r == 1) {
+          active++;
+        } else if (r == 0) {
+          markOpen(sl, openMasks);   // conectó al momento (pasa en loopback)
+          finish(sl);
+        }                            // r == 2: rechazado al momento
+      }
+      if (active == 0) {
+        if (next >= n) break;
+        if (starved) {
+          ok = false;                // ni un socket libre: no hay nada que esperar
+          break;
+        }
+      }
+
+      // 2) esperar a que algún connect() termine (máx 20 ms)
+      fd_set wfds;
+      FD_ZERO(&wfds);
+      int maxFd = -1;
+      for (uint16_t s = 0; s < win; ++s) {
+        if (_slots[s].fd < 0) continue;
+        FD_SET(_slots[s].fd, &wfds);
+        if (_slots[s].fd > maxFd) maxFd = _slots[s].fd;
+      }
+      if (maxFd < 0) {
+        delay(20);
+        continue;
+      }
+      struct timeval tv;
+      tv.tv_sec = 0;
+      tv.tv_usec = 20 * 1000;
+      int ready = select(maxFd + 1, nullptr, &wfds, nullptr, &tv);
+
+      // 3) resultados y timeouts
+      unsigned long now = millis();
+      for (uint16_t s = 0; s < win; ++s) {
+        Slot &sl = _slots[s];
+        if (sl.fd < 0) continue;
+        if (ready > 0 && FD_ISSET(sl.fd, &wfds)) {
+          int err = 0;
+          socklen_t len = sizeof(err);
+          getsockopt(sl.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+          if (err == 0) markOpen(sl, openMasks);
+          else if (err == ECONNREFUSED || err == ECONNRESET) _st.refused++;
+          else _st.timeouts++;       // EHOSTUNREACH...: como si no contestara
+        } else if (now - sl.startedAt >= timeoutMs) {
+          _st.timeouts++;
+        } else {
+          continue;
+        }
+        finish(sl);
+        active--;
+      }
+    }
+
+    for (uint16_t s = 0; s < MAX_WINDOW; ++s) {
+      if (_slots[s].fd >= 0) finish(_slots[s]);   // cancelado
+    }
+    _st.elapsedMs = millis() - t0;
+    if (stats) *stats = _st;
+    return ok;
+  }
+
+private:
+  struct Slot {
+    int fd;                 // -1 = libre
+    uint32_t host;          // índice en hosts
+    uint8_t port;           // índice en ports
+    unsigned long startedAt;
+  };
+
+  Slot _slots[MAX_WINDOW];
+  Stats _st;
+
+  // 1 = en curso, 0 = ya conectado, 2 = ya rechazado, -1 = sin socket
+  int launch(Slot &sl, uint32_t ip, uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      _st.errors++;
+      return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(ip);
+    sl.fd = fd;
+    sl.startedAt = millis();
+    if (connect(fd, (struct sockaddr *)&to, sizeof(to)) == 0) return 0;
+    if (errno == EINPROGRESS) return 1;
+    // rechazo inmediato: cuenta como intento terminado
+    if (errno == ECONNREFUSED) _st.refused++;
+    else _st.timeouts++;
+    finish(sl);
+    return 2;
+  }
+
+  void markOpen(const Slot &sl, uint32_t *openMasks) {
+    openMasks[sl.host] |= 1UL << sl.port;
+    _st.open++;
+    found = _st.open;
+  }
+
+  // Cierra con RST (linger 0) si lwIP lo permite: el PCB se libera ya, sin
+  // quedarse en TIME_WAIT ocupando memoria
+  void finish(Slot &sl) {
+    struct linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+    setsockopt(sl.fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    closesocket(sl.fd);
+    sl.fd = -1;
+  }
+};
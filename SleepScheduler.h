@@ -0,0 +1,98 @@
+// SleepScheduler.h
+// Ciclo "despertar -> trabajo -> deep sleep" con periodo fijo. El tiempo
+// que se ha estado despierto se descuenta del sueño, así que los informes
+// salen cada periodMs aunque un ciclo tarde más que otro.
+//
+// El estado va en memoria RTC (se conserva en deep sleep) y sirve para
+// informar del ciclo de trabajo y de la energía estimada por informe. La
+// estimación usa corrientes medias configurables (activeMa con WiFi+TLS,
+// sleepUa en deep sleep); no mide nada.
+//
+//   RTC_DATA_ATTR SleepScheduler::State sleepState;
+//   SleepScheduler sched(sleepState);
+//   sched.begin();
+//   ... trabajo ...
+//   sched.sleep(60UL * 60UL * 1000UL);   // no vuelve
+#pragma once
+
+#include <Arduino.h>
+#include "esp_sleep.h"
+
+class SleepScheduler {
+public:
+  struct State {
+    uint32_t cycles;          // ciclos completados desde el encendido
+    uint32_t lastAwakeMs;
+    uint32_t lastSleepMs;
+    uint64_t totalAwakeMs;
+    uint64_t totalSleepMs;
+  };
+
+  // Valores típicos del ESP32-C3; ajústalos a la placa si se conocen
+  uint16_t activeMa = 80;       // media despierto con WiFi y TLS
+  uint16_t sleepUa = 10;        // deep sleep (chip + regulador de la placa)
+  uint16_t supplyMv = 3300;
+  uint32_t minSleepMs = 1000;
+
+  explicit SleepScheduler(State &st) : _st(st) {}
+
+  // true si venimos de un deep sleep programado (el estado RTC es válido)
+  bool begin() {
+    _woke = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    if (!_woke) memset(&_st, 0, sizeof(_st));
+    return _woke;
+  }
+
+  bool wokeFromSleep() const { return _woke; }
+  uint32_t cycles() const { return _st.cycles; }
+
+  // Duerme hasta el siguiente periodo (descontando lo que llevamos despiertos)
+  void sleep(uint32_t periodMs) {
+    uint32_t awake = millis();
+    uint32_t sleepMs = periodMs > awake + minSleepMs ? periodMs - awake : minSleepMs;
+    _st.cycles++;
+    _st.lastAwakeMs = awake;
+    _st.lastSleepMs = sleepMs;
+    _st.totalAwakeMs += awake;
+    _st.totalSleepMs += sleepMs;
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+    esp_deep_sleep_start();
+  }
+
+  // Ciclo de trabajo del último ciclo, en centésimas de % (123 = 1,23 %)
+  uint32_t lastDutyCentiPct() const {
+    uint64_t period = (uint64_t)_st.lastAwakeMs + _st.lastSleepMs;
+    return period ? (uint32_t)((uint64_t)_st.lastAwakeMs * 10000 / period) : 0;
+  }
+
+  // Energía estimada del último ciclo en mJ: mA·ms = µC, por V -> µJ
+  uint32_t lastEnergyMj() const {
+    uint64_t uC = (uint64_t)_st.lastAwakeMs * activeMa + (uint64_t)_st.lastSleepMs * sleepUa / 1000;
+    return (uint32_t)(uC * supplyMv / 1000 / 1000);
+  }
+
+  // Corriente media del último ciclo en µA
+  uint32_t lastAverageUa() const {
+    uint64_t period = (uint64_t)_st.lastAwakeMs + _st.lastSleepMs;
+    if (!period) return 0;
+    uint64_t nC = (uint64_t)_st.lastAwakeMs * activeMa * 1000 + (uint64_t)_st.lastSleepMs * sleepUa;
+    return (uint32_t)(nC / period);
+  }
+
+  // Línea para el informe (Out: TextBuffer). Nada en el primer ciclo.
+  template <class Out>
+  void printTo(Out &msg) const {
+    if (_st.cycles == 0) return;
+    uint32_t duty = lastDutyCentiPct();
+    uint64_t total = _st.totalAwakeMs + _st.totalSleepMs;
+    uint32_t avgDuty = total ? (uint32_t)(_st.totalAwakeMs * 10000 / total) : 0;
+    msg.printf("Ciclo %lu: despierto %lu ms (%lu.%02lu%%, media %lu.%02lu%%), ~%lu mJ por informe, %lu uA de media.",
+               (unsigned long)_st.cycles, (unsigned long)_st.lastAwakeMs, (unsigned long)(duty / 100),
+               (unsigned long)(duty % 100), (unsigned long)(avgDuty / 100), (unsigned long)(avgDuty % 100),
+               (unsigned long)lastEnergyMj(), (unsigned long)lastAverageUa());
+  }
+
+private:
+  State &_st;
+  bool _woke = false;
+};
@@ -0,0 +1,483 @@
+// TelegramOutbox.h
+// Cola de mensajes salientes para Telegram, atendida por una tarea FreeRTOS.
+// send() copia el texto en la cola y vuelve al momento; la tarea de fondo
+// lo envía por su propia conexión keep-alive respetando:
+//   - el límite de Telegram por chat (~1 mensaje/s),
+//   - retry_after en las respuestas 429,
+//   - reintentos con espera exponencial si falla la red o el servidor.
+// Los mensajes pequeños seguidos al mismo chat que aún no han salido se
+// juntan en uno solo (p. ej. inicio + parciales + fin de un escaneo).
+//
+// Además hay un mensaje "en vivo" para el progreso de tareas largas: se
+// envía una vez y después se edita en su sitio (editMessageText) como mucho
+// cada liveIntervalMs, siempre con el último texto recibido.
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "TelegramTransport.h"
+#include "TextBuffer.h"
+#include "HeapMetrics.h"
+
+class TelegramOutbox {
+public:
+  enum { SLOTS = 8, TEXT_MAX = 1024, LIVE_MAX = 320, MAX_ATTEMPTS = 6 };
+  enum : unsigned long {
+    CHAT_INTERVAL_MS = 1100,     // margen sobre 1 msg/s por chat
+    BACKOFF_MIN_MS = 1000,
+    BACKOFF_MAX_MS = 60000
+  };
+
+  struct Stats {
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t coalesced;     // mensajes unidos a otro ya en cola
+    uint32_t retries;
+    uint32_t rateLimited;   // respuestas 429
+    uint32_t failed;        // descartados tras fallar
+    uint32_t dropped;       // no cabían en la cola
+    uint32_t edits;         // ediciones del mensaje en vivo
+    uint32_t requests;      // peticiones a Telegram (con reintentos)
+    uint32_t requestMs;     // tiempo total en esas peticiones
+    uint32_t lastRequestMs;
+  };
+
+  // Qué fue de un mensaje enviado con sendTracked()
+  enum Delivery { QUEUED, DELIVERED, FAILED };
+
+  unsigned long liveIntervalMs = 3000;   // mínimo entre ediciones del mensaje en vivo
+
+  bool begin(const char *token, UBaseType_t priority = 1, uint32_t stackBytes = 8192) {
+    _tg.begin(token);
+    _mutex = xSemaphoreCreateMutex();
+    if (!_mutex) return false;
+    return xTaskCreate(taskEntry, "tg_outbox", stackBytes, this, priority, &_task) == pdPASS;
+  }
+
+  // Encola un mensaje (copia el texto). No bloquea. false si la cola está llena.
+  // Los textos de más de TEXT_MAX bytes se parten en varios mensajes.
+  bool send(int64_t chatId, const char *text, bool coalesce = true) {
+    size_t len = strlen(text);
+    bool ok = true;
+    do {
+      size_t part = len;
+      if (part > TEXT_MAX) part = utf8Cut(text, TEXT_MAX);
+      ok = enqueue(chatId, text, part, coalesce) != 0 && ok;
+      text += part;
+      len -= part;
+    } while (len > 0);
+    if (_task) xTaskNotifyGive(_task);
+    return ok;
+  }
+
+  // Como send(), pero el mensaje va solo (no se une a otros ni se parte:
+  // máx. TEXT_MAX bytes) y devuelve un id para preguntar con delivery() si
+  // llegó. 0 si no cabe en la cola.
+  uint32_t sendTracked(int64_t chatId, const char *text) {
+    size_t len = strlen(text);
+    if (len > TEXT_MAX) return 0;
+    uint32_t id = enqueue(chatId, text, len, false);
+    if (id && _task) xTaskNotifyGive(_task);
+    return id;
+  }
+
+  // Sólo se recuerdan los últimos SLOTS resultados: uno más antiguo cuenta
+  // como FAILED (quien pregunta lo repite, no lo da por entregado).
+  Delivery delivery(uint32_t id) {
+    lock();
+    Delivery d = QUEUED;
+    if ((int32_t)(id - _doneId) <= 0) {
+      d = FAILED;
+      for (uint8_t i = 0; i < SLOTS; ++i) {
+        if (_done[i].id == id) d = _done[i].ok ? DELIVERED : FAILED;
+      }
+    }
+    unlock();
+    return d;
+  }
+
+  // Empieza un mensaje en vivo (sólo hay uno: sustituye al anterior). Sale
+  // en cuanto la cola lo permite; los mensajes normales van antes.
+  void beginLive(int64_t chatId, const char *text) {
+    lock();
+    _live.gen++;
+    _live.chatId = chatId;
+    _live.messageId = 0;
+    _live.active = true;
+    _live.closing = false;
+    _live.failures = 0;
+    _live.len = 0;          // aunque el texto coincida con el anterior, hay que enviarlo
+    setLiveText(text);
+    _nextLiveAt = millis();
+    unlock();
+    if (_task) xTaskNotifyGive(_task);
+  }
+
+  // Nuevo texto para el mensaje en vivo. Si aún no ha salido el anterior,
+  // lo sustituye (sólo se envía el último).
+  void updateLive(const char *text) {
+    lock();
+    bool changed = _live.active && !_live.closing && setLiveText(text);
+    unlock();
+    if (changed && _task) xTaskNotifyGive(_task);
+  }
+
+  // Último texto del mensaje en vivo; cuando se ha enviado queda libre
+  void endLive(const char *text) {
+    lock();
+    if (_live.active) {
+      setLiveText(text);
+      _live.closing = true;
+    }
+    unlock();
+    if (_task) xTaskNotifyGive(_task);
+  }
+
+  // Espera a que la cola se vacíe (p. ej. antes de dormir o reiniciar).
+  bool flush(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    while (pending() > 0) {
+      if (millis() - start >= timeoutMs) return false;
+      delay(20);
+    }
+    return true;
+  }
+
+  size_t pending() {
+    lock();
+    size_t n = _count + (_live.dirty || _liveBusy ? 1 : 0);   // también la edición en curso
+    unlock();
+    return n;
+  }
+
+  Stats stats() {
+    lock();
+    Stats s = _st;
+    unlock();
+    return s;
+  }
+
+  TaskHandle_t taskHandle() const { return _task; }
+
+  // Si se asigna, vigila el heap en cada envío (ver AllocCounter en HeapMetrics.h)
+  AllocCounter *allocs = nullptr;
+
+private:
+  struct Msg {
+    uint32_t id;            // para delivery() (los unidos comparten el del primero)
+    int64_t chatId;
+    uint16_t len;
+    uint8_t attempts;
+    bool coalesce;
+    char text[TEXT_MAX + 1];
+  };
+  enum Result { SENT, RETRY, RATE_LIMITED, DROP };
+
+  struct Done {
+    uint32_t id;
+    bool ok;
+  };
+
+  struct Live {
+    uint16_t gen;           // cambia en cada beginLive()
+    int64_t chatId;
+    int32_t messageId;      // 0 = todavía no se ha creado
+    bool active;
+    bool dirty;             // hay texto sin enviar
+    bool closing;           // endLive(): tras el último envío se libera
+    uint8_t failures;
+    uint16_t len;
+    char text[LIVE_MAX + 1];
+  };
+
+  Msg _q[SLOTS];
+  uint8_t _head = 0;
+  uint8_t _count = 0;
+  bool _headBusy = false;            // la tarea está enviando _q[_head]
+  uint32_t _lastId = 0;              // último id dado por enqueue()
+  uint32_t _doneId = 0;              // último id que salió de la cola
+  Done _done[SLOTS] = {};            // resultado de los últimos que salieron
+  uint8_t _doneNext = 0;
+  Stats _st = {};
+  SemaphoreHandle_t _mutex = nullptr;
+  TaskHandle_t _task = nullptr;
+  TelegramTransport _tg;
+  unsigned long _nextSendAt = 0;
+  unsigned long _retryAfterMs = 0;
+  Live _live = {};
+  Live _liveOut;                     // copia que está enviando la tarea
+  bool _liveBusy = false;            // la tarea está enviando _liveOut
+  unsigned long _nextLiveAt = 0;
+
+  void lock() { if (_mutex) xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void unlock() { if (_mutex) xSemaphoreGive(_mutex); }
+
+  // Devuelve el id del mensaje en la cola (0 = no cabía)
+  uint32_t enqueue(int64_t chatId, const char *text, size_t len, bool coalesce) {
+    lock();
+    // ¿se puede unir al último mensaje pendiente (que no se esté enviando)?
+    if (coalesce && _count > 0) {
+      uint8_t tail = (_head + _count - 1) % SLOTS;
+      Msg &t = _q[tail];
+      bool tailBusy = (tail == _head && _headBusy);
+      if (!tailBusy && t.coalesce && t.chatId == chatId && t.len + 1 + len <= TEXT_MAX) {
+        t.text[t.len++] = '\n';
+        memcpy(t.text + t.len, text, len);
+        t.len += len;
+        t.text[t.len] = '\0';
+        _st.coalesced++;
+        unlock();
+        return t.id;
+      }
+    }
+    if (_count >= SLOTS) {
+      _st.dropped++;
+      unlock();
+      return 0;
+    }
+    Msg &m = _q[(_head + _count) % SLOTS];
+    if (++_lastId == 0) _lastId = 1;   // 0 queda para "no cabía"
+    m.id = _lastId;
+    m.chatId = chatId;
+    m.len = (uint16_t)len;
+    m.attempts = 0;
+    m.coalesce = coalesce;
+    memcpy(m.text, text, len);
+    m.text[len] = '\0';
+    _count++;
+    _st.queued++;
+    unlock();
+    return m.id;
+  }
+
+  // Con el mutex tomado. false si el texto no cambia.
+  bool setLiveText(const char *text) {
+    size_t len = strlen(text);
+    if (len > LIVE_MAX) len = utf8Cut(text, LIVE_MAX);
+    if (len == _live.len && memcmp(_live.text, text, len) == 0) return false;
+    memcpy(_live.text, text, len);
+    _live.text[len] = '\0';
+    _live.len = (uint16_t)len;
+    _live.dirty = true;
+    return true;
+  }
+
+  static void taskEntry(void *arg) { ((TelegramOutbox *)arg)->run(); }
+
+  void run() {
+    for (;;) {
+      unsigned long now = millis();
+      lock();
+      bool have = _count > 0;
+      bool live = _live.dirty;
+      long wait = (long)(_nextSendAt - now);
+      if (!have && live && (long)(_nextLiveAt - now) > wait) wait = (long)(_nextLiveAt - now);
+      bool go = (have || live) && wait <= 0;
+      if (go && have) {
+        _headBusy = true;
+      } else if (go) {
+        _liveOut = _live;
+        _live.dirty = false;
+        _liveBusy = true;
+      }
+      unlock();
+
+      if (!have && !live) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        continue;
+      }
+      if (!go) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+        continue;
+      }
+      if (have) sendHead();
+      else sendLive();
+    }
+  }
+
+  void sendHead() {
+    // _q[_head] no lo toca nadie más mientras _headBusy
+    Msg &m = _q[_head];
+    uint32_t mark = allocs ? allocs->begin() : 0;
+    unsigned long t0 = millis();
+    Result r = deliver(m.chatId, 0, m.text, m.len, nullptr);
+    if (allocs) allocs->end(mark);
+    unsigned long now = millis();
+
+    lock();
+    countRequest(now - t0);
+    _headBusy = false;
+    switch (r) {
+      case SENT:
+        _st.sent++;
+        pop(true);
+        _nextSendAt = now + CHAT_INTERVAL_MS;
+        break;
+      case RATE_LIMITED:
+        _st.rateLimited++;
+        _nextSendAt = now + (_retryAfterMs > 0 ? _retryAfterMs : BACKOFF_MIN_MS);
+        break;
+      case RETRY:
+        if (++m.attempts >= MAX_ATTEMPTS) {
+          _st.failed++;
+          pop(false);
+          _nextSendAt = now;
+        } else {
+          _st.retries++;
+          _nextSendAt = now + backoffMs(m.attempts);
+        }
+        break;
+      case DROP:
+        _st.failed++;
+        pop(false);
+        _nextSendAt = now + CHAT_INTERVAL_MS;
+        break;
+    }
+    unlock();
+  }
+
+  // con lock()
+  void countRequest(unsigned long ms) {
+    _st.requests++;
+    _st.requestMs += ms;
+    _st.lastRequestMs = ms;
+  }
+
+  // Crea (sendMessage) o edita (editMessageText) el mensaje en vivo con el
+  // texto copiado en _liveOut. Si falla se vuelve a marcar como pendiente:
+  // el siguiente intento lleva el texto más reciente.
+  void sendLive() {
+    int32_t newId = 0;
+    uint32_t mark = allocs ? allocs->begin() : 0;
+    unsigned long t0 = millis();
+    Result r = deliver(_liveOut.chatId, _liveOut.messageId, _liveOut.text, _liveOut.len, &newId);
+    if (allocs) allocs->end(mark);
+    unsigned long now = millis();
+
+    lock();
+    countRequest(now - t0);
+    _liveBusy = false;
+    bool same = _live.gen == _liveOut.gen;   // si no, beginLive() lo sustituyó
+    switch (r) {
+      case SENT:
+        if (_liveOut.messageId) _st.edits++;
+        else _st.sent++;
+        _nextSendAt = now + CHAT_INTERVAL_MS;
+        _nextLiveAt = now + liveIntervalMs;
+        if (!same) break;
+        _live.failures = 0;
+        if (!_liveOut.messageId) _live.messageId = newId;
+        if (!_live.messageId || (_live.closing && !_live.dirty)) {
+          _live.active = false;   // sin message_id no se puede editar
+          _live.dirty = false;
+        }
+        break;
+      case RATE_LIMITED:
+        _st.rateLimited++;
+        _nextSendAt = now + (_retryAfterMs > 0 ? _retryAfterMs : BACKOFF_MIN_MS);
+        if (same) _live.dirty = true;
+        break;
+      case RETRY:
+        if (!same) break;
+        if (++_live.failures >= MAX_ATTEMPTS) {
+          _st.failed++;
+          _live.active = false;
+        } else {
+          _st.retries++;
+          _live.dirty = true;
+          _nextSendAt = now + backoffMs(_live.failures);
+        }
+        break;
+      case DROP:
+        _st.failed++;
+        _nextSendAt = now + CHAT_INTERVAL_MS;
+        if (same) {
+          _live.active = false;   // p. ej. el usuario borró el mensaje
+          _live.dirty = false;
+        }
+        break;
+    }
+    unlock();
+  }
+
+  void pop(bool ok) {
+    _doneId = _q[_head].id;
+    _done[_doneNext].id = _doneId;
+    _done[_doneNext].ok = ok;
+    _doneNext = (_doneNext + 1) % SLOTS;
+    _head = (_head + 1) % SLOTS;
+    _count--;
+  }
+
+  // 1er reintento inmediato (suele ser una conexión keep-alive caducada)
+  static unsigned long backoffMs(uint8_t attempts) {
+    if (attempts <= 1) return 0;
+    unsigned long w = BACKOFF_MIN_MS << (attempts - 2);
+    return w > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : w;
+  }
+
+  // POST sendMessage (o editMessageText si editId != 0) con el cuerpo
+  // url-encoded escrito directamente en la conexión (Content-Length
+  // calculado antes): sin reservas de heap. Si newId, apunta el message_id
+  // del mensaje creado.
+  Result deliver(int64_t chatId, int32_t editId, const char *text, size_t len, int32_t *newId) {
+    char prefix[64];
+    int plen = editId ? snprintf(prefix, sizeof(prefix), "chat_id=%lld&message_id=%ld&text=",
+                                 (long long)chatId, (long)editId)
+                      : snprintf(prefix, sizeof(prefix), "chat_id=%lld&text=", (long long)chatId);
+    size_t bodyLen = plen + urlEncodedLength(text, len);
+    const char *method = editId ? "editMessageText" : "sendMessage";
+    if (!_tg.beginRequest("POST", method, nullptr, "application/x-www-form-urlencoded", bodyLen)) {
+      return RETRY;
+    }
+    _tg.writeBody((const uint8_t *)prefix, plen);
+    urlEncodeTo(_tg, text, len);
+
+    int code = _tg.readResponseHead(10000);
+    if (code <= 0) return RETRY;
+    _retryAfterMs = 0;
+    if (code == 429) _retryAfterMs = scanNumber("\"retry_after\":") * 1000UL;
+    else if (newId && code == 200) *newId = (int32_t)scanNumber("\"message_id\":");
+    _tg.endResponse();
+
+    if (code == 200 || code == 201) return SENT;
+    if (code == 429) return RATE_LIMITED;
+    if (code >= 500) return RETRY;
+    return DROP;   // 400/403...: reintentar no lo arregla
+  }
+
+  // Busca pat (p. ej. "retry_after":) en el cuerpo y lee el número que le
+  // sigue, sin guardar el cuerpo
+  unsigned long scanNumber(const char *pat) {
+    size_t match = 0;
+    unsigned long value = 0;
+    bool inNumber = false;
+    unsigned long deadline = millis() + 3000;
+    while (!_tg.bodyDone() && (long)(millis() - deadline) < 0) {
+      int c = _tg.read();
+      if (c < 0) {
+        delay(1);
+        continue;
+      }
+      if (inNumber) {
+        if (c >= '0' && c <= '9') value = value * 10 + (c - '0');
+        else if (c != ' ') return value;
+        continue;
+      }
+      if (c == pat[match]) {
+        if (pat[++match] == '\0') inNumber = true;
+      } else {
+        match = (c == pat[0]) ? 1 : 0;
+      }
+    }
+    return value;
+  }
+
+  // Longitud <= max que no parte un carácter UTF-8
+  static size_t utf8Cut(const char *s, size_t max) {
+    size_t n = max;
+    while (n > 0 && (((uint8_t)s[n]) & 0xC0) == 0x80) n--;
+    return n > 0 ? n : max;
+  }
+};
@@ -0,0 +1,151 @@
+// TelegramPoller.h
+// getUpdates en modo long-poll (timeout=N) sin bloquear loop().
+// Usa su propia conexión keep-alive: la petición queda abierta en el
+// servidor hasta que llega un mensaje (o vence el timeout), y mientras tanto
+// loop() sigue libre y los envíos van por otra conexión.
+//
+// Uso:
+//   TelegramLongPoll poller;
+//   poller.begin(TELEGRAM_BOT_TOKEN, 25, 20, lastUpdateId + 1);
+//   void loop() {
+//     if (poller.service()) {          // hay respuesta 200 lista
+//       ... leer poller.transport() y llamar poller.ack(update_id) ...
+//       poller.done();                  // lanza el siguiente long-poll
+//     }
+//   }
+#pragma once
+
+#include "TelegramTransport.h"
+
+class TelegramLongPoll {
+public:
+  enum : unsigned long { RETRY_MIN_MS = 1000, RETRY_MAX_MS = 60000 };
+
+  // timeoutSec: segundos que Telegram retiene la petición si no hay updates.
+  // nextOffset: primer update_id a pedir (0 = lo que tenga Telegram).
+  void begin(const char *token, uint16_t timeoutSec = 25, uint8_t limit = 20,
+             long nextOffset = 0) {
+    _tg.begin(token);
+    _timeoutSec = timeoutSec;
+    _limit = limit;
+    _offset = nextOffset;
+    _state = IDLE;
+    _nextAt = millis();
+  }
+
+  // Marca un update como procesado: el siguiente getUpdates empieza después.
+  // Telegram sólo descarta los updates cuando se pide un offset mayor, así
+  // que si la conexión cae antes de eso se vuelven a recibir (nunca se pierden).
+  void ack(long updateId) {
+    if (updateId >= _offset) _offset = updateId + 1;
+  }
+
+  long offset() const { return _offset; }
+
+  // Llamar en cada vuelta de loop(). Devuelve true cuando hay una respuesta
+  // 200 de getUpdates lista para leer desde transport(); después hay que
+  // llamar a done().
+  bool service() {
+    unsigned long now = millis();
+    switch (_state) {
+      case IDLE: {
+        if ((long)(now - _nextAt) < 0) return false;
+        char query[64];
+        if (_offset > 0) {
+          snprintf(query, sizeof(query), "offset=%ld&limit=%u&timeout=%u",
+                   _offset, (unsigned)_limit, (unsigned)_timeoutSec);
+        } else {
+          snprintf(query, sizeof(query), "limit=%u&timeout=%u",
+                   (unsigned)_limit, (unsigned)_timeoutSec);
+        }
+        if (!_tg.beginRequest("GET", "getUpdates", query, nullptr, 0)) {
+          retryLater(0);
+          return false;
+        }
+        _sentAt = now;
+        _state = WAITING;
+        _polls++;
+        return false;
+      }
+
+      case WAITING: {
+        if (_tg.responseAvailable()) {
+          int code = _tg.readResponseHead(5000);
+          if (code == 200) {
+            _failures = 0;
+            _lastWaitMs = now - _sentAt;
+            _state = READY;
+            return true;
+          }
+          if (code > 0) _tg.endResponse();
+          retryLater(code);
+          return false;
+        }
+        // conexión caída o respuesta que no llega: se reintenta con el mismo offset
+        unsigned long limitMs = (unsigned long)_timeoutSec * 1000UL + 10000UL;
+        if (!_tg.connected() || now - _sentAt > limitMs) {
+          _tg.stop();
+          retryLater(0);
+        }
+        return false;
+      }
+
+      case READY:
+      default:
+        return false;
+    }
+  }
+
+  // Fin de la respuesta actual: se lanza el siguiente long-poll enseguida.
+  void done() {
+    _tg.endResponse();
+    _state = IDLE;
+    _nextAt = millis();
+  }
+
+  // Corta la petición en curso (por ejemplo, antes de dormir).
+  void stop() {
+    _tg.stop();
+    _state = IDLE;
+  }
+
+  bool inFlight() const { return _state == WAITING; }
+  TelegramTransport &transport() { return _tg; }
+  uint32_t polls() const { return _polls; }
+  uint32_t errors() const { return _errors; }          // fallos (red, HTTP != 200, timeouts)
+  unsigned long lastWaitMs() const { return _lastWaitMs; }   // de la petición a la respuesta
+
+private:
+  enum State { IDLE, WAITING, READY };
+
+  TelegramTransport _tg;
+  State _state = IDLE;
+  uint16_t _timeoutSec = 25;
+  uint8_t _limit = 20;
+  long _offset = 0;
+  unsigned long _sentAt = 0;
+  unsigned long _nextAt = 0;
+  uint8_t _failures = 0;
+  uint32_t _polls = 0;
+  uint32_t _errors = 0;
+  unsigned long _lastWaitMs = 0;
+
+  // Primer fallo: reintento inmediato (suele ser una conexión keep-alive
+  // caducada). Después espera creciente; 401/409 (token malo o webhook
+  // activo) van directamente a la espera máxima.
+  void retryLater(int code) {
+    unsigned long wait;
+    if (code == 401 || code == 409) {
+      wait = RETRY_MAX_MS;
+    } else if (_failures == 0) {
+      wait = 0;
+    } else {
+      wait = RETRY_MIN_MS << min((int)_failures - 1, 6);
+      if (wait > RETRY_MAX_MS) wait = RETRY_MAX_MS;
+    }
+    if (_failures < 255) _failures++;
+    _errors++;
+    _state = IDLE;
+    _nextAt = millis() + wait;
+  }
+};
@@ -0,0 +1,416 @@
+// TelegramTransport.h
+// Conexión HTTPS persistente (HTTP/1.1 keep-alive) con api.telegram.org.
+// Los sketches la usan tanto para sendMessage como para getUpdates: la
+// conexión TLS se abre una vez y se reutiliza entre peticiones, de modo que
+// el handshake sólo se paga al arrancar o tras una caída.
+//
+// Uso típico:
+//   TelegramTransport tg;
+//   tg.begin(TELEGRAM_BOT_TOKEN);
+//   int code = tg.request("GET", "getUpdates", "timeout=0", nullptr, nullptr, 0);
+//   ... leer el cuerpo con tg.read() / deserializeJson(doc, tg) ...
+//   tg.endResponse();   // deja la conexión lista para la siguiente petición
+#pragma once
+
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include "FastConnect.h"     // caché DNS compartida y tiempo hasta el primer byte
+
+// Servidor de la API. Se puede cambiar al compilar (-DTELEGRAM_API_HOST=...)
+// para apuntar a un servidor de pruebas que imite a Telegram.
+#ifndef TELEGRAM_API_HOST
+#define TELEGRAM_API_HOST "api.telegram.org"
+#endif
+#ifndef TELEGRAM_API_PORT
+#define TELEGRAM_API_PORT 443
+#endif
+
+// Códigos de error (negativos, como los de HTTPClient)
+#define TG_ERR_CONNECT   -1   // no hay conexión (o estamos en backoff)
+#define TG_ERR_WRITE     -2   // fallo al escribir la petición
+#define TG_ERR_READ      -3   // la respuesta no llegó o vino cortada
+
+class TelegramTransport : public Stream {
+public:
+  enum : uint16_t { PORT = TELEGRAM_API_PORT };
+  enum : unsigned long { BACKOFF_MIN_MS = 1000, BACKOFF_MAX_MS = 30000 };
+
+  void begin(const char *token, const char *host = TELEGRAM_API_HOST,
+             bool insecure = true, const char *caCert = nullptr) {
+    _token = token;
+    _host = host;
+    _insecure = insecure;
+    _caCert = caCert;
+  }
+
+  // Petición completa y bloqueante. Devuelve el código HTTP (>0) o TG_ERR_*.
+  // Si la conexión reutilizada estaba muerta (el servidor la cerró por
+  // inactividad) y no llegó ningún byte, se reconecta y se reintenta una vez.
+  int request(const char *httpMethod, const char *apiMethod, const char *query,
+              const char *contentType, const char *body, size_t bodyLen,
+              unsigned long timeoutMs = 10000) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      bool reused = (_requestsOnConn > 0);
+      if (!beginRequest(httpMethod, apiMethod, query, contentType, bodyLen)) {
+        if (reused && attempt == 0) continue;
+        return _lastError;
+      }
+      if (bodyLen > 0 && writeBody((const uint8_t *)body, bodyLen) != bodyLen) {
+        stop();
+        _lastError = TG_ERR_WRITE;
+        if (reused && attempt == 0) continue;
+        return _lastError;
+      }
+      int code = readResponseHead(timeoutMs);
+      if (code > 0) return code;
+      if (!(reused && attempt == 0 && _headBytes == 0)) return code;
+    }
+    return _lastError;
+  }
+
+  // ---- API por pasos (para cuerpos en streaming o respuestas asíncronas) ----
+
+  // Conecta si hace falta y escribe línea de petición + cabeceras.
+  bool beginRequest(const char *httpMethod, const char *apiMethod, const char *query,
+                    const char *contentType, size_t contentLength) {
+    if (_inBody) endResponse();
+    if (!ensureConnected()) {
+      _lastError = TG_ERR_CONNECT;
+      return false;
+    }
+    int n = snprintf(_head, sizeof(_head), "%s /bot%s/%s%s%s HTTP/1.1\r\nHost: %s\r\n"
+                     "Connection: keep-alive\r\n",
+                     httpMethod, _token, apiMethod, (query && *query) ? "?" : "",
+                     query ? query : "", _host);
+    if (contentType && n > 0 && n < (int)sizeof(_head)) {
+      n += snprintf(_head + n, sizeof(_head) - n, "Content-Type: %s\r\n", contentType);
+    }
+    if (n > 0 && n < (int)sizeof(_head)) {
+      n += snprintf(_head + n, sizeof(_head) - n, "Content-Length: %u\r\n\r\n",
+                    (unsigned)contentLength);
+    }
+    if (n <= 0 || n >= (int)sizeof(_head)) {
+      _lastError = TG_ERR_WRITE;   // petición demasiado larga para el buffer
+      return false;
+    }
+    if (countOut(_client.write((const uint8_t *)_head, n)) != (size_t)n) {
+      stop();
+      _lastError = TG_ERR_WRITE;
+      return false;
+    }
+    netMarkFirstByte();
+    _requestsOnConn++;
+    _requests++;
+    return true;
+  }
+
+  size_t writeBody(const uint8_t *data, size_t len) {
+    return countOut(_client.write(data, len));
+  }
+
+  // ¿Hay bytes de respuesta esperando? (para no bloquear loop())
+  bool responseAvailable() { return _client.available() > 0; }
+
+  // Lee la línea de estado y las cabeceras. Devuelve el código HTTP o TG_ERR_*.
+  int readResponseHead(unsigned long timeoutMs) {
+    _inBody = false;
+    _bodyDone = false;
+    _chunked = false;
+    _chunkCrlf = false;
+    _closeAfter = false;
+    _bodyLeft = 0;
+    _headBytes = 0;
+    unsigned long deadline = millis() + timeoutMs;
+
+    char line[128];
+    int n = readLine(line, sizeof(line), deadline);
+    if (n <= 0 || strncmp(line, "HTTP/1.", 7) != 0 || n < 12) {
+      stop();
+      _lastError = TG_ERR_READ;
+      return _lastError;
+    }
+    if (line[7] == '0') _closeAfter = true;   // HTTP/1.0: sin keep-alive
+    int status = atoi(line + 9);
+
+    bool haveLength = false;
+    while (true) {
+      n = readLine(line, sizeof(line), deadline);
+      if (n < 0) {
+        stop();
+        _lastError = TG_ERR_READ;
+        return _lastError;
+      }
+      if (n == 0) break;   // fin de cabeceras
+      if (headerIs(line, "content-length")) {
+        _bodyLeft = strtoul(headerValue(line), nullptr, 10);
+        haveLength = true;
+      } else if (headerIs(line, "transfer-encoding")) {
+        _chunked = containsNoCase(headerValue(line), "chunked");
+      } else if (headerIs(line, "connection")) {
+        if (containsNoCase(headerValue(line), "close")) _closeAfter = true;
+      }
+    }
+    if (_chunked) {
+      _bodyLeft = 0;
+    } else if (!haveLength) {
+      _closeAfter = true;          // cuerpo delimitado por cierre
+      _bodyLeft = (size_t)-1;
+    }
+    _inBody = true;
+    _bodyTimeout = timeoutMs;
+    return status;
+  }
+
+  // Descarta lo que quede del cuerpo. Si no se puede reutilizar, cierra.
+  // Devuelve los bytes descartados.
+  size_t endResponse() {
+    size_t drained = 0;
+    if (_inBody) {
+      unsigned long deadline = millis() + _bodyTimeout;
+      while (!_bodyDone) {
+        int c = read();
+        if (c >= 0) {
+          drained++;
+          continue;
+        }
+        if (_bodyDone) break;
+        if (!_client.connected() || (long)(millis() - deadline) >= 0) {
+          _closeAfter = true;
+          break;
+        }
+        delay(1);
+      }
+      _inBody = false;
+    }
+    if (_closeAfter) stop();
+    return drained;
+  }
+
+  void stop() {
+    _client.stop();
+    _inBody = false;
+    _requestsOnConn = 0;
+  }
+
+  bool connected() { return _client.connected(); }
+
+  // ---- Stream: lectura del cuerpo de la respuesta ----
+  int available() override {
+    if (!_inBody || _bodyDone) return 0;
+    int a = _client.available();
+    if (_chunked) return (_bodyLeft > 0 && a > 0) ? min((size_t)a, _bodyLeft) : (a > 0 ? 1 : 0);
+    return (int)min((size_t)a, _bodyLeft);
+  }
+
+  int read() override {
+    if (!_inBody || _bodyDone) return -1;
+    if (_chunked && _bodyLeft == 0) {
+      if (!nextChunk()) return -1;
+      if (_bodyDone) return -1;
+    }
+    if (_bodyLeft == 0) {
+      _bodyDone = true;
+      return -1;
+    }
+    int c = countIn(_client.read());
+    if (c < 0) {
+      if (_bodyLeft == (size_t)-1 && !_client.connected()) _bodyDone = true;
+      return -1;
+    }
+    if (_bodyLeft != (size_t)-1) _bodyLeft--;
+    if (_chunked && _bodyLeft == 0) _chunkCrlf = true;
+    else if (!_chunked && _bodyLeft == 0) _bodyDone = true;
+    return c;
+  }
+
+  // Lee hasta len bytes del cuerpo que ya hayan llegado (no espera datos).
+  // Devuelve los bytes leídos; 0 si no hay nada todavía o el cuerpo acabó.
+  int readSome(uint8_t *buf, size_t len) {
+    if (!_inBody || _bodyDone) return 0;
+    if (_chunked && _bodyLeft == 0) {
+      if (!nextChunk() || _bodyDone) return 0;
+    }
+    if (_bodyLeft == 0) {
+      _bodyDone = true;
+      return 0;
+    }
+    if (len > _bodyLeft) len = _bodyLeft;
+    int n = _client.read(buf, len);
+    if (n > 0) _bytesIn += n;
+    if (n <= 0) {
+      if (_bodyLeft == (size_t)-1 && !_client.connected()) _bodyDone = true;
+      return 0;
+    }
+    if (_bodyLeft != (size_t)-1) _bodyLeft -= n;
+    if (_bodyLeft == 0) {
+      if (_chunked) _chunkCrlf = true;
+      else _bodyDone = true;
+    }
+    return n;
+  }
+
+  bool bodyDone() const { return !_inBody || _bodyDone; }
+
+  int peek() override {
+    if (!_inBody || _bodyDone || _bodyLeft == 0) return -1;
+    return _client.peek();
+  }
+
+  // Print: permite escribir el cuerpo de la petición con print()/write()
+  size_t write(uint8_t b) override { return countOut(_client.write(&b, 1)); }
+  size_t write(const uint8_t *buf, size_t size) override { return countOut(_client.write(buf, size)); }
+
+  // ---- estadísticas ----
+  uint32_t connects() const { return _connects; }
+  uint32_t connectFailures() const { return _connectFailures; }
+  uint32_t requests() const { return _requests; }
+  int lastError() const { return _lastError; }
+  // bytes de HTTP en la conexión (sin contar TLS)
+  uint32_t bytesOut() const { return _bytesOut; }
+  uint32_t bytesIn() const { return _bytesIn; }
+
+private:
+  WiFiClientSecure _client;
+  const char *_token = "";
+  const char *_host = TELEGRAM_API_HOST;
+  const char *_caCert = nullptr;
+  bool _insecure = true;
+
+  char _head[320];
+  int _lastError = 0;
+
+  bool _inBody = false;
+  bool _bodyDone = false;
+  bool _chunked = false;
+  bool _chunkCrlf = false;     // falta el CRLF que cierra el chunk actual
+  bool _closeAfter = false;
+  size_t _bodyLeft = 0;        // (size_t)-1 -> hasta cierre
+  size_t _headBytes = 0;
+  unsigned long _bodyTimeout = 10000;
+
+  uint32_t _requestsOnConn = 0;
+  uint32_t _requests = 0;
+  uint32_t _connects = 0;
+  uint32_t _connectFailures = 0;
+  uint32_t _bytesOut = 0;
+  uint32_t _bytesIn = 0;
+  unsigned long _backoffMs = 0;
+  unsigned long _nextConnectAt = 0;
+
+  size_t countOut(size_t n) {
+    _bytesOut += n;
+    return n;
+  }
+
+  int countIn(int c) {
+    if (c >= 0) _bytesIn++;
+    return c;
+  }
+
+  bool ensureConnected() {
+    if (_client.connected()) return true;
+    unsigned long now = millis();
+    if (_backoffMs > 0 && (long)(now - _nextConnectAt) < 0) return false;
+    if (WiFi.status() != WL_CONNECTED) return false;
+
+    _client.stop();
+    _requestsOnConn = 0;
+    if (_insecure || !_caCert) _client.setInsecure();
+    else _client.setCACert(_caCert);
+    _client.setHandshakeTimeout(10);   // segundos
+
+    // con caché DNS: por IP, pasando el nombre para SNI
+    DnsCache *dns = sharedDnsCache();
+    IPAddress ip;
+    bool ok;
+    if (dns && dns->resolve(_host, ip)) {
+      ok = _client.connect(ip, PORT, _host, _insecure ? nullptr : _caCert, nullptr, nullptr);
+      if (!ok) dns->forget(_host);   // quizá ha cambiado de IP
+    } else {
+      ok = _client.connect(_host, PORT);
+    }
+    if (!ok) {
+      _connectFailures++;
+      _backoffMs = _backoffMs == 0 ? BACKOFF_MIN_MS : _backoffMs * 2;
+      if (_backoffMs > BACKOFF_MAX_MS) _backoffMs = BACKOFF_MAX_MS;
+      _nextConnectAt = now + _backoffMs;
+      return false;
+    }
+    _client.setNoDelay(true);
+    _backoffMs = 0;
+    _connects++;
+    return true;
+  }
+
+  // Lee una línea terminada en CRLF (sin incluirlo). Trunca si no cabe.
+  // Devuelve la longitud, o -1 si se corta la conexión / vence el plazo.
+  int readLine(char *buf, size_t size, unsigned long deadline) {
+    size_t n = 0;
+    while (true) {
+      int c = countIn(_client.read());
+      if (c < 0) {
+        if (!_client.connected() || (long)(millis() - deadline) >= 0) {
+          buf[n] = '\0';
+          return -1;
+        }
+        delay(1);
+        continue;
+      }
+      _headBytes++;
+      if (c == '\n') break;
+      if (c == '\r') continue;
+      if (n + 1 < size) buf[n++] = (char)c;
+    }
+    buf[n] = '\0';
+    return (int)n;
+  }
+
+  // Lee la cabecera del siguiente chunk. false si la conexión falla.
+  bool nextChunk() {
+    char line[24];
+    unsigned long deadline = millis() + _bodyTimeout;
+    if (_chunkCrlf) {
+      if (readLine(line, sizeof(line), deadline) < 0) return chunkFail();
+      _chunkCrlf = false;
+    }
+    if (readLine(line, sizeof(line), deadline) < 0) return chunkFail();
+    _bodyLeft = strtoul(line, nullptr, 16);
+    if (_bodyLeft == 0) {
+      // último chunk: consume trailers hasta la línea vacía
+      int n;
+      do {
+        n = readLine(line, sizeof(line), deadline);
+      } while (n > 0);
+      if (n < 0) return chunkFail();
+      _bodyDone = true;
+    }
+    return true;
+  }
+
+  bool chunkFail() {
+    _closeAfter = true;
+    _bodyDone = true;
+    return false;
+  }
+
+  static bool headerIs(const char *line, const char *name) {
+    size_t n = strlen(name);
+    return strncasecmp(line, name, n) == 0 && line[n] == ':';
+  }
+
+  static const char *headerValue(const char *line) {
+    const char *p = strchr(line, ':');
+    if (!p) return "";
+    p++;
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+  }
+
+  static bool containsNoCase(const char *s, const char *token) {
+    size_t n = strlen(token);
+    for (; *s; ++s) {
+      if (strncasecmp(s, token, n) == 0) return true;
+    }
+    return false;
+  }
+};
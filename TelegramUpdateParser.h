@@ -0,0 +1,431 @@
+// TelegramUpdateParser.h
+// Parser incremental (byte a byte) de respuestas de getUpdates, o de un
+// update suelto (cuerpo de un POST de webhook, ver TelegramWebhook.h).
+// Lee directamente del cuerpo HTTP y entrega los updates de uno en uno con
+// update_id, from.id, chat.id, nombre y texto. La memoria es fija (unos
+// 400 bytes) sea cual sea el tamaño de la respuesta: no se guarda el JSON,
+// sólo el camino actual (result[i].message.chat.id, ...) y los campos que
+// interesan. Los textos que no caben se truncan sin partir caracteres UTF-8.
+//
+// Uso:
+//   TelegramUpdateParser parser;
+//   parser.reset();
+//   while (parser.next(poller.transport())) {
+//     const TelegramUpdate &u = parser.update();
+//     ...
+//   }
+//
+//   parser.reset(TelegramUpdateParser::SINGLE);   // webhook: {"update_id":...}
+//   for (...) if (parser.feed(c)) ...
+#pragma once
+
+#include "TelegramTransport.h"
+
+struct TelegramUpdate {
+  int64_t updateId;
+  int64_t fromId;
+  int64_t chatId;
+  bool hasMessage;
+  bool hasText;
+  bool textTruncated;
+  char fromName[33];   // username, o first_name si no tiene
+  char text[256];
+};
+
+class TelegramUpdateParser {
+public:
+  enum { MAX_DEPTH = 8, KEY_LEN = 16 };
+
+  // BATCH: {"ok":true,"result":[{update},...]} (getUpdates)
+  // SINGLE: {update} (webhook)
+  enum Mode : uint8_t { BATCH, SINGLE };
+
+  void reset(Mode mode = BATCH) {
+    _base = mode == SINGLE ? 0 : 2;
+    _depth = 0;
+    _inString = false;
+    _escape = false;
+    _uDigits = -1;
+    _highSurrogate = 0;
+    _inLiteral = false;
+    _expectKey = false;
+    _ok = false;
+    _bufPos = _bufLen = 0;
+    clearUpdate();
+  }
+
+  // Procesa un byte. Devuelve true cuando se acaba de cerrar un update
+  // (disponible en update() hasta el siguiente feed()).
+  bool feed(char c) {
+    if (_inString) {
+      feedString(c);
+      return false;
+    }
+    if (_inLiteral) {
+      if (isLiteralChar(c)) {
+        feedLiteral(c);
+        return false;
+      }
+      endLiteral();
+      // c es un delimitador: se procesa abajo
+    }
+
+    switch (c) {
+      case '{':
+      case '[':
+        if (_depth == _base && c == '{' && inResult()) clearUpdate();
+        push(c == '[');
+        return false;
+      case '}':
+      case ']': {
+        bool emit = (c == '}' && _depth == _base + 1 && inResult() && _update.updateId >= 0);
+        pop();
+        return emit;
+      }
+      case ':':
+        _expectKey = false;
+        return false;
+      case ',':
+        _expectKey = currentIsObject();
+        return false;
+      case '"':
+        startString();
+        return false;
+      case ' ': case '\t': case '\r': case '\n':
+        return false;
+      default:
+        if (isLiteralChar(c)) {
+          _inLiteral = true;
+          _litNeg = false;
+          _litValue = 0;
+          _litFirst = c;
+          _litDigits = true;
+          feedLiteral(c);
+        }
+        return false;
+    }
+  }
+
+  // Lee del cuerpo de la respuesta hasta completar el siguiente update.
+  // false = fin del cuerpo (o se cortó la conexión / no llegan datos).
+  bool next(TelegramTransport &body, unsigned long idleTimeoutMs = 5000) {
+    unsigned long lastData = millis();
+    while (true) {
+      while (_bufPos < _bufLen) {
+        if (feed((char)_buf[_bufPos++])) return true;
+      }
+      if (body.bodyDone()) return false;
+      int n = body.readSome(_buf, sizeof(_buf));
+      if (n > 0) {
+        _bufPos = 0;
+        _bufLen = n;
+        lastData = millis();
+        continue;
+      }
+      if (!body.connected() || millis() - lastData > idleTimeoutMs) return false;
+      delay(1);
+    }
+  }
+
+  const TelegramUpdate &update() const { return _update; }
+  bool ok() const { return _ok; }   // "ok":true en la respuesta
+
+private:
+  enum Key : uint8_t {
+    K_OTHER, K_OK, K_RESULT, K_UPDATE_ID, K_MESSAGE, K_FROM, K_CHAT, K_ID,
+    K_TEXT, K_USERNAME, K_FIRST_NAME
+  };
+  enum Capture : uint8_t { CAP_NONE, CAP_KEY, CAP_TEXT, CAP_NAME };
+
+  TelegramUpdate _update;
+  bool _nameIsUsername = false;
+
+  // camino actual (el objeto update se abre en el nivel _base)
+  uint8_t _base = 2;
+  uint8_t _depth = 0;
+  bool _isArray[MAX_DEPTH];
+  Key _key[MAX_DEPTH];
+  bool _expectKey = false;
+  bool _ok = false;
+
+  // string en curso
+  bool _inString = false;
+  bool _escape = false;
+  int8_t _uDigits = -1;        // >=0 mientras se leen los 4 hex de \uXXXX
+  uint16_t _uValue = 0;
+  uint16_t _highSurrogate = 0;
+  Capture _cap = CAP_NONE;
+  char *_capBuf = nullptr;
+  size_t _capSize = 0;
+  size_t _capLen = 0;
+  bool _capTruncated = false;
+  char _keyBuf[KEY_LEN];
+
+  // número / true / false / null en curso
+  bool _inLiteral = false;
+  bool _litNeg = false;
+  bool _litDigits = true;      // sólo dígitos hasta ahora (entero)
+  char _litFirst = 0;
+  int64_t _litValue = 0;
+
+  // buffer de lectura
+  uint8_t _buf[64];
+  uint8_t _bufPos = 0;
+  uint8_t _bufLen = 0;
+
+  void clearUpdate() {
+    _update.updateId = -1;
+    _update.fromId = 0;
+    _update.chatId = 0;
+    _update.hasMessage = false;
+    _update.hasText = false;
+    _update.textTruncated = false;
+    _update.fromName[0] = '\0';
+    _update.text[0] = '\0';
+    _nameIsUsername = false;
+  }
+
+  void push(bool isArray) {
+    if (_depth == _base + 1 && !isArray && inResult() && keyAt(_base) == K_MESSAGE) _update.hasMessage = true;
+    if (_depth < MAX_DEPTH) {
+      _isArray[_depth] = isArray;
+      _key[_depth] = K_OTHER;
+    }
+    _depth++;
+    _expectKey = !isArray;
+  }
+
+  void pop() {
+    if (_depth > 0) _depth--;
+    _expectKey = false;
+  }
+
+  bool currentIsObject() const {
+    return _depth > 0 && _depth <= MAX_DEPTH && !_isArray[_depth - 1];
+  }
+
+  Key keyAt(uint8_t level) const {
+    return level < _depth && level < MAX_DEPTH ? _key[level] : K_OTHER;
+  }
+
+  // Dentro del array result (en SINGLE, todo el cuerpo es el update)
+  bool inResult() const {
+    if (_base == 0) return true;
+    return _depth >= 2 && keyAt(0) == K_RESULT && _isArray[1];
+  }
+
+  // Qué campo es el valor que empieza ahora (según el camino actual)
+  Capture captureForValue() const {
+    if (!inResult() || keyAt(_base) != K_MESSAGE) return CAP_NONE;
+    if (_depth == _base + 2 && keyAt(_base + 1) == K_TEXT) return CAP_TEXT;
+    if (_depth == _base + 3 && keyAt(_base + 1) == K_FROM) {
+      if (keyAt(_base + 2) == K_USERNAME) return CAP_NAME;
+      if (keyAt(_base + 2) == K_FIRST_NAME && !_nameIsUsername) return CAP_NAME;
+    }
+    return CAP_NONE;
+  }
+
+  // ---------------- strings ----------------
+  void startString() {
+    _inString = true;
+    _escape = false;
+    _uDigits = -1;
+    _highSurrogate = 0;
+    _capLen = 0;
+    _capTruncated = false;
+    if (_expectKey && currentIsObject()) {
+      _cap = CAP_KEY;
+      _capBuf = _keyBuf;
+      _capSize = sizeof(_keyBuf);
+    } else {
+      _cap = captureForValue();
+      if (_cap == CAP_TEXT) {
+        _capBuf = _update.text;
+        _capSize = sizeof(_update.text);
+      } else if (_cap == CAP_NAME) {
+        _capBuf = _update.fromName;
+        _capSize = sizeof(_update.fromName);
+      } else {
+        _capBuf = nullptr;
+        _capSize = 0;
+      }
+    }
+  }
+
+  void feedString(char c) {
+    if (_uDigits >= 0) {
+      int h = hexValue(c);
+      _uValue = (uint16_t)((_uValue << 4) | (h < 0 ? 0 : h));
+      if (++_uDigits == 4) {
+        _uDigits = -1;
+        emitCodeUnit(_uValue);
+      }
+      return;
+    }
+    if (_escape) {
+      _escape = false;
+      switch (c) {
+        case 'n': appendByte('\n'); break;
+        case 'r': appendByte('\r'); break;
+        case 't': appendByte('\t'); break;
+        case 'b': appendByte('\b'); break;
+        case 'f': appendByte('\f'); break;
+        case 'u': _uDigits = 0; _uValue = 0; break;
+        default:  appendByte(c); break;   // \" \\ \/
+      }
+      return;
+    }
+    if (c == '\\') {
+      _escape = true;
+      return;
+    }
+    if (c == '"') {
+      endString();
+      return;
+    }
+    appendByte(c);
+  }
+
+  // \uXXXX -> UTF-8 (con pares sustitutos para emojis)
+  void emitCodeUnit(uint16_t u) {
+    uint32_t cp;
+    if (u >= 0xD800 && u <= 0xDBFF) {
+      _highSurrogate = u;
+      return;
+    }
+    if (u >= 0xDC00 && u <= 0xDFFF && _highSurrogate) {
+      cp = 0x10000 + (((uint32_t)_highSurrogate - 0xD800) << 10) + (u - 0xDC00);
+    } else {
+      cp = u;
+    }
+    _highSurrogate = 0;
+
+    char out[4];
+    size_t n;
+    if (cp < 0x80) {
+      out[0] = (char)cp; n = 1;
+    } else if (cp < 0x800) {
+      out[0] = (char)(0xC0 | (cp >> 6));
+      out[1] = (char)(0x80 | (cp & 0x3F)); n = 2;
+    } else if (cp < 0x10000) {
+      out[0] = (char)(0xE0 | (cp >> 12));
+      out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      out[2] = (char)(0x80 | (cp & 0x3F)); n = 3;
+    } else {
+      out[0] = (char)(0xF0 | (cp >> 18));
+      out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+      out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      out[3] = (char)(0x80 | (cp & 0x3F)); n = 4;
+    }
+    // el carácter entra entero o no entra
+    if (!_capBuf || _capLen + n >= _capSize) {
+      if (_capBuf) _capTruncated = true;
+      return;
+    }
+    memcpy(_capBuf + _capLen, out, n);
+    _capLen += n;
+  }
+
+  void appendByte(char c) {
+    if (!_capBuf) return;
+    if (_capLen + 1 >= _capSize) {
+      _capTruncated = true;
+      return;
+    }
+    _capBuf[_capLen++] = c;
+  }
+
+  void endString() {
+    _inString = false;
+    if (!_capBuf) return;
+    if (_capTruncated) trimPartialUtf8();
+    _capBuf[_capLen] = '\0';
+
+    if (_cap == CAP_KEY) {
+      if (_depth <= MAX_DEPTH) _key[_depth - 1] = _capTruncated ? K_OTHER : keyId(_keyBuf);
+      _capBuf = nullptr;
+      return;
+    }
+    if (_cap == CAP_TEXT) {
+      _update.hasText = true;
+      _update.textTruncated = _capTruncated;
+    } else if (_cap == CAP_NAME) {
+      if (keyAt(_base + 2) == K_USERNAME) _nameIsUsername = true;
+    }
+    _capBuf = nullptr;
+  }
+
+  // Quita una secuencia UTF-8 incompleta al final del buffer truncado
+  void trimPartialUtf8() {
+    size_t i = _capLen;
+    size_t back = 0;
+    while (i > 0 && back < 4 && (((uint8_t)_capBuf[i - 1]) & 0xC0) == 0x80) {
+      i--;
+      back++;
+    }
+    if (i == 0) return;
+    uint8_t lead = (uint8_t)_capBuf[i - 1];
+    size_t need = (lead >= 0xF0) ? 3 : (lead >= 0xE0) ? 2 : (lead >= 0xC0) ? 1 : 0;
+    if (lead >= 0xC0 && back < need) _capLen = i - 1;
+  }
+
+  // ---------------- números y literales ----------------
+  static bool isLiteralChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+
+  void feedLiteral(char c) {
+    if (c == '-' && _litValue == 0 && !_litNeg) {
+      _litNeg = true;
+    } else if (c >= '0' && c <= '9' && _litDigits) {
+      _litValue = _litValue * 10 + (c - '0');
+    } else {
+      _litDigits = false;   // decimales, exponente o true/false/null
+    }
+  }
+
+  // Se ha completado un número o literal: ¿es uno de los campos que interesan?
+  void endLiteral() {
+    _inLiteral = false;
+    if (_base == 2 && _depth == 1 && keyAt(0) == K_OK) {
+      _ok = (_litFirst == 't');
+      return;
+    }
+    if (!_litDigits || !inResult()) return;
+    int64_t v = _litNeg ? -_litValue : _litValue;
+    if (_depth == _base + 1 && keyAt(_base) == K_UPDATE_ID) {
+      _update.updateId = v;
+    } else if (_depth == _base + 3 && keyAt(_base) == K_MESSAGE && keyAt(_base + 2) == K_ID) {
+      if (keyAt(_base + 1) == K_FROM) _update.fromId = v;
+      else if (keyAt(_base + 1) == K_CHAT) _update.chatId = v;
+    }
+  }
+
+  static Key keyId(const char *k) {
+    switch (k[0]) {
+      case 'o': if (!strcmp(k, "ok")) return K_OK; break;
+      case 'r': if (!strcmp(k, "result")) return K_RESULT; break;
+      case 'u':
+        if (!strcmp(k, "update_id")) return K_UPDATE_ID;
+        if (!strcmp(k, "username")) return K_USERNAME;
+        break;
+      case 'm': if (!strcmp(k, "message")) return K_MESSAGE; break;
+      case 'f':
+        if (!strcmp(k, "from")) return K_FROM;
+        if (!strcmp(k, "first_name")) return K_FIRST_NAME;
+        break;
+      case 'c': if (!strcmp(k, "chat")) return K_CHAT; break;
+      case 'i': if (!strcmp(k, "id")) return K_ID; break;
+      case 't': if (!strcmp(k, "text")) return K_TEXT; break;
+    }
+    return K_OTHER;
+  }
+
+  static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+};
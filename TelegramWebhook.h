@@ -0,0 +1,217 @@
+// TelegramWebhook.h
+// Recepción de comandos por webhook en vez de long-poll: un servidor HTTP
+// mínimo en el ESP32 al que llegan los updates por POST (un update por
+// petición, el mismo JSON que manda Telegram). Sin tráfico en reposo: no
+// hay peticiones abiertas ni reintentos, sólo un accept() no bloqueante.
+//
+// Telegram sólo entrega webhooks por HTTPS en los puertos 443, 80, 88 o
+// 8443, así que lo normal es un proxy inverso en la red local (nginx,
+// Caddy...) que termina TLS y reenvía en HTTP plano al dispositivo:
+//   https://<dominio>/tg  ->  http://<ip del ESP32>:<port>/tg
+// y registrar la URL una vez:
+//   curl "https://api.telegram.org/bot<TOKEN>/setWebhook?url=https://<dominio>/tg&secret_token=<secret>"
+// Con un webhook activo getUpdates devuelve 409: no usar a la vez que
+// TelegramLongPoll (para volver al long-poll, deleteWebhook).
+//
+// Para probar sin Telegram basta con hacer de proxy a mano:
+//   curl -H "X-Telegram-Bot-Api-Secret-Token: <secret>" http://<ip del ESP32>:<port>/tg
+//     -d '{"update_id":1,"message":{"from":{"id":5,"first_name":"A"},"chat":{"id":5},"text":"/estado"}}'
+//
+// Uso:
+//   TelegramWebhook hook;
+//   hook.path = "/tg";
+//   hook.secret = "...";              // mismo secret_token que en setWebhook (obligatorio)
+//   if (!hook.begin(8080)) ...        // sin secreto no arranca
+//   void loop() {
+//     if (hook.service()) {           // ya se ha respondido 200
+//       const TelegramUpdate &u = hook.update();
+//       ...
+//     }
+//   }
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "TelegramUpdateParser.h"
+
+class TelegramWebhook {
+public:
+  struct Stats {
+    uint32_t requests;      // peticiones aceptadas
+    uint32_t updates;       // updates nuevos entregados
+    uint32_t duplicates;    // reenvíos de un update ya visto
+    uint32_t rejected;      // método, ruta, secreto o tamaño incorrectos
+    uint32_t timeouts;      // el cliente no terminó de enviar a tiempo
+  };
+
+  const char *path = "/";             // ruta del POST (sin contar ?query)
+  const char *secret = nullptr;       // X-Telegram-Bot-Api-Secret-Token, máx. 64 (obligatorio)
+  uint16_t requestTimeoutMs = 2000;   // para recibir cabeceras y cuerpo
+  uint32_t maxBody = 16384;           // cuerpos mayores se rechazan (413)
+
+  // Último update_id entregado: los que no lo superen se responden 200 y se
+  // descartan (Telegram reenvía si la respuesta no le llega)
+  int64_t lastUpdateId = 0;
+
+  // Sin secreto no se arranca: cualquiera en la red podría mandar un update
+  // con el chat y el usuario del dueño y ejecutar sus comandos. Avisar
+  // (Serial, /estado...) queda para quien llama.
+  bool begin(uint16_t port) {
+    if (!secret || !*secret) return false;
+    _server.begin(port);
+    _server.setNoDelay(true);
+    _started = true;
+    return true;
+  }
+
+  bool started() const { return _started; }
+
+  // Atiende como mucho una petición pendiente. Devuelve true si trae un
+  // update nuevo (en update() hasta la siguiente llamada). La respuesta HTTP
+  // ya se ha enviado: el comando puede tardar lo que necesite.
+  bool service() {
+    if (!_started) return false;
+    WiFiClient c = _server.available();
+    if (!c) return false;
+    bool got = handle(c);
+    c.stop();
+    return got;
+  }
+
+  // Procesa una petición completa de un cliente ya conectado (service() lo
+  // usa con los del servidor; sirve igual con cualquier otro Client)
+  bool handle(Client &c) {
+    _st.requests++;
+    _deadline = millis() + requestTimeoutMs;
+
+    // 1) línea de petición: "POST /ruta HTTP/1.1"
+    char line[128];
+    int n = readLine(c, line, sizeof(line));
+    if (n < 0) return fail(c, 408, "Request Timeout");
+    bool post = strncmp(line, "POST ", 5) == 0;
+    bool pathOk = post && matchPath(line + 5);
+
+    // 2) cabeceras: sólo interesan la longitud y el secreto
+    long length = -1;
+    bool secretOk = false;
+    while (true) {
+      n = readLine(c, line, sizeof(line));
+      if (n < 0) return fail(c, 408, "Request Timeout");
+      if (n == 0) break;
+      const char *v;
+      if ((v = headerValue(line, "content-length"))) length = atol(v);
+      else if (secret && *secret && (v = headerValue(line, "x-telegram-bot-api-secret-token"))) secretOk = sameSecret(v);
+    }
+    if (!post) return fail(c, 405, "Method Not Allowed");
+    if (!pathOk) return fail(c, 404, "Not Found");
+    if (!secretOk) return fail(c, 401, "Unauthorized");
+    if (length < 0) return fail(c, 411, "Length Required");
+    if ((uint32_t)length > maxBody) return fail(c, 413, "Payload Too Large");
+
+    // 3) cuerpo: se parsea según llega, sin guardarlo
+    _parser.reset(TelegramUpdateParser::SINGLE);
+    bool got = false;
+    uint8_t buf[64];
+    long left = length;
+    while (left > 0) {
+      int r = readSome(c, buf, left < (long)sizeof(buf) ? (size_t)left : sizeof(buf));
+      if (r < 0) return fail(c, 408, "Request Timeout");
+      left -= r;
+      for (int k = 0; k < r && !got; ++k) {
+        got = _parser.feed((char)buf[k]);   // después del update sólo queda el '}' final
+      }
+    }
+
+    // 4) 200 siempre que el cuerpo llegó entero: si no, Telegram lo reenvía
+    reply(c, 200, "OK");
+    if (!got) return false;
+    const TelegramUpdate &u = _parser.update();
+    if (u.updateId <= lastUpdateId) {
+      _st.duplicates++;
+      return false;
+    }
+    lastUpdateId = u.updateId;
+    _st.updates++;
+    return true;
+  }
+
+  const TelegramUpdate &update() const { return _parser.update(); }
+  const Stats &stats() const { return _st; }
+
+private:
+  WiFiServer _server;
+  bool _started = false;
+  TelegramUpdateParser _parser;
+  Stats _st = {};
+  unsigned long _deadline = 0;
+
+  bool expired() const { return (long)(millis() - _deadline) >= 0; }
+
+  // Lee hasta '\n' sin el "\r\n". Lo que no cabe se descarta (la línea
+  // queda truncada). -1 si vence el plazo o se corta la conexión.
+  int readLine(Client &c, char *out, size_t size) {
+    size_t len = 0;
+    while (true) {
+      int ch = c.read();
+      if (ch < 0) {
+        if (expired() || !c.connected()) return -1;
+        delay(1);
+        continue;
+      }
+      if (ch == '\n') break;
+      if (ch != '\r' && len + 1 < size) out[len++] = (char)ch;
+    }
+    out[len] = '\0';
+    return (int)len;
+  }
+
+  // Lee lo que haya (máx n); espera si aún no ha llegado nada
+  int readSome(Client &c, uint8_t *buf, size_t n) {
+    while (true) {
+      int r = c.available() > 0 ? c.read(buf, n) : 0;
+      if (r > 0) return r;
+      if (expired() || !c.connected()) return -1;
+      delay(1);
+    }
+  }
+
+  // "/ruta HTTP/1.1" o "/ruta?x=y HTTP/1.1"
+  bool matchPath(const char *p) const {
+    size_t n = strlen(path);
+    return strncmp(p, path, n) == 0 && (p[n] == ' ' || p[n] == '?');
+  }
+
+  // Valor de la cabecera si la línea es "Nombre: valor" (nombre en minúsculas)
+  static const char *headerValue(const char *line, const char *name) {
+    size_t k = 0;
+    for (; name[k]; ++k) {
+      if (tolower((unsigned char)line[k]) != name[k]) return nullptr;
+    }
+    if (line[k] != ':') return nullptr;
+    k++;
+    while (line[k] == ' ' || line[k] == '\t') k++;
+    return line + k;
+  }
+
+  // Comparación en tiempo constante (no da pistas por la duración)
+  bool sameSecret(const char *v) const {
+    size_t n = strlen(secret), vn = strlen(v);
+    uint8_t diff = vn != n;
+    for (size_t k = 0; k < n; ++k) diff |= (uint8_t)((k < vn ? v[k] : 0) ^ secret[k]);
+    return diff == 0;
+  }
+
+  void reply(Client &c, int code, const char *reason) {
+    char head[96];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", code, reason);
+    c.write((const uint8_t *)head, n);
+    c.flush();
+  }
+
+  bool fail(Client &c, int code, const char *reason) {
+    if (code == 408) _st.timeouts++;
+    else _st.rejected++;
+    if (c.connected()) reply(c, code, reason);
+    return false;
+  }
+};
@@ -0,0 +1,191 @@
+// TelemetryLog.h
+// Registro de muestras de telemetría en un anillo de bytes pensado para la
+// memoria RTC: sobrevive a reinicios por software y a deep sleep, así que
+// lo que no se pudo enviar durante un corte de WiFi/Telegram sigue ahí.
+//
+// Cada muestra se guarda como diferencia con la anterior (varint zigzag):
+// una muestra típica ocupa ~8 bytes en vez de 13. Si lleva el resumen de la
+// ventana (WindowSampler.h), mín/máx/p95 van como diferencia con la media de
+// la propia muestra: ~28 bytes en total. Cuando el anillo se llena se
+// descartan las más antiguas (y se cuentan en lost()).
+//
+//   RTC_NOINIT_ATTR TelemetryLog::State telemState;   // en el sketch
+//   TelemetryLog telemLog(telemState);
+//   telemLog.begin();            // conserva lo que hubiera si es válido
+//   telemLog.push(sample);
+//   n = telemLog.peek(buf, 20);  // las más antiguas primero
+//   telemLog.drop(n);            // cuando ya se han entregado
+#pragma once
+
+#include <Arduino.h>
+
+struct TelemetrySample {
+  uint32_t t;               // s (epoch si hay hora, si no uptime)
+  int8_t rssi;              // con ventana: la media
+  uint32_t freeHeap;        // con ventana: la media
+  uint32_t largestBlock;
+  // Ventana desde la muestra anterior (windowN = 0: lectura suelta, sin el resto)
+  uint16_t windowN;
+  int8_t rssiMin, rssiMax, rssiP95;
+  uint32_t heapMin, heapMax, heapP95;
+  uint32_t loopMeanUs, loopMaxUs, loopP95Us;
+};
+
+class TelemetryLog {
+public:
+  enum { CAPACITY = 2048, MAX_RECORD = 72 };
+
+  struct State {
+    uint32_t magic;
+    uint16_t head;            // offset del registro más antiguo
+    uint16_t used;            // bytes ocupados
+    uint16_t count;           // registros
+    TelemetrySample base;     // muestra anterior al registro más antiguo
+    TelemetrySample last;     // última muestra guardada
+    uint32_t lost;            // descartadas por falta de sitio
+    uint32_t check;           // suma de la cabecera (detecta RTC sin inicializar)
+    uint8_t data[CAPACITY];
+  };
+
+  explicit TelemetryLog(State &st) : _st(st) {}
+
+  // true si se ha conservado el contenido anterior (reinicio o deep sleep)
+  bool begin() {
+    if (_st.magic == MAGIC && _st.check == headerSum() && _st.head < CAPACITY && _st.used <= CAPACITY) {
+      return true;
+    }
+    clear();
+    return false;
+  }
+
+  void clear() {
+    memset(&_st, 0, sizeof(State) - CAPACITY);
+    _st.magic = MAGIC;
+    seal();
+  }
+
+  void push(const TelemetrySample &s) {
+    uint8_t rec[MAX_RECORD];
+    size_t len = 0;
+    len += putVarint(rec + len, zigzag((int32_t)(s.t - _st.last.t)));
+    len += putVarint(rec + len, zigzag((int32_t)s.rssi - _st.last.rssi));
+    len += putVarint(rec + len, zigzag((int32_t)(s.freeHeap - _st.last.freeHeap)));
+    len += putVarint(rec + len, zigzag((int32_t)(s.largestBlock - _st.last.largestBlock)));
+    len += putVarint(rec + len, s.windowN);
+    if (s.windowN) {
+      len += putVarint(rec + len, zigzag((int32_t)s.rssiMin - s.rssi));
+      len += putVarint(rec + len, zigzag((int32_t)s.rssiMax - s.rssi));
+      len += putVarint(rec + len, zigzag((int32_t)s.rssiP95 - s.rssi));
+      len += putVarint(rec + len, zigzag((int32_t)(s.heapMin - s.freeHeap)));
+      len += putVarint(rec + len, zigzag((int32_t)(s.heapMax - s.freeHeap)));
+      len += putVarint(rec + len, zigzag((int32_t)(s.heapP95 - s.freeHeap)));
+      len += putVarint(rec + len, s.loopMeanUs);
+      len += putVarint(rec + len, s.loopMaxUs);
+      len += putVarint(rec + len, s.loopP95Us);
+    }
+    while ((size_t)(CAPACITY - _st.used) < len) {
+      dropOldest();
+      _st.lost++;
+    }
+    uint16_t pos = (_st.head + _st.used) % CAPACITY;
+    for (size_t i = 0; i < len; ++i) _st.data[(pos + i) % CAPACITY] = rec[i];
+    _st.used += len;
+    _st.count++;
+    _st.last = s;
+    seal();
+  }
+
+  // Copia hasta max muestras, de la más antigua a la más nueva, sin quitarlas
+  size_t peek(TelemetrySample *out, size_t max) const {
+    TelemetrySample cur = _st.base;
+    uint16_t pos = _st.head;
+    size_t n = 0;
+    while (n < max && n < _st.count) {
+      pos = decode(pos, cur);
+      out[n++] = cur;
+    }
+    return n;
+  }
+
+  // Quita las n muestras más antiguas (ya entregadas)
+  void drop(size_t n) {
+    while (n-- > 0 && _st.count > 0) dropOldest();
+    seal();
+  }
+
+  size_t count() const { return _st.count; }
+  size_t bytesUsed() const { return _st.used; }
+  uint32_t lost() const { return _st.lost; }
+
+private:
+  static const uint32_t MAGIC = 0x544C4F32;   // "TLO2" (con ventana)
+  State &_st;
+
+  void dropOldest() {
+    if (_st.count == 0) return;
+    uint16_t next = decode(_st.head, _st.base);
+    _st.used -= (uint16_t)((next + CAPACITY - _st.head) % CAPACITY);
+    _st.head = next;
+    _st.count--;
+    if (_st.count == 0) {
+      _st.used = 0;
+      _st.base = _st.last;
+    }
+  }
+
+  // Aplica el registro que empieza en pos a s; devuelve el offset siguiente
+  uint16_t decode(uint16_t pos, TelemetrySample &s) const {
+    s.t += (uint32_t)unzigzag(getVarint(pos));
+    s.rssi = (int8_t)(s.rssi + unzigzag(getVarint(pos)));
+    s.freeHeap += (uint32_t)unzigzag(getVarint(pos));
+    s.largestBlock += (uint32_t)unzigzag(getVarint(pos));
+    s.windowN = (uint16_t)getVarint(pos);
+    if (s.windowN) {
+      s.rssiMin = (int8_t)(s.rssi + unzigzag(getVarint(pos)));
+      s.rssiMax = (int8_t)(s.rssi + unzigzag(getVarint(pos)));
+      s.rssiP95 = (int8_t)(s.rssi + unzigzag(getVarint(pos)));
+      s.heapMin = s.freeHeap + (uint32_t)unzigzag(getVarint(pos));
+      s.heapMax = s.freeHeap + (uint32_t)unzigzag(getVarint(pos));
+      s.heapP95 = s.freeHeap + (uint32_t)unzigzag(getVarint(pos));
+      s.loopMeanUs = getVarint(pos);
+      s.loopMaxUs = getVarint(pos);
+      s.loopP95Us = getVarint(pos);
+    }
+    return pos;
+  }
+
+  uint32_t getVarint(uint16_t &pos) const {
+    uint32_t v = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+      uint8_t b = _st.data[pos];
+      pos = (pos + 1) % CAPACITY;
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) break;
+    }
+    return v;
+  }
+
+  static size_t putVarint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+      p[n++] = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+  }
+
+  static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+  static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+  // FNV-1a de la cabecera (todo menos data y el propio check)
+  uint32_t headerSum() const {
+    const uint8_t *p = (const uint8_t *)&_st;
+    size_t n = offsetof(State, check);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 16777619u;
+    return h;
+  }
+
+  void seal() { _st.check = headerSum(); }
+};
@@ -0,0 +1,208 @@
+// TelemetryStream.h
+// Telemetría de alta frecuencia por UDP a un colector de la red local
+// (una vez por segundo o más), para lo que Telegram no sirve: allí se
+// quedan los resúmenes y las alarmas.
+//
+// Cada datagrama lleva un registro en CBOR (RFC 8949): un array de enteros
+// en este orden, 30-40 bytes en total:
+//   [versión=1, seq, uptime_ms, ip, rssi, heap_libre, heap_mínimo,
+//    mayor_bloque, frag_%, vueltas_loop, loop_máx_us]
+// ip va como uint32 a.b.c.d -> a<<24 | ... (igual que en IcmpSweep). seq
+// sube de uno en uno: los huecos son datagramas perdidos.
+//
+// Sin colector se puede mirar con cualquier escucha UDP, p. ej. (pip install cbor2):
+//   python3 -c "import socket,cbor2; s=socket.socket(2,2); s.bind(('',9999))
+//   while 1: print(cbor2.loads(s.recv(256)))"
+//
+//   TelemetryStream stream;
+//   LoopStats loopStats;
+//   stream.begin(IPAddress(192, 168, 1, 10), 9999);
+//   void loop() {
+//     loopStats.tick();
+//     if (stream.due()) { TelemetryStream::Record r; ...; stream.send(r); }
+//   }
+#pragma once
+
+#include <Arduino.h>
+#include "lwip/sockets.h"
+
+// ---- CBOR mínimo (enteros y arrays) en un buffer fijo ----
+
+class CborWriter {
+public:
+  CborWriter(uint8_t *buf, size_t cap) : _buf(buf), _cap(cap) {}
+
+  void array(size_t n) { head(4, n); }
+  void unsignedInt(uint64_t v) { head(0, v); }
+  void signedInt(int64_t v) {
+    if (v < 0) head(1, (uint64_t)(-1 - v));
+    else head(0, (uint64_t)v);
+  }
+
+  size_t size() const { return _len; }
+  bool ok() const { return _ok; }     // false si no cupo
+
+private:
+  uint8_t *_buf;
+  size_t _cap;
+  size_t _len = 0;
+  bool _ok = true;
+
+  // Cabecera: tipo mayor en los 3 bits altos y el valor en la forma más corta
+  void head(uint8_t major, uint64_t v) {
+    uint8_t m = (uint8_t)(major << 5);
+    if (v < 24) {
+      put(m | (uint8_t)v);
+    } else if (v <= 0xFF) {
+      put(m | 24);
+      put((uint8_t)v);
+    } else if (v <= 0xFFFF) {
+      put(m | 25);
+      putBE(v, 2);
+    } else if (v <= 0xFFFFFFFFULL) {
+      put(m | 26);
+      putBE(v, 4);
+    } else {
+      put(m | 27);
+      putBE(v, 8);
+    }
+  }
+
+  void putBE(uint64_t v, uint8_t n) {
+    while (n--) put((uint8_t)(v >> (8 * n)));
+  }
+
+  void put(uint8_t b) {
+    if (_len < _cap) _buf[_len++] = b;
+    else _ok = false;
+  }
+};
+
+// ---- estadística del loop entre dos registros ----
+
+class LoopStats {
+public:
+  // Al principio de cada vuelta de loop()
+  void tick() {
+    uint32_t now = micros();
+    if (_started && now - _last > _maxUs) _maxUs = now - _last;
+    _started = true;
+    __atomic_store_n(&_last, now, __ATOMIC_RELAXED);
+    _count++;
+  }
+
+  // micros() de la última vuelta (0 = todavía ninguna); se puede leer desde
+  // otra tarea (WindowSampler)
+  uint32_t lastTickUs() const { return _started ? __atomic_load_n(&_last, __ATOMIC_RELAXED) : 0; }
+
+  // Vueltas y la más larga (us) desde la última llamada; empieza otro periodo
+  void take(uint32_t &loops, uint32_t &maxUs) {
+    loops = _count;
+    maxUs = _maxUs;
+    _count = 0;
+    _maxUs = 0;
+  }
+
+private:
+  bool _started = false;
+  uint32_t _last = 0;
+  uint32_t _count = 0;
+  uint32_t _maxUs = 0;
+};
+
+// ---- envío por UDP ----
+
+class TelemetryStream {
+public:
+  enum { VERSION = 1, RECORD_MAX = 64 };
+
+  struct Record {
+    uint32_t uptimeMs;
+    uint32_t ip;
+    int8_t rssi;
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t largestBlock;
+    uint8_t fragPct;
+    uint32_t loops;
+    uint32_t loopMaxUs;
+  };
+
+  struct Stats {
+    uint32_t sent;
+    uint32_t dropped;       // sendto() falló (sin buffers, sin red...)
+    uint32_t bytes;
+  };
+
+  uint32_t periodMs = 1000;
+
+  // Abre el socket; se puede llamar antes de tener WiFi
+  bool begin(IPAddress collector, uint16_t port) {
+    stop();
+    memset(&_to, 0, sizeof(_to));
+    _to.sin_family = AF_INET;
+    _to.sin_port = htons(port);
+    _to.sin_addr.s_addr = htonl(((uint32_t)collector[0] << 24) | ((uint32_t)collector[1] << 16) |
+                                ((uint32_t)collector[2] << 8) | collector[3]);
+    _fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_fd < 0) return false;
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+    _nextAt = millis();
+    return true;
+  }
+
+  void stop() {
+    if (_fd >= 0) closesocket(_fd);
+    _fd = -1;
+  }
+
+  // true cuando toca el siguiente registro (sin acumular retrasos)
+  bool due() {
+    if (_fd < 0 || (long)(millis() - _nextAt) < 0) return false;
+    _nextAt += periodMs;
+    if ((long)(millis() - _nextAt) >= 0) _nextAt = millis() + periodMs;   // se quedó atrás
+    return true;
+  }
+
+  // Codifica y envía un registro. No bloquea: si lwIP no tiene sitio se
+  // descarta (el siguiente llega en periodMs).
+  bool send(const Record &r) {
+    if (_fd < 0) return false;
+    uint8_t buf[RECORD_MAX];
+    size_t n = encode(r, _seq++, buf, sizeof(buf));
+    if (n && sendto(_fd, buf, n, 0, (struct sockaddr *)&_to, sizeof(_to)) == (int)n) {
+      _st.sent++;
+      _st.bytes += n;
+      return true;
+    }
+    _st.dropped++;
+    return false;
+  }
+
+  // Registro en CBOR; 0 si no cabe en cap
+  static size_t encode(const Record &r, uint32_t seq, uint8_t *out, size_t cap) {
+    CborWriter w(out, cap);
+    w.array(11);
+    w.unsignedInt(VERSION);
+    w.unsignedInt(seq);
+    w.unsignedInt(r.uptimeMs);
+    w.unsignedInt(r.ip);
+    w.signedInt(r.rssi);
+    w.unsignedInt(r.freeHeap);
+    w.unsignedInt(r.minFreeHeap);
+    w.unsignedInt(r.largestBlock);
+    w.unsignedInt(r.fragPct);
+    w.unsignedInt(r.loops);
+    w.unsignedInt(r.loopMaxUs);
+    return w.ok() ? w.size() : 0;
+  }
+
+  const Stats &stats() const { return _st; }
+
+private:
+  int _fd = -1;
+  struct sockaddr_in _to;
+  uint32_t _seq = 0;
+  unsigned long _nextAt = 0;
+  Stats _st = {};
+};
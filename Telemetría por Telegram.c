@@ -1,271 +1,464 @@
 // sketch_sep21a_complete.ino
 // Telemetría periódica + control vía Telegram (solo tu chat_id)
 
-
 const char* SSID = "SSID";
 // Si tu contraseña contiene una barra invertida '\' -> usa doble '\\'
 const char* PASS = "PASS";
 const char* TELEGRAM_BOT_TOKEN = "TOKEN"; // pon aquí el token nuevo
 const long   TELEGRAM_CHAT_ID  = CHAT_ID; 
+// Webhook (opcional): 0 = long-poll de getUpdates. Con un puerto, los
+// comandos llegan por POST desde un proxy inverso con HTTPS (ver
+// TelegramWebhook.h) y no se hace ninguna petición mientras no hay mensajes.
+const uint16_t WEBHOOK_PORT = 0;
+const char* WEBHOOK_PATH = "/tg";
+const char* WEBHOOK_SECRET = "";          // secret_token de setWebhook (obligatorio: sin él no arranca)
+// Telemetría rápida por UDP (CBOR, ver TelemetryStream.h) a un colector
+// local: "" = desactivada. Telegram se queda con los resúmenes y alarmas.
+const char* STREAM_HOST = "";             // IP del colector, p. ej. "192.168.1.10"
+const uint16_t STREAM_PORT = 9999;
+const uint32_t STREAM_PERIOD_MS = 1000;
+// Muestreo de fondo de RSSI, heap y latencia de loop(): cada muestra de
+// telemetría lleva mín/máx/media/p95 de su intervalo (ver WindowSampler.h)
+const uint16_t SAMPLE_PERIOD_MS = 100;
+// Endpoint /metrics para Prometheus (ver MetricsServer.h): 0 = desactivado
+const uint16_t METRICS_PORT = 0;          // p. ej. 9100
 // --------------------------------------------------
 
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
-#include <HTTPClient.h>
-#include <ArduinoJson.h>      // >= v7
 #include <Preferences.h>
+#include "TelegramOutbox.h"
+#include "TelegramPoller.h"
+#include "TelegramUpdateParser.h"
+#include "TelegramWebhook.h"
+#include "TextBuffer.h"
+#include "HeapMetrics.h"
+#include "TelemetryLog.h"
+#include "TelemetryStream.h"
+#include "WindowSampler.h"
+#include "MetricsServer.h"
+#include "PersistentState.h"
+#include "FastConnect.h"
+#include "CommandRouter.h"
+#include "esp_system.h"
+#include <time.h>
 
 // Ajustes por defecto
 #define DEFAULT_TELEM_INTERVAL_MS  (10UL * 60UL * 1000UL) // 10 min por defecto
+#define DEFAULT_TELEM_BATCH        6                      // muestras por mensaje (1 h con 10 min)
+#define TELEM_LINES_PER_MSG        20                     // máximo por mensaje al vaciar atrasos
 
 Preferences prefs;
 
+// Lo que se guarda en NVS. Se escribe en diferido (PersistentState.h):
+// las variables de abajo son la copia de trabajo y persistField() marca sólo
+// el campo que cambia.
+struct TelemState {
+  uint32_t intervalMs;
+  uint32_t lastTelem;       // sin uso (era millis(), no vale tras reiniciar); se deja por el formato
+  int32_t lastUpdate;
+  uint16_t batch;
+  uint8_t enabled;
+};
+PersistentState<TelemState> state;
+TelegramOutbox outbox;    // cola de envío con tarea propia (no bloquea loop())
+TelegramLongPoll poller;  // getUpdates long-poll en su propia conexión
+TelegramUpdateParser updParser;
+TelegramWebhook hook;     // si WEBHOOK_PORT: servidor HTTP en lugar del long-poll
+HeapMetrics heapMon;      // heap, fragmentación y pilas (va en /status)
+AllocCounter sendAllocs;  // heap en el camino de envío (tarea de la cola)
+AllocCounter pollAllocs;  // heap al atender cada respuesta de getUpdates
+
+// Muestras pendientes de enviar: en RTC, sobreviven a reinicios y cortes de red
+RTC_NOINIT_ATTR TelemetryLog::State telemState;
+TelemetryLog telemLog(telemState);
+uint16_t telemBatch = DEFAULT_TELEM_BATCH;
+size_t telemInFlight = 0;        // muestras del lote que está en la cola de envío
+uint32_t telemTicket = 0;        // id de ese lote en la cola (outbox.delivery())
+TelemetryStream stream;          // registros por UDP cada STREAM_PERIOD_MS
+LoopStats loopStats;             // vueltas de loop() y la más lenta, por registro
+WindowSampler sampler;           // lecturas cada SAMPLE_PERIOD_MS, resumidas por intervalo
+MetricsServer<5120> metrics;     // página de /metrics en un buffer fijo
+
 unsigned long telemIntervalMs = DEFAULT_TELEM_INTERVAL_MS;
 unsigned long lastTelemSent = 0;
 long lastUpdateId = 0;
 bool telemEnabled = true;
 
-unsigned long lastPollMs = 0;
-const unsigned long POLL_PERIOD_MS = 2000UL; // cada 2s mira updates (no abuses)
-
-// --- helpers ---
-String urlEncode(const String &str) {
-  String encoded = "";
-  char c;
-  const char *s = str.c_str();
-  for (size_t i = 0; i < str.length(); ++i) {
-    c = s[i];
-    if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
-        ('0' <= c && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
-      encoded += c;
-    } else if (c == ' ') {
-      encoded += '+';
-    } else {
-      char buf[5];
-      sprintf(buf, "%%%.2X", (unsigned char)c);
-      encoded += buf;
-    }
-  }
-  return encoded;
-}
+const uint16_t LONG_POLL_TIMEOUT_S = 25; // Telegram retiene getUpdates hasta 25s si no hay nada
+const unsigned long HEAP_CHECK_MS = 5000; // cada cuánto se mira el heap para las alarmas
+unsigned long lastHeapCheck = 0;
+
+// Red: BSSID/canal del último AP e IPs ya resueltas (en RTC, ver FastConnect.h)
+RTC_DATA_ATTR FastConnect::State netState;
+RTC_DATA_ATTR DnsCache::State dnsState;
+FastConnect net(netState);
+DnsCache dns(dnsState);
 
 void connectWiFi() {
   Serial.printf("Conectando a %s ...\n", SSID);
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(SSID, PASS);
-  unsigned long start = millis();
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-    if (millis() - start > 20000) { // 20s timeout
-      Serial.println("\nNo se pudo conectar en 20s. Reintentando...");
-      WiFi.disconnect();
-      delay(1000);
-      WiFi.begin(SSID, PASS);
-      start = millis();
-    }
+  // vía rápida (BSSID/canal guardados) y si no la completa, 20s de timeout
+  while (!net.connect(SSID, PASS, 20000)) {
+    Serial.println("No se pudo conectar en 20s. Reintentando...");
+    WiFi.disconnect();
+    delay(1000);
   }
-  Serial.println();
-  Serial.print("WiFi OK. IP: ");
+  Serial.printf("WiFi OK en %lu ms (%s). IP: ", net.connectMs(), net.lastWasFast() ? "rápida" : "completa");
   Serial.println(WiFi.localIP());
 }
 
-// sendMessage usando HTTPS (WiFiClientSecure). setInsecure() para evitar problemas de certificados
-bool sendTelegramMessage(const String &text) {
-  WiFiClientSecure client;
-  client.setInsecure(); // evita validación de certificado (útil para microcontrolador)
-  HTTPClient http;
-
-  String url = String("https://api.telegram.org/bot") + TELEGRAM_BOT_TOKEN + "/sendMessage";
-  http.begin(client, url);
-  http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+// Encola el mensaje; la tarea de la cola lo envía respetando el límite de
+// Telegram y reintentando si falla. Vuelve enseguida.
+bool sendTelegramMessage(const char *text) {
+  if (!outbox.send(TELEGRAM_CHAT_ID, text)) {
+    Serial.println("sendTelegramMessage: cola llena, mensaje descartado");
+    return false;
+  }
+  return true;
+}
 
-  String body = "chat_id=" + String(TELEGRAM_CHAT_ID) + "&text=" + urlEncode(text);
+// IP, MAC, RSSI, uptime y salud del heap (común a estado y telemetría)
+void printDeviceInfo(TextBuffer<640> &msg) {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  msg.print("IP: ");
+  msg.printIp(WiFi.localIP());
+  msg.print("\nMAC: ");
+  msg.printMac(mac);
+  msg.printf("\nRSSI: %d dBm\n", (int)WiFi.RSSI());
+  msg.printf("Uptime: %lu s\n", millis() / 1000);
+  heapMon.sample();
+  heapMon.printTo(msg);
+}
 
-  int code = http.POST(body);
-  if (code <= 0) {
-    Serial.printf("sendTelegramMessage: fallo POST (%d)\n", code);
-    http.end();
-    return false;
+void sendStatusTelegram() {
+  // Construye mensaje de estado (en la pila, sin String)
+  TextBuffer<640> msg;
+  msg.print("📡 Telemetría - Estado\n");
+  printDeviceInfo(msg);
+  msg.printf("Intervalo telem: %lu s\n", telemIntervalMs / 1000);
+  msg.printf("Telem activa: %s\n", telemEnabled ? "SI" : "NO");
+  msg.printf("Red: WiFi %lu ms (%s), primer byte a %lu ms, DNS %lu/%lu en caché\n", net.connectMs(),
+             net.lastWasFast() ? "rápida" : "completa", netFirstByteMs(), (unsigned long)dns.hits(),
+             (unsigned long)(dns.hits() + dns.misses()));
+  msg.printf("Lote: %u muestras, pendientes %u (%u B), perdidas %lu\n", (unsigned)telemBatch,
+             (unsigned)telemLog.count(), (unsigned)telemLog.bytesUsed(), (unsigned long)telemLog.lost());
+  if (WEBHOOK_PORT && !hook.started()) {
+    msg.print("Webhook desactivado: falta WEBHOOK_SECRET\n");
+  } else if (WEBHOOK_PORT) {
+    const TelegramWebhook::Stats &h = hook.stats();
+    msg.printf("Webhook :%u: %lu updates, %lu rechazados\n", (unsigned)WEBHOOK_PORT,
+               (unsigned long)h.updates, (unsigned long)(h.rejected + h.timeouts));
   }
-  // opcional: puedes parsear la respuesta y comprobar ok:true
-  String resp = http.getString();
-  Serial.printf("sendTelegramMessage: HTTP %d, resp len %u\n", code, (unsigned)resp.length());
-  http.end();
-  return (code == 200 || code == 201);
+  if (*STREAM_HOST) {
+    const TelemetryStream::Stats &st = stream.stats();
+    msg.printf("UDP %s:%u: %lu enviados, %lu perdidos\n", STREAM_HOST, (unsigned)STREAM_PORT,
+               (unsigned long)st.sent, (unsigned long)st.dropped);
+  }
+  sendTelegramMessage(msg.c_str());
 }
 
-void sendStatusTelegram(long toChatId = TELEGRAM_CHAT_ID) {
-  // Construye mensaje de estado
-  String msg;
-  msg += "📡 Telemetría - Estado\n";
-  msg += "IP: " + WiFi.localIP().toString() + "\n";
-  msg += "MAC: " + WiFi.macAddress() + "\n";
-  msg += "RSSI: " + String(WiFi.RSSI()) + " dBm\n";
-  msg += "Heap libre: " + String(ESP.getFreeHeap()) + " bytes\n";
-  msg += "Uptime: " + String(millis() / 1000) + " s\n";
-  msg += "Intervalo telem: " + String(telemIntervalMs / 1000) + " s\n";
-  msg += "Telem activa: " + String(telemEnabled ? "SI" : "NO") + "\n";
-  sendTelegramMessage(msg);
+// Copia un campo al estado persistente si cambió (un valor igual no cuenta
+// como cambio); se escribe en flash más tarde (state.service / flush)
+template <class V>
+void persistField(V TelemState::*field, V value) {
+  if (state.get().*field == value) return;
+  state.edit().*field = value;
 }
 
-void persistAll() {
-  // Guarda interval, lastTelemSent, lastUpdateId, enabled
-  prefs.putULong("interval", telemIntervalMs);
-  prefs.putULong("last_telem", lastTelemSent);
-  prefs.putLong("last_update", lastUpdateId);
-  prefs.putUInt("enabled", telemEnabled ? 1 : 0);
+// Cambios de configuración (los pide el usuario, son raros): a flash ya
+void persistNow() {
+  state.flush();
 }
 
-void handleCommand(const String &cmd, long from_id, const String &fromName) {
-  // Sólo ejecuta si viene del usuario permitido
-  if (from_id != TELEGRAM_CHAT_ID) {
-    Serial.printf("Comando recibido desde %ld. Ignorado (no autorizado).\n", from_id);
-    // opcional: avisar que no estás autorizado -> NO lo hacemos por privacidad
-    return;
-  }
+// esp_restart() llama a esto antes de reiniciar
+void flushStateOnRestart() {
+  state.flush();
+}
 
-  Serial.printf("handleCommand: '%s' from %ld (%s)\n", cmd.c_str(), from_id, fromName.c_str());
+// ---- comandos ----
 
-  if (cmd.startsWith("/status")) {
-    sendStatusTelegram();
-    return;
-  }
+void cmdStatus(const CommandContext &) {
+  sendStatusTelegram();
+}
 
-  if (cmd.startsWith("/help")) {
-    String h = "Comandos validos:\n";
-    h += "/status - estado ahora\n";
-    h += "/setinterval <segundos> - intervalo telemetria\n";
-    h += "/starttelemetry - arrancar envio periodico\n";
-    h += "/stoptelemetry - parar envio periodico\n";
-    h += "/help - mostrar esto\n";
-    sendTelegramMessage(h);
+void cmdSetInterval(const CommandContext &ctx) {
+  // formato: /setinterval 60
+  unsigned long secs;
+  if (!ctx.args.toULong(secs) || secs < 1) {
+    sendTelegramMessage("Uso: /setinterval <segundos> (>= 1 s)");
     return;
   }
+  telemIntervalMs = secs * 1000UL;
+  persistField(&TelemState::intervalMs, (uint32_t)telemIntervalMs);
+  persistNow();
+  TextBuffer<48> reply;
+  reply.printf("Intervalo actualizado a %lu s.", secs);
+  sendTelegramMessage(reply.c_str());
+}
 
-  if (cmd.startsWith("/setinterval")) {
-    // formato: /setinterval 60
-    int sp = cmd.indexOf(' ');
-    if (sp < 0) {
-      sendTelegramMessage("Uso: /setinterval <segundos>");
-      return;
-    }
-    String num = cmd.substring(sp + 1);
-    unsigned long secs = num.toInt();
-    if (secs < 1) {
-      sendTelegramMessage("Intervalo invalido. Debe ser >= 1 s.");
-      return;
-    }
-    telemIntervalMs = secs * 1000UL;
-    prefs.putULong("interval", telemIntervalMs);
-    sendTelegramMessage("Intervalo actualizado a " + String(secs) + " s.");
+void cmdSetBatch(const CommandContext &ctx) {
+  // formato: /setbatch 6
+  unsigned long n;
+  if (!ctx.args.toULong(n) || n < 1 || n > TELEM_LINES_PER_MSG) {
+    TextBuffer<64> reply;
+    reply.printf("Uso: /setbatch <1-%d>", TELEM_LINES_PER_MSG);
+    sendTelegramMessage(reply.c_str());
     return;
   }
+  telemBatch = (uint16_t)n;
+  persistField(&TelemState::batch, telemBatch);
+  persistNow();
+  TextBuffer<48> reply;
+  reply.printf("Lote actualizado a %u muestras.", (unsigned)telemBatch);
+  sendTelegramMessage(reply.c_str());
+}
 
-  if (cmd.startsWith("/starttelemetry")) {
-    telemEnabled = true;
-    prefs.putUInt("enabled", 1);
-    sendTelegramMessage("Telemetria ACTIVADA.");
-    return;
-  }
+void cmdStartTelemetry(const CommandContext &) {
+  telemEnabled = true;
+  persistField(&TelemState::enabled, (uint8_t)1);
+  persistNow();
+  sendTelegramMessage("Telemetria ACTIVADA.");
+}
 
-  if (cmd.startsWith("/stoptelemetry")) {
-    telemEnabled = false;
-    prefs.putUInt("enabled", 0);
-    sendTelegramMessage("Telemetria PARADA.");
-    return;
-  }
+void cmdStopTelemetry(const CommandContext &) {
+  telemEnabled = false;
+  persistField(&TelemState::enabled, (uint8_t)0);
+  persistNow();
+  sendTelegramMessage("Telemetria PARADA.");
+}
 
-  // si no reconoció
-  sendTelegramMessage("Comando desconocido. /help para ayuda.");
+// Ordenada por nombre (búsqueda binaria); /help sale de aquí
+constexpr Command COMMANDS[] = {
+  { "setbatch", cmdSetBatch, "<n>", "muestras por mensaje", CMD_OWNER, 0 },
+  { "setinterval", cmdSetInterval, "<segundos>", "intervalo telemetria", CMD_OWNER, 0 },
+  { "starttelemetry", cmdStartTelemetry, nullptr, "arrancar envio periodico", CMD_OWNER, 0 },
+  { "status", cmdStatus, nullptr, "estado ahora", CMD_OWNER, 3 },
+  { "stoptelemetry", cmdStopTelemetry, nullptr, "parar envio periodico", CMD_OWNER, 0 },
+};
+static_assert(commandsSorted(COMMANDS), "COMMANDS debe ir ordenada por nombre");
+CommandRouter<sizeof(COMMANDS) / sizeof(COMMANDS[0])> router(COMMANDS, sendTelegramMessage);
+
+// Procesa un update: sólo mensajes con remitente y texto, sólo de tu chat
+void handleUpdate(const TelegramUpdate &upd) {
+  if (!upd.hasMessage || upd.fromId == 0 || !upd.hasText) return;
+
+  // procesar comando (la respuesta va por la otra conexión)
+  if (router.dispatch(upd.text, upd.chatId, upd.fromId, upd.fromName) == router.IGNORED) {
+    Serial.printf("Update de %ld ignorado (no autorizado)\n", (long)upd.fromId);
+  } else {
+    Serial.printf("Comando '%s' de %ld (%s)\n", upd.text, (long)upd.fromId, upd.fromName);
+  }
 }
 
-// Llama a getUpdates y procesa sólo mensajes autorizados
+// Atiende el long-poll de getUpdates (o el webhook) y procesa sólo mensajes
+// autorizados. No bloquea: si todavía no ha llegado nada vuelve enseguida.
 void pollTelegramUpdates() {
-  // usa offset para no procesar updates antiguos
-  WiFiClientSecure client;
-  client.setInsecure();
-  HTTPClient http;
-  String url = String("https://api.telegram.org/bot") + TELEGRAM_BOT_TOKEN + "/getUpdates?timeout=0";
-  if (lastUpdateId != 0) {
-    url += "&offset=" + String(lastUpdateId + 1);
-  }
-  http.begin(client, url);
-  int code = http.GET();
-  if (code <= 0) {
-    // fallo de red
-    // Serial.printf("getUpdates fallo HTTP %d\n", code);
-    http.end();
-    return;
-  }
-  String payload = http.getString();
-  http.end();
-
-  // parsear JSON
-  StaticJsonDocument<6144> doc; // ajusta si necesitas más
-  DeserializationError err = deserializeJson(doc, payload);
-  if (err) {
-    Serial.print("deserializeJson fallo: ");
-    Serial.println(err.c_str());
+  if (WEBHOOK_PORT) {
+    if (!hook.service()) return;
+    lastUpdateId = (long)hook.update().updateId;
+    persistField(&TelemState::lastUpdate, (int32_t)lastUpdateId);
+    handleUpdate(hook.update());
     return;
   }
-  if (!doc.containsKey("ok") || !doc["ok"].as<bool>()) {
-    // respuesta no ok
-    // Serial.println("Telegram no ok");
-    return;
-  }
-  JsonArray results = doc["result"].as<JsonArray>();
-  for (JsonObject upd : results) {
-    long update_id = upd["update_id"].as<long>();
+  if (!poller.service()) return;
+  uint32_t allocMark = pollAllocs.begin();
+
+  // parsear la respuesta en streaming, update a update (memoria fija)
+  updParser.reset();
+  while (updParser.next(poller.transport())) {
+    if (!updParser.ok()) break; // respuesta no ok
+    const TelegramUpdate &upd = updParser.update();
+    long update_id = (long)upd.updateId;
     // guarda offset para no reprocesar
+    poller.ack(update_id);
     if (update_id > lastUpdateId) {
       lastUpdateId = update_id;
-      prefs.putLong("last_update", lastUpdateId);
+      persistField(&TelemState::lastUpdate, (int32_t)lastUpdateId); // sin escribir en flash por cada update
     }
+    handleUpdate(upd);
+  }
+  poller.done(); // lanza ya el siguiente long-poll
+  pollAllocs.end(allocMark);
+}
 
-    if (!upd.containsKey("message")) continue;
-    JsonObject message = upd["message"].as<JsonObject>();
-
-    // identifica remitente
-    if (!message.containsKey("from")) continue;
-    JsonObject from = message["from"].as<JsonObject>();
-    long from_id = from["id"].as<long>();
-    String fromName = "";
-    if (from.containsKey("username")) fromName = String(from["username"].as<const char*>());
-    else if (from.containsKey("first_name")) fromName = String(from["first_name"].as<const char*>());
-
-    // texto
-    if (!message.containsKey("text")) continue;
-    String text = String(message["text"].as<const char*>());
-
-    // sólo procesa si viene del tu chat id
-    if (from_id != TELEGRAM_CHAT_ID) {
-      Serial.printf("Update de %ld ignorado (no autorizado)\n", from_id);
-      continue;
-    }
+// Muestra el heap cada HEAP_CHECK_MS y avisa cuando salta un umbral
+void maybeCheckHeap() {
+  unsigned long now = millis();
+  if ((now - lastHeapCheck) < HEAP_CHECK_MS) return;
+  lastHeapCheck = now;
+  heapMon.sample();
+  uint8_t raised = heapMon.checkAlarms();
+  if (!raised) return;
+  TextBuffer<256> msg;
+  heapMon.printAlarms(msg, raised);
+  Serial.print(msg.c_str());
+  sendTelegramMessage(msg.c_str());
+}
 
-    // procesar comando
-    handleCommand(text, from_id, fromName);
-  }
+// Hora de la muestra: epoch si ya hay hora por NTP, si no segundos desde el arranque
+uint32_t sampleTime() {
+  time_t t = time(nullptr);
+  return t > 1600000000 ? (uint32_t)t : millis() / 1000;
 }
 
-void maybeSendTelemetry() {
+// Toma una muestra cada telemIntervalMs y la guarda en el registro (no envía)
+void maybeSampleTelemetry() {
   if (!telemEnabled) return;
   unsigned long now = millis();
   // cuidado overflow: usamos diferencias con unsigned long
   if ((now - lastTelemSent) < telemIntervalMs) return;
-  // construir telemetria
-  String msg;
-  msg += "📊 Telemetria periódica\n";
-  msg += "IP: " + WiFi.localIP().toString() + "\n";
-  msg += "MAC: " + WiFi.macAddress() + "\n";
-  msg += "RSSI: " + String(WiFi.RSSI()) + " dBm\n";
-  msg += "Heap libre: " + String(ESP.getFreeHeap()) + " bytes\n";
-  msg += "Uptime: " + String(now / 1000) + " s\n";
-  sendTelegramMessage(msg);
-
-  lastTelemSent = now;
-  prefs.putULong("last_telem", lastTelemSent);
+  const HeapMetrics::Sample &h = heapMon.sample();
+  TelemetrySample s;
+  s.t = sampleTime();
+  s.rssi = WiFi.status() == WL_CONNECTED ? (int8_t)WiFi.RSSI() : 0;
+  s.freeHeap = h.freeBytes;
+  s.largestBlock = h.largestBlock;
+
+  // lo que pasó desde la muestra anterior, si el muestreador está en marcha
+  WindowSampler::Summary w;
+  sampler.take(w);
+  s.windowN = (uint16_t)min(w.heap.n, (uint32_t)0xFFFF);
+  if (s.windowN) {
+    if (w.rssi.n) {
+      s.rssi = (int8_t)w.rssi.mean;
+      s.rssiMin = (int8_t)w.rssi.min;
+      s.rssiMax = (int8_t)w.rssi.max;
+      s.rssiP95 = (int8_t)w.rssi.p95;
+    } else {
+      s.rssiMin = s.rssiMax = s.rssiP95 = s.rssi;
+    }
+    s.freeHeap = w.heap.mean;
+    s.heapMin = w.heap.min;
+    s.heapMax = w.heap.max;
+    s.heapP95 = w.heap.p95;
+    s.loopMeanUs = w.loopUs.mean;
+    s.loopMaxUs = w.loopUs.max;
+    s.loopP95Us = w.loopUs.p95;
+  }
+  telemLog.push(s);
+
+  lastTelemSent = now;   // sólo en RAM: tras reiniciar se cuenta desde el arranque
+}
+
+// Registro por UDP cada STREAM_PERIOD_MS (no bloquea; sin red se descarta)
+void streamTelemetry() {
+  if (!stream.due() || WiFi.status() != WL_CONNECTED) return;
+  const HeapMetrics::Sample &h = heapMon.sample();
+  IPAddress ip = WiFi.localIP();
+  TelemetryStream::Record r;
+  r.uptimeMs = millis();
+  r.ip = ((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16) | ((uint32_t)ip[2] << 8) | ip[3];
+  r.rssi = (int8_t)WiFi.RSSI();
+  r.freeHeap = h.freeBytes;
+  r.minFreeHeap = h.minFreeBytes;
+  r.largestBlock = h.largestBlock;
+  r.fragPct = h.fragPct;
+  loopStats.take(r.loops, r.loopMaxUs);
+  stream.send(r);
+}
+
+// Página de /metrics: lo mismo que /status y los contadores de Telegram y NVS
+void renderMetrics(PromWriter &m) {
+  m.family("uptime_seconds", "gauge", "tiempo desde el arranque");
+  m.seconds("uptime_seconds", millis());
+  m.gauge("wifi_rssi_dbm", "RSSI del AP", WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0);
+  m.gauge("wifi_connect_ms", "duración de la última conexión WiFi", net.connectMs());
+  heapMon.sample();
+  heapMon.metricsTo(m);
+
+  TelegramOutbox::Stats o = outbox.stats();
+  m.family("telegram_messages_total", "counter", "mensajes salientes por resultado");
+  m.value("telegram_messages_total", o.sent, "result=\"sent\"");
+  m.value("telegram_messages_total", o.failed, "result=\"failed\"");
+  m.value("telegram_messages_total", o.dropped, "result=\"dropped\"");
+  m.counter("telegram_send_retries_total", "reintentos de envío", o.retries);
+  m.counter("telegram_rate_limited_total", "respuestas 429", o.rateLimited);
+  m.family("telegram_request_seconds", "summary", "duración de las peticiones de envío");
+  m.seconds("telegram_request_seconds_sum", o.requestMs);
+  m.value("telegram_request_seconds_count", o.requests);
+  m.family("telegram_request_last_seconds", "gauge", "duración de la última petición de envío");
+  m.seconds("telegram_request_last_seconds", o.lastRequestMs);
+  if (WEBHOOK_PORT) {
+    const TelegramWebhook::Stats &h = hook.stats();
+    m.counter("telegram_webhook_updates_total", "updates recibidos por webhook", h.updates);
+    m.counter("telegram_webhook_rejected_total", "peticiones rechazadas o a medias", h.rejected + h.timeouts);
+  } else {
+    m.counter("telegram_polls_total", "peticiones getUpdates", poller.polls());
+    m.counter("telegram_poll_errors_total", "getUpdates fallidos", poller.errors());
+    m.family("telegram_poll_last_wait_seconds", "gauge", "espera del último long-poll con respuesta");
+    m.seconds("telegram_poll_last_wait_seconds", poller.lastWaitMs());
+  }
+
+  m.counter("nvs_writes_total", "escrituras del estado en NVS", state.stats().writes);
+  m.counter("nvs_write_errors_total", "escrituras a NVS fallidas", state.stats().writeErrors);
+  m.gauge("telemetry_pending_samples", "muestras sin enviar por Telegram", telemLog.count());
+  m.counter("telemetry_lost_samples_total", "muestras perdidas por falta de sitio", telemLog.lost());
+  if (*STREAM_HOST) {
+    m.counter("telemetry_udp_records_total", "registros enviados por UDP", stream.stats().sent);
+    m.counter("telemetry_udp_dropped_total", "registros UDP descartados", stream.stats().dropped);
+  }
+}
+
+// Una línea del lote: hora, y media con mín..máx y p95 si hay ventana
+template <class Out>
+void printTelemetryLine(Out &msg, const TelemetrySample &s) {
+  if (s.t > 1600000000) {
+    time_t t = s.t;
+    struct tm tmv;
+    gmtime_r(&t, &tmv);
+    msg.printf("%02d/%02d %02d:%02d", tmv.tm_mday, tmv.tm_mon + 1, tmv.tm_hour, tmv.tm_min);
+  } else {
+    msg.printf("+%lus", (unsigned long)s.t);
+  }
+  if (!s.windowN) {
+    msg.printf(" %d dBm, heap %lu B, bloque %lu B\n", s.rssi, (unsigned long)s.freeHeap,
+               (unsigned long)s.largestBlock);
+    return;
+  }
+  msg.printf(" %d dBm (%d..%d p95 %d), heap %lu KB (%lu..%lu p95 %lu), bloque %lu KB", s.rssi, s.rssiMin,
+             s.rssiMax, s.rssiP95, (unsigned long)s.freeHeap / 1024, (unsigned long)s.heapMin / 1024,
+             (unsigned long)s.heapMax / 1024, (unsigned long)s.heapP95 / 1024, (unsigned long)s.largestBlock / 1024);
+  msg.printf(", loop %lu.%lu ms (máx %lu, p95 %lu.%lu)\n", (unsigned long)s.loopMeanUs / 1000,
+             (unsigned long)(s.loopMeanUs % 1000) / 100, (unsigned long)s.loopMaxUs / 1000,
+             (unsigned long)s.loopP95Us / 1000, (unsigned long)(s.loopP95Us % 1000) / 100);
+}
+
+// Envía lo acumulado por lotes, de la muestra más antigua a la más nueva.
+// Un lote sólo se quita del registro cuando la cola lo ha entregado; si no
+// hay red o el envío falla se reintenta después, en el mismo orden.
+void flushTelemetry() {
+  if (telemInFlight > 0) {
+    TelegramOutbox::Delivery d = outbox.delivery(telemTicket);
+    if (d == TelegramOutbox::QUEUED) return;   // todavía en la cola
+    // si el lote no llegó se repite
+    if (d == TelegramOutbox::DELIVERED) telemLog.drop(telemInFlight);
+    telemInFlight = 0;
+  }
+  if (telemLog.count() == 0 || telemLog.count() < telemBatch) return;
+  if (WiFi.status() != WL_CONNECTED || outbox.pending() > 0) return;
+
+  TelemetrySample batch[TELEM_LINES_PER_MSG];
+  size_t n = telemLog.peek(batch, TELEM_LINES_PER_MSG);
+  // las líneas con ventana son largas: van las que quepan en un mensaje
+  const size_t BODY_MAX = TelegramOutbox::TEXT_MAX - 48;   // deja sitio a la cabecera
+  TextBuffer<BODY_MAX> body;
+  size_t fit = 0;
+  for (; fit < n; ++fit) {
+    TextBuffer<192> line;
+    printTelemetryLine(line, batch[fit]);
+    if (body.length() + line.length() >= BODY_MAX) break;
+    body.print(line.c_str());
+  }
+  n = fit;
+  TextBuffer<TelegramOutbox::TEXT_MAX + 1> msg;
+  msg.printf("📊 Telemetría (%u muestras", (unsigned)n);
+  if (telemLog.count() > n) msg.printf(", quedan %u", (unsigned)(telemLog.count() - n));
+  msg.print(")\n");
+  msg.print(body.c_str());
+  telemTicket = outbox.sendTracked(TELEGRAM_CHAT_ID, msg.c_str());
+  if (telemTicket) telemInFlight = n;
+  else Serial.println("flushTelemetry: cola llena, se reintenta");
 }
 
 void setup() {
@@ -274,35 +467,87 @@ void setup() {
   Serial.println();
   Serial.println("=== Telemetria Telegram (ESP32) ===");
 
+  sharedDnsCache() = &dns;   // las conexiones a Telegram usan la caché DNS
+
   // Preferences namespace "telemetry"
+  outbox.allocs = &sendAllocs;
+  outbox.begin(TELEGRAM_BOT_TOKEN);
+  heapMon.watchTask("loop", xTaskGetCurrentTaskHandle());
+  heapMon.watchTask("tg_outbox", outbox.taskHandle());
+  sampler.periodMs = SAMPLE_PERIOD_MS;
+  if (sampler.begin(&loopStats)) heapMon.watchTask("sampler", sampler.taskHandle());
+  heapMon.watchAllocs("envío", &sendAllocs);
+  heapMon.watchAllocs("poll", &pollAllocs);
+  router.chatId = TELEGRAM_CHAT_ID;
+  router.ownerId = TELEGRAM_CHAT_ID;
+  router.title = "Comandos validos:";
+
   prefs.begin("telemetry", false);
-  telemIntervalMs = prefs.getULong("interval", DEFAULT_TELEM_INTERVAL_MS);
-  lastTelemSent = prefs.getULong("last_telem", 0);
-  lastUpdateId = prefs.getLong("last_update", 0);
-  telemEnabled = (prefs.getUInt("enabled", 1) == 1);
+  // valores por defecto: las claves sueltas de versiones anteriores, si existen
+  TelemState defaults;
+  defaults.intervalMs = prefs.getULong("interval", DEFAULT_TELEM_INTERVAL_MS);
+  defaults.lastTelem = 0;
+  defaults.lastUpdate = prefs.getLong("last_update", 0);
+  defaults.enabled = prefs.getUInt("enabled", 1) == 1 ? 1 : 0;
+  defaults.batch = DEFAULT_TELEM_BATCH;
+  state.begin(prefs, defaults);
+  esp_register_shutdown_handler(flushStateOnRestart);
+  telemIntervalMs = state.get().intervalMs;
+  lastUpdateId = state.get().lastUpdate;
+  telemEnabled = state.get().enabled == 1;
+  telemBatch = state.get().batch;
+  if (telemBatch < 1 || telemBatch > TELEM_LINES_PER_MSG) telemBatch = DEFAULT_TELEM_BATCH;
+  if (telemLog.begin()) Serial.printf("Telemetría pendiente de antes del reinicio: %u muestras\n", (unsigned)telemLog.count());
+
+  if (!WEBHOOK_PORT) poller.begin(TELEGRAM_BOT_TOKEN, LONG_POLL_TIMEOUT_S, 20, lastUpdateId != 0 ? lastUpdateId + 1 : 0);
 
   connectWiFi();
+  IPAddress collector;
+  if (*STREAM_HOST && collector.fromString(STREAM_HOST)) {
+    stream.periodMs = STREAM_PERIOD_MS;
+    stream.begin(collector, STREAM_PORT);
+  }
+  if (METRICS_PORT) metrics.begin(METRICS_PORT, renderMetrics);
+  if (WEBHOOK_PORT) {
+    hook.path = WEBHOOK_PATH;
+    hook.secret = WEBHOOK_SECRET;
+    hook.lastUpdateId = lastUpdateId;   // los reenvíos tras un reinicio no se repiten
+    if (!hook.begin(WEBHOOK_PORT)) Serial.println("Webhook desactivado: pon WEBHOOK_SECRET");
+  }
+  configTime(0, 0, "pool.ntp.org"); // hora UTC para fechar las muestras
 
   // mandar un mensaje de inicio (opcional)
-  sendTelegramMessage(String("Device arrancado. IP: ") + WiFi.localIP().toString());
+  TextBuffer<48> hello;
+  hello.print("Device arrancado. IP: ");
+  hello.printIp(WiFi.localIP());
+  sendTelegramMessage(hello.c_str());
 
   // enviar un status inicial
   sendStatusTelegram();
 }
 
 void loop() {
-  unsigned long now = millis();
+  loopStats.tick();   // vueltas y la más lenta (telemetría UDP y latencia del muestreador)
+  sampler.service();  // lecturas de fondo -> resumen del intervalo
 
-  // Poll Telegram periódicamente
-  if (now - lastPollMs >= POLL_PERIOD_MS) {
-    lastPollMs = now;
-    pollTelegramUpdates();
-  }
+  // Long-poll (o webhook) de Telegram: los comandos se atienden en cuanto llegan
+  pollTelegramUpdates();
+
+  // Telemetría periódica (Telegram por lotes; UDP cada STREAM_PERIOD_MS)
+  maybeSampleTelemetry();
+  flushTelemetry();
+  streamTelemetry();
+
+  // Heap y pilas: alarma si se cruza un umbral
+  maybeCheckHeap();
+
+  // /metrics: una petición como mucho por vuelta
+  if (METRICS_PORT) metrics.service();
 
-  // Telemetría periódica
-  maybeSendTelemetry();
+  // Estado persistente: escribe en flash si toca (tiempo o nº de cambios)
+  state.service();
 
-  // trabajo ligero
-  delay(200);
+  // trabajo ligero (pausa corta para no añadir latencia a los comandos)
+  delay(10);
 }
 
@@ -0,0 +1,146 @@
+// TextBuffer.h
+// Texto de capacidad fija para construir mensajes sin usar el heap, y
+// URL-encoding en streaming (con la longitud calculada antes, para poder
+// poner Content-Length sin construir el cuerpo en memoria).
+//
+//   TextBuffer<256> msg;
+//   msg.printf("RSSI: %d dBm\n", WiFi.RSSI());
+//   msg.printIp(WiFi.localIP());
+//   sendTelegramMessage(msg.c_str());
+//
+// Si el texto no cabe se corta (sin partir caracteres UTF-8) y truncated()
+// pasa a true.
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+template <size_t N>
+class TextBuffer : public Print {
+public:
+  TextBuffer() { clear(); }
+
+  void clear() {
+    _len = 0;
+    _buf[0] = '\0';
+    _truncated = false;
+  }
+
+  size_t write(uint8_t c) override {
+    if (_truncated) return 0;
+    if (_len + 1 >= N) {
+      overflow();
+      return 0;
+    }
+    _buf[_len++] = (char)c;
+    _buf[_len] = '\0';
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    if (_truncated) return 0;
+    size_t room = N - 1 - _len;
+    size_t n = size <= room ? size : room;
+    memcpy(_buf + _len, data, n);
+    _len += n;
+    _buf[_len] = '\0';
+    if (n < size) overflow();
+    return n;
+  }
+  using Print::write;
+
+  // Oculta Print::printf, que reserva memoria si el texto pasa de 64 bytes
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (_truncated) return 0;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(_buf + _len, N - _len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+      _buf[_len] = '\0';
+      return 0;
+    }
+    if ((size_t)n >= N - _len) {
+      _len = N - 1;
+      overflow();
+      return 0;
+    }
+    _len += n;
+    return n;
+  }
+
+  size_t printIp(const IPAddress &ip) {
+    return printf("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  }
+
+  size_t printMac(const uint8_t mac[6]) {
+    return printf("%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  }
+
+  const char *c_str() const { return _buf; }
+  size_t length() const { return _len; }
+  size_t capacity() const { return N - 1; }
+  bool truncated() const { return _truncated; }
+
+private:
+  char _buf[N];
+  size_t _len;
+  bool _truncated;
+
+  // Al cortar, quita una secuencia UTF-8 que haya quedado a medias
+  void overflow() {
+    _truncated = true;
+    size_t i = _len;
+    size_t back = 0;
+    while (i > 0 && back < 4 && (((uint8_t)_buf[i - 1]) & 0xC0) == 0x80) {
+      i--;
+      back++;
+    }
+    if (i > 0) {
+      uint8_t lead = (uint8_t)_buf[i - 1];
+      size_t need = (lead >= 0xF0) ? 3 : (lead >= 0xE0) ? 2 : (lead >= 0xC0) ? 1 : 0;
+      if (lead >= 0xC0 && back < need) _len = i - 1;
+    }
+    _buf[_len] = '\0';
+  }
+};
+
+// ---------------- URL-encoding (application/x-www-form-urlencoded) ----------------
+// Un único criterio para todos los sketches: se dejan tal cual los caracteres
+// no reservados de RFC 3986 y todo lo demás (espacio incluido) va como %XX.
+
+inline bool urlUnreserved(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+         c == '-' || c == '_' || c == '.' || c == '~';
+}
+
+// Longitud que tendrá el texto codificado (para Content-Length)
+inline size_t urlEncodedLength(const char *s, size_t len) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; ++i) n += urlUnreserved(s[i]) ? 1 : 3;
+  return n;
+}
+
+// Escribe el texto codificado en 'out' por bloques, con un buffer en la pila
+inline size_t urlEncodeTo(Print &out, const char *s, size_t len) {
+  static const char hex[] = "0123456789ABCDEF";
+  uint8_t buf[96];
+  size_t n = 0;
+  size_t written = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (n + 3 > sizeof(buf)) {
+      written += out.write(buf, n);
+      n = 0;
+    }
+    uint8_t c = (uint8_t)s[i];
+    if (urlUnreserved((char)c)) {
+      buf[n++] = c;
+    } else {
+      buf[n++] = '%';
+      buf[n++] = hex[c >> 4];
+      buf[n++] = hex[c & 0x0F];
+    }
+  }
+  if (n) written += out.write(buf, n);
+  return written;
+}
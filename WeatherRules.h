@@ -0,0 +1,196 @@
+// WeatherRules.h
+// Reglas de aviso del tiempo evaluadas en el dispositivo sobre la lectura
+// actual y la previsión guardada. Cada regla tiene estado (en RTC, por
+// ciudad) y sólo produce un aviso al cambiar: cuando empieza a cumplirse y,
+// si se quiere, cuando deja de cumplirse. Mientras nada cambia, no hay
+// mensajes aunque se consulte a menudo.
+//
+//   const WeatherRule REGLAS[] = {
+//     { RULE_TEMP_ABOVE, 300, 0, "calor", true },     // ahora >= 30,0 °C
+//     { RULE_RAIN, 60, 6, "lluvia", false },          // prob. >= 60 % en 6 h
+//   };
+//   WeatherRules rules(REGLAS);
+//   RTC_DATA_ATTR RuleState state[N_CIUDADES][WeatherRules::MAX_RULES];
+//   rules.evaluate("Madrid", now, fc.steps, fc.n, fc.tzOffset, state[i], msg);
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+// Un paso de la previsión (OpenWeather: cada 3 h)
+struct ForecastStep {
+  uint32_t dt;              // epoch UTC del inicio del paso
+  int16_t temp10;           // décimas de °C
+  uint8_t humidity;         // %
+  uint8_t pop;              // probabilidad de precipitación, %
+  uint16_t rain10;          // lluvia prevista en el paso, décimas de mm
+};
+
+// Lectura actual
+struct WeatherNow {
+  uint32_t dt;              // epoch UTC de la observación
+  int16_t temp10;
+  uint8_t humidity;
+};
+
+enum RuleKind : uint8_t {
+  RULE_TEMP_ABOVE,          // temperatura >= value (décimas de °C)
+  RULE_TEMP_BELOW,          // temperatura <= value (décimas de °C)
+  RULE_RAIN,                // algún paso con probabilidad >= value (%); hours 0 = el paso en curso
+  RULE_HUMIDITY_CHANGE      // humedad a value puntos o más del último aviso
+};
+
+struct WeatherRule {
+  RuleKind kind;
+  int16_t value;
+  uint8_t hours;            // 0 = lectura actual; N = previsión de las próximas N h
+  const char *label;        // nombre en el aviso
+  bool notifyClear;         // avisar también cuando deja de cumplirse
+};
+
+// Estado de una regla en una ciudad (cabe en RTC)
+struct RuleState {
+  uint8_t active;           // cumpliéndose (ya avisado)
+  uint8_t primed;           // hay referencia (humedad)
+  int16_t ref;              // humedad del último aviso
+};
+
+class WeatherRules {
+public:
+  enum { MAX_RULES = 8 };
+
+  // Margen para dar una regla por terminada: evita avisos en ráfaga cuando
+  // el valor baila justo en el umbral
+  int16_t tempHysteresis10 = 10;   // 1,0 °C
+  uint8_t rainHysteresis = 15;     // puntos de probabilidad
+
+  template <size_t N>
+  explicit WeatherRules(const WeatherRule (&rules)[N]) : _rules(rules), _n(N) {
+    static_assert(N <= MAX_RULES, "demasiadas reglas (MAX_RULES)");
+  }
+
+  size_t size() const { return _n; }
+
+  // Evalúa las reglas de una ciudad y escribe una línea por cada aviso.
+  // steps: previsión (puede ser nullptr/0: las reglas con horas no cambian).
+  // Devuelve el número de avisos escritos.
+  template <class Out>
+  uint8_t evaluate(const char *city, const WeatherNow &now, const ForecastStep *steps, uint8_t nSteps,
+                   int32_t tzOffset, RuleState *state, Out &out) const {
+    uint8_t fired = 0;
+    for (size_t r = 0; r < _n; ++r) {
+      const WeatherRule &rule = _rules[r];
+      RuleState &st = state[r];
+      if ((rule.hours || rule.kind == RULE_RAIN) && nSteps == 0) continue;   // sin previsión no se decide nada
+
+      switch (rule.kind) {
+        case RULE_TEMP_ABOVE:
+        case RULE_TEMP_BELOW: {
+          bool above = rule.kind == RULE_TEMP_ABOVE;
+          const ForecastStep *at = nullptr;
+          int16_t v = rule.hours ? extremeTemp(now, steps, nSteps, rule.hours, above, at) : now.temp10;
+          bool hit = above ? v >= rule.value : v <= rule.value;
+          bool gone = above ? v <= rule.value - tempHysteresis10 : v >= rule.value + tempHysteresis10;
+          if (!st.active && hit) {
+            st.active = 1;
+            out.printf("%s %s: %s, %.1f°C", above ? "🌡️" : "🥶", city, rule.label, v / 10.0);
+            if (at) printWhen(out, at->dt, tzOffset);
+            out.print("\n");
+            fired++;
+          } else if (st.active && gone) {
+            st.active = 0;
+            if (rule.notifyClear) {
+              out.printf("✅ %s: fin de %s (%.1f°C)\n", city, rule.label, v / 10.0);
+              fired++;
+            }
+          }
+          break;
+        }
+        case RULE_RAIN: {
+          const ForecastStep *at = firstRain(now, steps, nSteps, rule.hours ? rule.hours : 3, rule.value);
+          uint8_t peak = maxPop(now, steps, nSteps, rule.hours ? rule.hours : 3);
+          if (!st.active && at) {
+            st.active = 1;
+            out.printf("🌧️ %s: %s (%u%%", city, rule.label, (unsigned)at->pop);
+            if (at->rain10) out.printf(", %.1f mm", at->rain10 / 10.0);
+            out.print(")");
+            printWhen(out, at->dt, tzOffset);
+            out.print("\n");
+            fired++;
+          } else if (st.active && peak + rainHysteresis <= rule.value) {
+            st.active = 0;
+            if (rule.notifyClear) {
+              out.printf("✅ %s: fin de %s (máx. %u%% en %u h)\n", city, rule.label, (unsigned)peak,
+                         (unsigned)(rule.hours ? rule.hours : 3));
+              fired++;
+            }
+          }
+          break;
+        }
+        case RULE_HUMIDITY_CHANGE: {
+          if (!st.primed) {             // primera lectura: sólo referencia
+            st.primed = 1;
+            st.ref = now.humidity;
+            break;
+          }
+          int d = (int)now.humidity - st.ref;
+          if (abs(d) >= rule.value) {
+            out.printf("💧 %s: %s %d%% → %u%%\n", city, rule.label, (int)st.ref, (unsigned)now.humidity);
+            st.ref = now.humidity;
+            fired++;
+          }
+          break;
+        }
+      }
+    }
+    return fired;
+  }
+
+private:
+  const WeatherRule *_rules;
+  size_t _n;
+
+  // Pasos que caen en [ahora, ahora + horas): el que está en curso cuenta
+  static bool inWindow(const WeatherNow &now, const ForecastStep &s, uint8_t hours) {
+    return s.dt + 3 * 3600UL > now.dt && s.dt < now.dt + hours * 3600UL;
+  }
+
+  static int16_t extremeTemp(const WeatherNow &now, const ForecastStep *steps, uint8_t n, uint8_t hours,
+                             bool highest, const ForecastStep *&at) {
+    int16_t v = now.temp10;
+    at = nullptr;
+    for (uint8_t i = 0; i < n; ++i) {
+      if (!inWindow(now, steps[i], hours)) continue;
+      if (highest ? steps[i].temp10 > v : steps[i].temp10 < v) {
+        v = steps[i].temp10;
+        at = &steps[i];
+      }
+    }
+    return v;
+  }
+
+  static const ForecastStep *firstRain(const WeatherNow &now, const ForecastStep *steps, uint8_t n,
+                                       uint8_t hours, int16_t minPop) {
+    for (uint8_t i = 0; i < n; ++i) {
+      if (inWindow(now, steps[i], hours) && steps[i].pop >= minPop) return &steps[i];
+    }
+    return nullptr;
+  }
+
+  static uint8_t maxPop(const WeatherNow &now, const ForecastStep *steps, uint8_t n, uint8_t hours) {
+    uint8_t m = 0;
+    for (uint8_t i = 0; i < n; ++i) {
+      if (inWindow(now, steps[i], hours) && steps[i].pop > m) m = steps[i].pop;
+    }
+    return m;
+  }
+
+  // " hacia las HH:MM" en hora local de la ciudad
+  template <class Out>
+  static void printWhen(Out &out, uint32_t dt, int32_t tzOffset) {
+    time_t t = (time_t)((int64_t)dt + tzOffset);
+    struct tm tmv;
+    gmtime_r(&t, &tmv);
+    out.printf(" hacia las %02d:%02d", tmv.tm_hour, tmv.tm_min);
+  }
+};
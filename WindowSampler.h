@@ -0,0 +1,193 @@
+// WindowSampler.h
+// Muestreo de fondo a ritmo fijo (10 por segundo por defecto) de RSSI, heap
+// libre y latencia de loop(), resumido por ventanas: mín, máx, media y p95
+// de lo que pasó entre dos muestras de telemetría, no una lectura suelta.
+//
+//   - Una tarea propia lee los valores con vTaskDelayUntil y los deja en un
+//     anillo sin locks (un productor, un consumidor).
+//   - loop() vacía el anillo en los acumuladores con service().
+//   - Los acumuladores son histogramas de cubetas fijas: memoria constante
+//     y tiempo constante por muestra, sea cual sea el tamaño de la ventana.
+//
+// La latencia de loop() es el tiempo desde su última vuelta (LoopStats::
+// tick()) en el momento de cada lectura: cuánto esperaría algo que llegase
+// entonces.
+//
+//   WindowSampler sampler;
+//   sampler.begin(&loopStats);
+//   void loop() {
+//     loopStats.tick();
+//     sampler.service();
+//     ... cada intervalo: WindowSampler::Summary w; sampler.take(w); ...
+//   }
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "TelemetryStream.h"   // LoopStats
+
+// ---- resumen de una ventana con un histograma fijo ----
+
+struct WindowSummary {
+  uint32_t n;               // muestras (0 = ventana vacía, el resto no vale)
+  int32_t min;
+  int32_t max;
+  int32_t mean;
+  int32_t p95;              // con la resolución de una cubeta
+};
+
+// BUCKETS cubetas de 'width' desde 'lo'; lo que cae fuera va a la primera o
+// la última (el p95 nunca sale de [min, max], que son exactos)
+template <uint16_t BUCKETS>
+class WindowStats {
+public:
+  WindowStats(int32_t lo, int32_t width) : _lo(lo), _width(width) { reset(); }
+
+  void add(int32_t v) {
+    if (_n == 0 || v < _min) _min = v;
+    if (_n == 0 || v > _max) _max = v;
+    _sum += v;
+    _n++;
+    int32_t i = (v - _lo) / _width;
+    if (i < 0) i = 0;
+    if (i >= BUCKETS) i = BUCKETS - 1;
+    if (_count[i] < 0xFFFF) _count[i]++;
+  }
+
+  void summary(WindowSummary &s) const {
+    s.n = _n;
+    if (_n == 0) {
+      s.min = s.max = s.mean = s.p95 = 0;
+      return;
+    }
+    s.min = _min;
+    s.max = _max;
+    s.mean = (int32_t)(_sum / (int64_t)_n);
+    uint32_t rank = (_n * 95 + 99) / 100;     // ceil(0.95 n)
+    uint32_t acc = 0;
+    uint16_t i = 0;
+    for (; i < BUCKETS - 1; ++i) {
+      acc += _count[i];
+      if (acc >= rank) break;
+    }
+    int32_t top = _lo + (int32_t)(i + 1) * _width - 1;   // fin de la cubeta
+    s.p95 = top < _min ? _min : (top > _max ? _max : top);
+  }
+
+  void reset() {
+    memset(_count, 0, sizeof(_count));
+    _n = 0;
+    _sum = 0;
+    _min = _max = 0;
+  }
+
+private:
+  int32_t _lo;
+  int32_t _width;
+  uint16_t _count[BUCKETS];
+  uint32_t _n;
+  int64_t _sum;
+  int32_t _min;
+  int32_t _max;
+};
+
+// ---- muestreador ----
+
+class WindowSampler {
+public:
+  enum { RING = 128 };      // 12,8 s a 10 Hz sin que loop() lo vacíe
+
+  struct Summary {
+    WindowSummary rssi;     // dBm (sólo con WiFi conectado)
+    WindowSummary heap;     // bytes libres
+    WindowSummary loopUs;   // latencia de loop()
+    uint32_t overruns;      // lecturas perdidas con el anillo lleno
+  };
+
+  uint16_t periodMs = 100;
+
+  bool begin(const LoopStats *loop, UBaseType_t priority = 2, uint32_t stackBytes = 3072) {
+    _loop = loop;
+    return xTaskCreate(taskEntry, "sampler", stackBytes, this, priority, &_task) == pdPASS;
+  }
+
+  // Pasa lo que haya en el anillo a los acumuladores (desde loop())
+  void service() {
+    uint16_t tail = _tail;
+    uint16_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    while (tail != head) {
+      const Reading &r = _ring[tail];
+      if (r.rssi != 0) _rssi.add(r.rssi);
+      _heap.add((int32_t)r.freeHeap);
+      _loopUs.add((int32_t)r.loopUs);
+      tail = (tail + 1) % RING;
+    }
+    __atomic_store_n(&_tail, tail, __ATOMIC_RELEASE);
+  }
+
+  // Resumen desde la llamada anterior; empieza una ventana nueva
+  void take(Summary &s) {
+    service();
+    _rssi.summary(s.rssi);
+    _heap.summary(s.heap);
+    _loopUs.summary(s.loopUs);
+    uint32_t o = __atomic_load_n(&_overruns, __ATOMIC_RELAXED);
+    s.overruns = o - _overrunsMark;
+    _overrunsMark = o;
+    _rssi.reset();
+    _heap.reset();
+    _loopUs.reset();
+  }
+
+  TaskHandle_t taskHandle() const { return _task; }
+
+private:
+  struct Reading {
+    int8_t rssi;            // 0 = sin WiFi
+    uint32_t freeHeap;
+    uint32_t loopUs;
+  };
+
+  const LoopStats *_loop = nullptr;
+  TaskHandle_t _task = nullptr;
+
+  // anillo: _head sólo lo escribe la tarea, _tail sólo loop()
+  Reading _ring[RING];
+  uint16_t _head = 0;
+  uint16_t _tail = 0;
+  uint32_t _overruns = 0;
+  uint32_t _overrunsMark = 0;
+
+  WindowStats<101> _rssi{ -100, 1 };      // -100..0 dBm, de 1 en 1
+  WindowStats<384> _heap{ 0, 1024 };      // 0..384 KB, de KB en KB
+  WindowStats<250> _loopUs{ 0, 2000 };    // 0..500 ms, de 2 en 2 ms
+
+  static void taskEntry(void *arg) { ((WindowSampler *)arg)->run(); }
+
+  void run() {
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+      vTaskDelayUntil(&wake, pdMS_TO_TICKS(periodMs ? periodMs : 1));
+      Reading r;
+      r.rssi = WiFi.status() == WL_CONNECTED ? (int8_t)WiFi.RSSI() : 0;
+      r.freeHeap = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT);
+      uint32_t last = _loop ? _loop->lastTickUs() : 0;   // antes que micros(): nunca negativo
+      r.loopUs = last ? micros() - last : 0;
+      push(r);
+    }
+  }
+
+  void push(const Reading &r) {
+    uint16_t head = _head;
+    uint16_t next = (head + 1) % RING;
+    if (next == __atomic_load_n(&_tail, __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&_overruns, _overruns + 1, __ATOMIC_RELAXED);   // lleno: se pierde esta
+      return;
+    }
+    _ring[head] = r;
+    __atomic_store_n(&_head, next, __ATOMIC_RELEASE);
+  }
+};
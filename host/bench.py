@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Banco de pruebas: ejecuta los sketches (compilados con `make`) contra
+standin.py y muestra, por sketch:
+
+  - peticiones por hora, en total y por endpoint;
+  - bytes en la red (HTTP, sin TLS) por hora y por petición;
+  - latencia de comando a respuesta (desde que el mensaje está disponible
+    en getUpdates hasta que llega el sendMessage que lo contesta);
+  - heap: pico y libre mínimo sobre HOST_HEAP_BYTES; pila libre mínima de
+    cada tarea.
+
+Los sketches con loop() corren --seconds segundos reales; el del tiempo
+hace --cycles ciclos de deep sleep (el sueño no se espera, se suma), así
+que sus tasas son por hora simulada.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+from standin import StandIn
+
+
+def run_sketch(binary, env_extra, script, limit_s, log_path):
+    """Lanza el sketch y ejecuta script() en paralelo; devuelve el informe JSON."""
+    work = tempfile.mkdtemp(prefix="host-bench-")
+    report = os.path.join(work, "report.json")
+    env = dict(os.environ)
+    env.update({
+        "HOST_NVS_DIR": work,
+        "HOST_STATE": os.path.join(work, "state.bin"),
+        "HOST_REPORT": report,
+    })
+    env.update({k: str(v) for k, v in env_extra.items()})
+    with open(log_path, "w") as log:
+        proc = subprocess.Popen([os.path.abspath(binary)], cwd=work, env=env, stdout=log, stderr=subprocess.STDOUT)
+        done = threading.Event()
+        t = threading.Thread(target=lambda: (script(done), None), daemon=True)
+        t.start()
+        try:
+            proc.wait(timeout=limit_s)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+            raise SystemExit("%s no terminó en %d s (ver %s)" % (binary, limit_s, log_path))
+        done.set()
+    if proc.returncode != 0 or not os.path.exists(report):
+        raise SystemExit("%s terminó con código %d (ver %s)" % (binary, proc.returncode, log_path))
+    with open(report) as f:
+        return json.load(f)
+
+
+def commands(standin, plan):
+    """plan: [(segundo, texto, prefijo de la respuesta)]"""
+    def script(done):
+        t0 = time.monotonic()
+        for at, text, prefix in plan:
+            if done.wait(max(0, at - (time.monotonic() - t0))):
+                return
+            standin.inject(text, prefix)
+    return script
+
+
+def kb(n):
+    return "%.1f KB" % (n / 1024.0)
+
+
+def summarize(name, desc, device, server, hours):
+    eps = server["endpoints"]
+    total_req = sum(e["requests"] for e in eps.values())
+    total_in = sum(e["bytes_in"] for e in eps.values())
+    total_out = sum(e["bytes_out"] for e in eps.values())
+    print("== %s (%s) ==" % (name, desc))
+    per_ep = ", ".join("%s %.0f" % (k, e["requests"] / hours) for k, e in eps.items())
+    print("  peticiones/hora    %.0f  (%s)" % (total_req / hours, per_ep or "ninguna"))
+    if total_req:
+        print("  bytes/hora         enviados %s, recibidos %s  (por petición: %d / %d B)" %
+              (kb(total_in / hours), kb(total_out / hours), total_in // total_req, total_out // total_req))
+    print("  TCP del sketch     %d conexiones (%d fallidas), %s enviados, %s recibidos" %
+          (device["tcp_connects"], device["tcp_connect_failures"], kb(device["tcp_bytes_out"]),
+           kb(device["tcp_bytes_in"])))
+    lat = server["latencies_ms"]
+    if lat:
+        lat_sorted = sorted(lat)
+        print("  latencia comando   n=%d  mín %.0f ms  media %.0f ms  p95 %.0f ms  máx %.0f ms%s" %
+              (len(lat), lat_sorted[0], sum(lat) / len(lat), lat_sorted[int(0.95 * (len(lat) - 1))], lat_sorted[-1],
+               "  (%d sin respuesta)" % server["unanswered"] if server["unanswered"] else ""))
+    elif server["unanswered"]:
+        print("  latencia comando   %d comandos sin respuesta" % server["unanswered"])
+    print("  heap               pico %s de %s (libre mín %s)" %
+          (kb(device["heap_peak"]), kb(device["heap_size"]), kb(device["heap_size"] - device["heap_peak"])))
+    print("  pila libre mín     " + ", ".join("%s %d/%d B" % (t["name"], t["min_free"], t["stack"])
+                                              for t in device["tasks"]))
+    print()
+    return {
+        "hours": hours, "requests_per_hour": total_req / hours, "bytes_in_per_hour": total_in / hours,
+        "bytes_out_per_hour": total_out / hours, "server": server, "device": device,
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Métricas de los sketches contra el servidor de pruebas")
+    ap.add_argument("--port", type=int, default=8081)
+    ap.add_argument("--build", default="build")
+    ap.add_argument("--seconds", type=int, default=90, help="duración de los sketches con loop()")
+    ap.add_argument("--cycles", type=int, default=96, help="despertares del sketch del tiempo (96 = 1 día)")
+    ap.add_argument("--only", choices=["telemetria", "escaner", "tiempo"], action="append")
+    ap.add_argument("--json", help="guarda aquí todas las métricas")
+    args = ap.parse_args()
+
+    results = {}
+    logs = tempfile.mkdtemp(prefix="host-logs-")
+    wanted = args.only or ["telemetria", "escaner", "tiempo"]
+    secs = args.seconds
+
+    for name in wanted:
+        binary = os.path.join(args.build, name)
+        standin = StandIn(args.port).start()
+        log = os.path.join(logs, name + ".log")
+        try:
+            if name == "telemetria":
+                plan = [(at, "/status", "📡 Telemetría - Estado") for at in range(5, secs - 2, 10)]
+                desc = "%d s, /status cada 10 s" % secs
+                device = run_sketch(binary, {"HOST_RUN_MS": secs * 1000}, commands(standin, plan), secs + 30, log)
+                hours = device["awake_ms"] / 3600000.0
+            elif name == "escaner":
+                plan = [(at, "/estado", "Estado") for at in range(5, secs - 2, 10)]
+                desc = "%d s, /estado cada 10 s" % secs
+                if secs >= 75:   # el escáner no deja escanear en el primer minuto
+                    plan.append((65, "/escanear", "Escaneo ICMP"))
+                    plan.sort()
+                    desc += " y /escanear a los 65 s"
+                device = run_sketch(binary, {"HOST_RUN_MS": secs * 1000}, commands(standin, plan), secs + 30, log)
+                hours = device["awake_ms"] / 3600000.0
+            else:
+                desc = "%d ciclos de deep sleep" % args.cycles
+                # HOST_RUN_MS: límite por arranque por si un ciclo se queda colgado
+                device = run_sketch(binary, {"HOST_CYCLES": args.cycles, "HOST_RUN_MS": 120000},
+                                    lambda done: None, 60 + args.cycles * 30, log)
+                hours = (device["awake_ms"] + device["slept_ms"]) / 3600000.0
+        finally:
+            server = standin.report()
+            standin.stop()
+        results[name] = summarize(name, desc, device, server, hours)
+
+    print("Salida de los sketches en %s" % logs)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2, ensure_ascii=False)
+
+
+if __name__ == "__main__":
+    main()
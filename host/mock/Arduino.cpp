@@ -0,0 +1,494 @@
+// Arduino.cpp (host)
+// Núcleo del mock y main(): setup()/loop() corren en la tarea "loopTask"
+// (8 KB, como en el core) y el proceso hace de chip:
+//   - deep sleep: se guarda la memoria RTC (RTC_DATA_ATTR y RTC_NOINIT_ATTR)
+//     y el programa se vuelve a lanzar (execv) con ella, así que todo lo
+//     demás empieza de cero como en el ESP32; el tiempo dormido no se espera,
+//     sólo se apunta;
+//   - esp_restart(): igual, pero sólo se conserva RTC_NOINIT_ATTR.
+// Variables de entorno:
+//   HOST_RUN_MS    tiempo de funcionamiento antes de terminar (0 = sin límite)
+//   HOST_CYCLES    arranques antes de terminar al ir a dormir (por defecto 1)
+//   HOST_STATE     fichero de la memoria RTC entre arranques (host-state.bin)
+//   HOST_REPORT    fichero JSON con las métricas al terminar (opcional)
+// Las de los demás ficheros: HOST_HEAP_BYTES, HOST_STACK_SCALE, HOST_IP,
+// HOST_MASK, HOST_GATEWAY, HOST_WIFI_MS, HOST_NVS_DIR.
+#include <Arduino.h>
+#include <sys/random.h>
+#include <sched.h>
+#include <unistd.h>
+#include "esp_heap_caps.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "lwip/sockets.h"
+#include "HostRuntime.h"
+
+void setup();
+void loop();
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// secciones de la memoria RTC (las crea el enlazador si el sketch las usa)
+extern char __start_rtc_data[] __attribute__((weak));
+extern char __stop_rtc_data[] __attribute__((weak));
+extern char __start_rtc_noinit[] __attribute__((weak));
+extern char __stop_rtc_noinit[] __attribute__((weak));
+
+namespace {
+
+// Contabilidad entre arranques (va en el mismo fichero que la RTC, pero no
+// es memoria del chip)
+struct Boots {
+  uint32_t magic;
+  uint32_t boots;             // arranques terminados
+  uint32_t sleeps;
+  uint32_t restarts;
+  uint64_t awakeMs;
+  uint64_t sleptMs;
+  uint64_t heapPeak;          // máximo de todos los arranques
+  uint64_t bytesOut;
+  uint64_t bytesIn;
+  uint32_t connects;
+  uint32_t connectFailures;
+  uint32_t rtcDataLen;
+  uint32_t rtcNoinitLen;
+  uint32_t nTasks;
+  struct {
+    char name[16];
+    uint32_t stackBytes;
+    uint32_t minFree;         // mínimo de todos los arranques
+  } tasks[16];
+};
+const uint32_t BOOTS_MAGIC = 0x484F5354;   // "HOST"
+
+Boots boots = {};
+char **hostArgv = nullptr;
+bool wokeFromSleep = false;
+uint64_t sleepUs = 0;
+const int MAX_SHUTDOWN_HANDLERS = 4;
+shutdown_handler_t shutdownHandlers[MAX_SHUTDOWN_HANDLERS];
+struct timespec startTime;
+
+unsigned long envULong(const char *name, unsigned long def) {
+  const char *s = getenv(name);
+  return s && *s ? strtoul(s, nullptr, 10) : def;
+}
+
+const char *statePath() {
+  const char *s = getenv("HOST_STATE");
+  return s && *s ? s : "host-state.bin";
+}
+
+size_t sectionLen(const char *start, const char *stop) {
+  return start && stop ? (size_t)(stop - start) : 0;
+}
+
+// Restaura lo que sobrevive al tipo de arranque ("sleep" o "restart")
+void loadState(const char *wake) {
+  if (!wake) return;   // arranque en frío: todo empieza de cero
+  FILE *f = fopen(statePath(), "rb");
+  if (!f) return;
+  Boots b;
+  if (fread(&b, sizeof(b), 1, f) == 1 && b.magic == BOOTS_MAGIC) {
+    boots = b;
+    wokeFromSleep = strcmp(wake, "sleep") == 0;
+    size_t dataLen = sectionLen(__start_rtc_data, __stop_rtc_data);
+    size_t noinitLen = sectionLen(__start_rtc_noinit, __stop_rtc_noinit);
+    char *data = (char *)malloc(b.rtcDataLen + b.rtcNoinitLen + 1);
+    if (data && fread(data, 1, b.rtcDataLen + b.rtcNoinitLen, f) == b.rtcDataLen + b.rtcNoinitLen) {
+      if (wokeFromSleep && b.rtcDataLen == dataLen) memcpy(__start_rtc_data, data, dataLen);
+      if (b.rtcNoinitLen == noinitLen) memcpy(__start_rtc_noinit, data + b.rtcDataLen, noinitLen);
+    }
+    free(data);
+  }
+  fclose(f);
+}
+
+void mergeTask(const char *name, uint32_t stackBytes, uint32_t minFree) {
+  uint32_t i = 0;
+  while (i < boots.nTasks && strcmp(boots.tasks[i].name, name) != 0) ++i;
+  if (i == boots.nTasks) {
+    if (i == sizeof(boots.tasks) / sizeof(boots.tasks[0])) return;
+    boots.nTasks++;
+    strlcpy(boots.tasks[i].name, name, sizeof(boots.tasks[i].name));
+    boots.tasks[i].minFree = minFree;
+  }
+  boots.tasks[i].stackBytes = stackBytes;
+  if (minFree < boots.tasks[i].minFree) boots.tasks[i].minFree = minFree;
+}
+
+// Cierra la cuenta de este arranque
+void endBoot() {
+  HostHeap h = hostHeap();
+  HostNet n = hostNet();
+  boots.magic = BOOTS_MAGIC;
+  boots.boots++;
+  boots.awakeMs += millis();
+  if (h.peak > boots.heapPeak) boots.heapPeak = h.peak;
+  boots.bytesOut += n.bytesOut;
+  boots.bytesIn += n.bytesIn;
+  boots.connects += n.connects;
+  boots.connectFailures += n.connectFailures;
+  hostEachTask(mergeTask);
+}
+
+void saveState() {
+  boots.rtcDataLen = (uint32_t)sectionLen(__start_rtc_data, __stop_rtc_data);
+  boots.rtcNoinitLen = (uint32_t)sectionLen(__start_rtc_noinit, __stop_rtc_noinit);
+  FILE *f = fopen(statePath(), "wb");
+  if (!f) {
+    fprintf(stderr, "[host] no se puede escribir %s\n", statePath());
+    _exit(1);
+  }
+  fwrite(&boots, sizeof(boots), 1, f);
+  if (boots.rtcDataLen) fwrite(__start_rtc_data, 1, boots.rtcDataLen, f);
+  if (boots.rtcNoinitLen) fwrite(__start_rtc_noinit, 1, boots.rtcNoinitLen, f);
+  fclose(f);
+}
+
+// Fin de la simulación: métricas y salida sin destructores (hay hilos vivos)
+__attribute__((noreturn)) void finish() {
+  endBoot();
+  fflush(stdout);
+  HostHeap h = hostHeap();
+  fprintf(stderr, "[host] %u arranques, %llu ms despierto, %llu ms dormido; heap máx %llu de %u B;"
+                  " TCP %u conexiones, %llu B enviados, %llu B recibidos; pila libre mín:",
+          (unsigned)boots.boots, (unsigned long long)boots.awakeMs, (unsigned long long)boots.sleptMs,
+          (unsigned long long)boots.heapPeak, (unsigned)h.size, (unsigned)boots.connects,
+          (unsigned long long)boots.bytesOut, (unsigned long long)boots.bytesIn);
+  for (uint32_t i = 0; i < boots.nTasks; ++i) {
+    fprintf(stderr, " %s %u/%u B", boots.tasks[i].name, (unsigned)boots.tasks[i].minFree,
+            (unsigned)boots.tasks[i].stackBytes);
+  }
+  fprintf(stderr, "\n");
+  FILE *reportFile;
+  const char *path = getenv("HOST_REPORT");
+  if (path && *path && (reportFile = fopen(path, "w"))) {
+    fprintf(reportFile,
+            "{\n  \"boots\": %u,\n  \"sleeps\": %u,\n  \"restarts\": %u,\n  \"awake_ms\": %llu,\n"
+            "  \"slept_ms\": %llu,\n  \"heap_size\": %u,\n  \"heap_peak\": %llu,\n  \"tcp_connects\": %u,\n"
+            "  \"tcp_connect_failures\": %u,\n  \"tcp_bytes_out\": %llu,\n  \"tcp_bytes_in\": %llu,\n"
+            "  \"tasks\": [",
+            (unsigned)boots.boots, (unsigned)boots.sleeps, (unsigned)boots.restarts,
+            (unsigned long long)boots.awakeMs, (unsigned long long)boots.sleptMs, (unsigned)h.size,
+            (unsigned long long)boots.heapPeak, (unsigned)boots.connects, (unsigned)boots.connectFailures,
+            (unsigned long long)boots.bytesOut, (unsigned long long)boots.bytesIn);
+    for (uint32_t i = 0; i < boots.nTasks; ++i) {
+      fprintf(reportFile, "%s\n    {\"name\": \"%s\", \"stack\": %u, \"min_free\": %u}", i ? "," : "",
+              boots.tasks[i].name, (unsigned)boots.tasks[i].stackBytes, (unsigned)boots.tasks[i].minFree);
+    }
+    fprintf(reportFile, "\n  ]\n}\n");
+    fclose(reportFile);
+  }
+  _exit(0);
+}
+
+// Vuelve a lanzar el programa como si el chip arrancara otra vez
+__attribute__((noreturn)) void reboot(const char *wake) {
+  saveState();
+  fflush(stdout);
+  fflush(stderr);
+  setenv("HOST_WAKE", wake, 1);
+  execv("/proc/self/exe", hostArgv);
+  fprintf(stderr, "[host] execv: %s\n", strerror(errno));
+  _exit(1);
+}
+
+void loopTask(void *) {
+  setup();
+  for (;;) loop();
+}
+
+}  // namespace
+
+// ---- tiempo ----
+
+unsigned long millis() {
+  return (unsigned long)(micros() / 1000UL);
+}
+
+unsigned long micros() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (unsigned long)((t.tv_sec - startTime.tv_sec) * 1000000LL + (t.tv_nsec - startTime.tv_nsec) / 1000);
+}
+
+void delay(unsigned long ms) {
+  struct timespec t = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+  while (nanosleep(&t, &t) < 0 && errno == EINTR) {}
+}
+
+void yield() {
+  sched_yield();
+}
+
+uint32_t esp_random(void) {
+  uint32_t v = 0;
+  if (getrandom(&v, sizeof(v), 0) != sizeof(v)) v = (uint32_t)rand();
+  return v;
+}
+
+void configTime(long, int, const char *, const char *, const char *) {
+  // el reloj del host ya está en hora
+}
+
+#if !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+extern "C" size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t n = strlen(src);
+  if (size) {
+    size_t k = n < size - 1 ? n : size - 1;
+    memcpy(dst, src, k);
+    dst[k] = '\0';
+  }
+  return n;
+}
+#endif
+
+bool IPAddress::fromString(const char *s) {
+  struct in_addr a;
+  if (!s || inet_pton(AF_INET, s, &a) != 1) return false;
+  memcpy(_b, &a.s_addr, 4);
+  return true;
+}
+
+// ---- Print ----
+
+size_t Print::print(long v, int base) {
+  if (base == 10) return printf("%ld", v);
+  if (v < 0) return print('-') + print((unsigned long)-v, base);
+  return print((unsigned long)v, base);
+}
+
+size_t Print::print(unsigned long v, int base) {
+  if (base == 16) return printf("%lX", v);
+  if (base == 8) return printf("%lo", v);
+  if (base != 2) return printf("%lu", v);
+  char buf[65];
+  int i = 64;
+  buf[i] = '\0';
+  do {
+    buf[--i] = (char)('0' + (v & 1));
+    v >>= 1;
+  } while (v);
+  return print(buf + i);
+}
+
+size_t Print::print(double v, int decimals) {
+  return printf("%.*f", decimals, v);
+}
+
+size_t Print::printf(const char *fmt, ...) {
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  if ((size_t)n < sizeof(buf)) return write((const uint8_t *)buf, n);
+  char *big = (char *)malloc(n + 1);   // como el core: sólo si no cabe
+  if (!big) return 0;
+  va_start(ap, fmt);
+  vsnprintf(big, n + 1, fmt, ap);
+  va_end(ap);
+  size_t k = write((const uint8_t *)big, n);
+  free(big);
+  return k;
+}
+
+// ---- Stream ----
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) return c;
+    usleep(100);
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+int Stream::timedPeek() {
+  unsigned long start = millis();
+  do {
+    int c = peek();
+    if (c >= 0) return c;
+    usleep(100);
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+bool Stream::find(const char *target) {
+  return findUntil(target, nullptr);
+}
+
+bool Stream::findUntil(const char *target, const char *terminator) {
+  size_t t = 0, k = 0;
+  size_t tlen = strlen(target), klen = terminator ? strlen(terminator) : 0;
+  if (tlen == 0) return true;
+  int c;
+  while ((c = timedRead()) >= 0) {
+    if (c == target[t]) {
+      if (++t == tlen) return true;
+    } else {
+      t = c == target[0] ? 1 : 0;
+    }
+    if (klen) {
+      if (c == terminator[k]) {
+        if (++k == klen) return false;
+      } else {
+        k = c == terminator[0] ? 1 : 0;
+      }
+    }
+  }
+  return false;
+}
+
+size_t Stream::readBytes(char *buf, size_t n) {
+  size_t k = 0;
+  while (k < n) {
+    int c = timedRead();
+    if (c < 0) break;
+    buf[k++] = (char)c;
+  }
+  return k;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buf, size_t n) {
+  size_t k = 0;
+  while (k < n) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) break;
+    buf[k++] = (char)c;
+  }
+  return k;
+}
+
+long Stream::parseInt() {
+  int c;
+  while ((c = timedPeek()) >= 0 && c != '-' && !isdigit(c)) read();
+  if (c < 0) return 0;
+  bool neg = false;
+  long v = 0;
+  if (c == '-') {
+    neg = true;
+    read();
+  }
+  while ((c = timedPeek()) >= 0 && isdigit(c)) {
+    v = v * 10 + (c - '0');
+    read();
+  }
+  return neg ? -v : v;
+}
+
+String Stream::readString() {
+  std::string s;
+  int c;
+  while ((c = timedRead()) >= 0) s += (char)c;
+  return String(s);
+}
+
+// ---- heap (ver Heap.cpp) ----
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t) {
+  HostHeap h = hostHeap();
+  size_t freeBytes = h.used < h.size ? h.size - h.used : 0;
+  info->total_free_bytes = freeBytes;
+  info->total_allocated_bytes = h.used;
+  info->largest_free_block = freeBytes;
+  info->minimum_free_bytes = h.peak < h.size ? h.size - h.peak : 0;
+  info->allocated_blocks = h.blocks;
+  info->free_blocks = 1;
+  info->total_blocks = h.blocks + 1;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  multi_heap_info_t i;
+  heap_caps_get_info(&i, caps);
+  return i.total_free_bytes;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  multi_heap_info_t i;
+  heap_caps_get_info(&i, caps);
+  return i.minimum_free_bytes;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  multi_heap_info_t i;
+  heap_caps_get_info(&i, caps);
+  return i.largest_free_block;
+}
+
+size_t heap_caps_get_total_size(uint32_t) {
+  return hostHeap().size;
+}
+
+uint32_t EspClass::getHeapSize() { return (uint32_t)heap_caps_get_total_size(MALLOC_CAP_8BIT); }
+uint32_t EspClass::getFreeHeap() { return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT); }
+uint32_t EspClass::getMinFreeHeap() { return (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT); }
+uint32_t EspClass::getMaxAllocHeap() { return (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT); }
+void EspClass::restart() { esp_restart(); }
+
+// ---- sueño y reinicio ----
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) {
+  return wokeFromSleep ? ESP_SLEEP_WAKEUP_TIMER : ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs) {
+  sleepUs = timeUs;
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start(void) {
+  boots.sleeps++;
+  boots.sleptMs += sleepUs / 1000;
+  if (boots.boots + 1 >= envULong("HOST_CYCLES", 1)) finish();   // el último sueño cuenta para el periodo
+  endBoot();
+  reboot("sleep");
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+  for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; ++i) {
+    if (!shutdownHandlers[i]) {
+      shutdownHandlers[i] = handler;
+      return ESP_OK;
+    }
+  }
+  return -1;
+}
+
+void esp_restart(void) {
+  for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; ++i) {
+    if (shutdownHandlers[i]) shutdownHandlers[i]();
+  }
+  endBoot();
+  boots.restarts++;
+  reboot("restart");
+}
+
+// ---- main ----
+
+int main(int argc, char **argv) {
+  (void)argc;
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+  hostArgv = argv;
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  const char *wake = getenv("HOST_WAKE");
+  loadState(wake);
+  unsetenv("HOST_WAKE");
+  if (!wake) remove(statePath());
+
+  hostHeapBaseline();
+  if (!hostTaskCreate(loopTask, "loopTask", 8192, nullptr)) {
+    fprintf(stderr, "[host] no se pudo crear loopTask\n");
+    return 1;
+  }
+  unsigned long runMs = envULong("HOST_RUN_MS", 0);
+  if (!runMs) {
+    for (;;) pause();
+  }
+  delay(runMs);
+  finish();
+}
@@ -0,0 +1,206 @@
+// Arduino.h (host)
+// Núcleo de Arduino-ESP32 para compilar los sketches en Linux: tiempo,
+// Serial (a stdout), Print/Stream, String, IPAddress y ESP. Sólo lo que usan
+// los sketches de este repo; el comportamiento imita al del core 2.x.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <algorithm>
+
+// como el core de ESP32: min/max de std, no macros
+using std::max;
+using std::min;
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+#define IRAM_ATTR
+// Memoria RTC: secciones propias que el host guarda al dormir y restaura al
+// despertar (ver esp_deep_sleep_start en Arduino.cpp)
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))
+
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+uint32_t esp_random(void);
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char *server1,
+                const char *server2 = nullptr, const char *server3 = nullptr);
+
+#if !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+extern "C" size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+inline bool isDigit(char c) { return isdigit((unsigned char)c); }
+
+// ---- String (lo justo; los sketches usan TextBuffer) ----
+
+class String {
+public:
+  String() {}
+  String(const char *c) { if (c) _s = c; }
+  String(const std::string &s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(long long v) : _s(std::to_string(v)) {}
+  String(unsigned long long v) : _s(std::to_string(v)) {}
+  String(double v, int decimals = 2) {
+    char b[48];
+    snprintf(b, sizeof(b), "%.*f", decimals, v);
+    _s = b;
+  }
+
+  const char *c_str() const { return _s.c_str(); }
+  size_t length() const { return _s.size(); }
+  bool reserve(size_t n) { _s.reserve(n); return true; }
+  char operator[](size_t i) const { return _s[i]; }
+  char &operator[](size_t i) { return _s[i]; }
+  String &operator+=(const String &o) { _s += o._s; return *this; }
+  String &operator+=(const char *o) { _s += o; return *this; }
+  String &operator+=(char c) { _s += c; return *this; }
+  bool operator==(const String &o) const { return _s == o._s; }
+  bool operator==(const char *o) const { return _s == o; }
+  bool operator!=(const char *o) const { return _s != o; }
+  int indexOf(char c, unsigned from = 0) const { return pos(_s.find(c, from)); }
+  int indexOf(const char *x, unsigned from = 0) const { return pos(_s.find(x, from)); }
+  String substring(unsigned a, unsigned b = ~0u) const {
+    if (a > _s.size()) return String();
+    return String(_s.substr(a, b == ~0u ? std::string::npos : b - a));
+  }
+  bool startsWith(const char *p) const { return _s.rfind(p, 0) == 0; }
+  long toInt() const { return atol(_s.c_str()); }
+  void toLowerCase() { for (auto &c : _s) c = (char)tolower((unsigned char)c); }
+  void trim() {
+    size_t a = _s.find_first_not_of(" \t\r\n"), b = _s.find_last_not_of(" \t\r\n");
+    _s = a == std::string::npos ? std::string() : _s.substr(a, b - a + 1);
+  }
+
+private:
+  std::string _s;
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+};
+
+inline String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+inline String operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+
+// ---- IPAddress (bytes en orden de red, como en el core) ----
+
+class IPAddress {
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { _b[0] = a; _b[1] = b; _b[2] = c; _b[3] = d; }
+  IPAddress(uint32_t v) { memcpy(_b, &v, 4); }
+  operator uint32_t() const { uint32_t v; memcpy(&v, _b, 4); return v; }
+  uint8_t operator[](int i) const { return _b[i]; }
+  uint8_t &operator[](int i) { return _b[i]; }
+  bool operator==(const IPAddress &o) const { return memcmp(_b, o._b, 4) == 0; }
+  bool operator!=(const IPAddress &o) const { return !(*this == o); }
+  bool fromString(const char *s);
+  String toString() const {
+    char t[16];
+    snprintf(t, sizeof(t), "%u.%u.%u.%u", _b[0], _b[1], _b[2], _b[3]);
+    return String(t);
+  }
+
+private:
+  uint8_t _b[4] = { 0, 0, 0, 0 };
+};
+
+// ---- Print / Stream ----
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n) {
+    size_t k = 0;
+    while (n--) k += write(*buf++);
+    return k;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t write(const char *s, size_t n) { return write((const uint8_t *)s, n); }
+  virtual void flush() {}
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(const IPAddress &ip) { return print(ip.toString()); }
+  size_t print(int v, int base = 10) { return print((long)v, base); }
+  size_t print(unsigned v, int base = 10) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = 10);
+  size_t print(unsigned long v, int base = 10);
+  size_t print(double v, int decimals = 2);
+  size_t println() { return write("\r\n"); }
+  template <class T>
+  size_t println(const T &v) { size_t n = print(v); return n + println(); }
+  template <class T>
+  size_t println(const T &v, int arg) { size_t n = print(v, arg); return n + println(); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long ms) { _timeout = ms; }
+  unsigned long getTimeout() const { return _timeout; }
+
+  // Como en Arduino: esperan hasta _timeout ms a que lleguen los bytes
+  bool find(const char *target);
+  bool findUntil(const char *target, const char *terminator);
+  size_t readBytes(char *buf, size_t n);
+  size_t readBytesUntil(char terminator, char *buf, size_t n);
+  long parseInt();
+  String readString();
+
+protected:
+  unsigned long _timeout = 1000;
+  int timedRead();
+  int timedPeek();
+};
+
+// ---- Serial y ESP ----
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+  size_t write(const uint8_t *buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override { fflush(stdout); }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+  void restart();
+};
+extern EspClass ESP;
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
@@ -0,0 +1,490 @@
+// ArduinoJson.cpp (host)
+#include <ArduinoJson.h>
+
+using namespace ArduinoJsonHost;
+
+namespace {
+
+const int NESTING_LIMIT = 10;   // el de ArduinoJson por defecto
+const int32_t KEEP_ALL = -2;    // filtro "true" o sin filtro
+const int32_t DROP = -1;        // fuera del filtro: se lee y se descarta
+
+size_t align8(size_t n) {
+  return (n + 7) & ~(size_t)7;
+}
+
+}  // namespace
+
+// ---- JsonDocument ----
+
+void JsonDocument::clear() {
+  _used = 0;
+  _overflowed = false;
+  Node *root = node(newNode(nullptr));
+  root->type = T_NULL;
+}
+
+int32_t JsonDocument::newNode(const char *key) {
+  size_t at = align8(_used);
+  if (at + sizeof(Node) > _size) {
+    _overflowed = true;
+    return -1;
+  }
+  _used = at + sizeof(Node);
+  Node *n = node((int32_t)at);
+  n->key = key;
+  n->next = -1;
+  n->type = T_NULL;
+  n->v.i = 0;
+  return (int32_t)at;
+}
+
+bool JsonDocument::stringPut(size_t at, char c) {
+  if (_used + at + 1 > _size) {
+    _overflowed = true;
+    return false;
+  }
+  _pool[_used + at] = c;
+  return true;
+}
+
+const char *JsonDocument::stringCommit(size_t len) {
+  if (!stringPut(len, '\0')) return nullptr;
+  const char *s = _pool + _used;
+  _used += len + 1;
+  return s;
+}
+
+void JsonDocument::append(int32_t parent, int32_t child) {
+  Node *p = node(parent);
+  if (p->v.child < 0) {
+    p->v.child = child;
+    return;
+  }
+  Node *n = node(p->v.child);
+  while (n->next >= 0) n = node(n->next);
+  n->next = child;
+}
+
+// ---- JsonVariant ----
+
+const Node *JsonVariant::node() const {
+  return _pending ? nullptr : _doc->node(_node);
+}
+
+JsonVariant JsonVariant::child(Segment s) const {
+  JsonVariant r = *this;
+  if (!_pending) {
+    const Node *n = _doc->node(_node);
+    NodeType want = s.key ? T_OBJECT : T_ARRAY;
+    if (n->type == want) {
+      int k = 0;
+      for (int32_t c = n->v.child; c >= 0; c = _doc->node(c)->next, ++k) {
+        const Node *cn = _doc->node(c);
+        if (s.key ? strcmp(cn->key, s.key) == 0 : k == s.index) {
+          r._node = c;
+          return r;
+        }
+      }
+    }
+  }
+  if (r._pending < MAX_PENDING) r._path[r._pending++] = s;
+  return r;
+}
+
+JsonVariant JsonVariant::operator[](const char *key) const {
+  return child({ key, 0 });
+}
+
+JsonVariant JsonVariant::operator[](int index) const {
+  return child({ nullptr, index });
+}
+
+// Crea lo que falta del camino; nullptr si no cabe o choca con otro tipo
+Node *JsonVariant::create() const {
+  int32_t cur = _node;
+  for (uint8_t i = 0; i < _pending; ++i) {
+    const Segment &s = _path[i];
+    Node *n = _doc->node(cur);
+    NodeType want = s.key ? T_OBJECT : T_ARRAY;
+    if (n->type == T_NULL) {
+      n->type = want;
+      n->v.child = -1;
+    }
+    if (n->type != want) return nullptr;
+    int32_t c = -1;
+    if (s.key) {
+      c = _doc->newNode(s.key);   // como en la librería, los literales no se copian
+      if (c < 0) return nullptr;
+      _doc->append(cur, c);
+    } else {
+      // los índices que faltan se rellenan con nulos
+      int k = 0;
+      for (int32_t e = n->v.child; e >= 0; e = _doc->node(e)->next) ++k;
+      for (; k <= s.index; ++k) {
+        c = _doc->newNode(nullptr);
+        if (c < 0) return nullptr;
+        _doc->append(cur, c);
+      }
+    }
+    cur = c;
+  }
+  return _doc->node(cur);
+}
+
+void JsonVariant::operator=(bool v) {
+  if (Node *n = create()) {
+    n->type = T_BOOL;
+    n->v.b = v;
+  }
+}
+
+void JsonVariant::setInt(int64_t v) {
+  if (Node *n = create()) {
+    n->type = T_INT;
+    n->v.i = v;
+  }
+}
+
+void JsonVariant::operator=(double v) {
+  if (Node *n = create()) {
+    n->type = T_FLOAT;
+    n->v.d = v;
+  }
+}
+
+void JsonVariant::operator=(const char *v) {
+  if (Node *n = create()) {
+    n->type = T_STRING;
+    n->v.s = v;
+  }
+}
+
+size_t JsonVariant::size() const {
+  const Node *n = node();
+  if (!n || (n->type != T_ARRAY && n->type != T_OBJECT)) return 0;
+  size_t k = 0;
+  for (int32_t c = n->v.child; c >= 0; c = _doc->node(c)->next) ++k;
+  return k;
+}
+
+const char *DeserializationError::c_str() const {
+  switch (_code) {
+    case Ok: return "Ok";
+    case EmptyInput: return "EmptyInput";
+    case IncompleteInput: return "IncompleteInput";
+    case InvalidInput: return "InvalidInput";
+    case NoMemory: return "NoMemory";
+    case TooDeep: return "TooDeep";
+  }
+  return "???";
+}
+
+// ---- deserializeJson ----
+
+namespace {
+
+class Parser {
+public:
+  Parser(JsonDocument &doc, const JsonDocument *filter, Stream *stream, const char *text)
+      : _doc(doc), _filter(filter), _stream(stream), _text(text) {}
+
+  DeserializationError run() {
+    _doc.clear();
+    if (skipSpace() < 0) return DeserializationError::EmptyInput;
+    return value(0, _filter ? 0 : KEEP_ALL, 0);
+  }
+
+private:
+  JsonDocument &_doc;
+  const JsonDocument *_filter;
+  Stream *_stream;
+  const char *_text;
+  int _peeked = -2;   // -2: nada leído por adelantado
+
+  int readRaw() {
+    if (_stream) {
+      char c;
+      return _stream->readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+    }
+    return *_text ? (uint8_t)*_text++ : -1;
+  }
+  int peek() {
+    if (_peeked == -2) _peeked = readRaw();
+    return _peeked;
+  }
+  int next() {
+    int c = peek();
+    _peeked = -2;
+    return c;
+  }
+  int skipSpace() {
+    int c;
+    while ((c = peek()) == ' ' || c == '\t' || c == '\r' || c == '\n') next();
+    return c;
+  }
+
+  // Filtro del hijo: clave (objetos) o el primer elemento (arrays)
+  int32_t filterChild(int32_t f, const char *key) const {
+    if (f == KEEP_ALL || f == DROP) return f;
+    const Node *n = _filter->node(f);
+    if (n->type == T_BOOL) return n->v.b ? KEEP_ALL : DROP;
+    NodeType want = key ? T_OBJECT : T_ARRAY;
+    if (n->type != want) return DROP;
+    for (int32_t c = n->v.child; c >= 0; c = _filter->node(c)->next) {
+      const Node *cn = _filter->node(c);
+      if (!key || (cn->key && strcmp(cn->key, key) == 0)) return c;
+      if (cn->key && strcmp(cn->key, "*") == 0) return c;
+    }
+    return DROP;
+  }
+  bool keepsScalar(int32_t f) const {
+    if (f == KEEP_ALL) return true;
+    if (f == DROP) return false;
+    const Node *n = _filter->node(f);
+    return n->type == T_BOOL && n->v.b;
+  }
+  bool keeps(int32_t f, NodeType t) const {
+    if (f == KEEP_ALL) return true;
+    if (f == DROP) return false;
+    const Node *n = _filter->node(f);
+    return (n->type == T_BOOL && n->v.b) || n->type == t;
+  }
+
+  DeserializationError value(int32_t dst, int32_t f, int depth) {
+    int c = skipSpace();
+    if (c < 0) return DeserializationError::IncompleteInput;
+    if (c == '{' || c == '[') {
+      if (depth >= NESTING_LIMIT) return DeserializationError::TooDeep;
+      return c == '{' ? object(dst, f, depth) : array(dst, f, depth);
+    }
+    bool keep = dst >= 0 && keepsScalar(f);
+    if (c == '"') {
+      size_t len;
+      DeserializationError err = string(keep, len);
+      if (err || !keep) return err;
+      const char *s = _doc.stringCommit(len);
+      if (!s) return DeserializationError::NoMemory;
+      Node *n = _doc.node(dst);
+      n->type = T_STRING;
+      n->v.s = s;
+      return DeserializationError::Ok;
+    }
+    if (c == '-' || isdigit(c)) return number(keep ? dst : -1);
+    return literal(keep ? dst : -1);
+  }
+
+  DeserializationError object(int32_t dst, int32_t f, int depth) {
+    next();   // '{'
+    bool keep = dst >= 0 && keeps(f, T_OBJECT);
+    if (keep) {
+      Node *n = _doc.node(dst);
+      n->type = T_OBJECT;
+      n->v.child = -1;
+    }
+    int c = skipSpace();
+    if (c == '}') {
+      next();
+      return DeserializationError::Ok;
+    }
+    for (;;) {
+      if (skipSpace() != '"') return peek() < 0 ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+      // la clave va al pool antes de saber si se queda; si no, se reutiliza
+      size_t len;
+      DeserializationError err = string(keep, len);
+      if (err) return err;
+      const char *key = keep ? _doc.stringBegin() : nullptr;
+      int32_t cf = DROP;
+      if (keep) {
+        _doc.stringPut(len, '\0');
+        cf = filterChild(f, key);
+      }
+      int32_t child = -1;
+      if (keep && cf != DROP) {
+        key = _doc.stringCommit(len);
+        if (!key) return DeserializationError::NoMemory;
+        child = _doc.newNode(key);
+        if (child < 0) return DeserializationError::NoMemory;
+        _doc.append(dst, child);
+      }
+      if (skipSpace() != ':') return peek() < 0 ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+      next();
+      err = value(child, cf, depth + 1);
+      if (err) return err;
+      c = skipSpace();
+      next();
+      if (c == '}') return DeserializationError::Ok;
+      if (c != ',') return c < 0 ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+    }
+  }
+
+  DeserializationError array(int32_t dst, int32_t f, int depth) {
+    next();   // '['
+    bool keep = dst >= 0 && keeps(f, T_ARRAY);
+    if (keep) {
+      Node *n = _doc.node(dst);
+      n->type = T_ARRAY;
+      n->v.child = -1;
+    }
+    int32_t ef = keep ? filterChild(f, nullptr) : DROP;
+    int c = skipSpace();
+    if (c == ']') {
+      next();
+      return DeserializationError::Ok;
+    }
+    for (;;) {
+      int32_t child = -1;
+      if (keep && ef != DROP) {
+        child = _doc.newNode(nullptr);
+        if (child < 0) return DeserializationError::NoMemory;
+        _doc.append(dst, child);
+      }
+      DeserializationError err = value(child, ef, depth + 1);
+      if (err) return err;
+      c = skipSpace();
+      next();
+      if (c == ']') return DeserializationError::Ok;
+      if (c != ',') return c < 0 ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+    }
+  }
+
+  // Lee una cadena; si keep, la deja (sin terminar) al final del pool
+  DeserializationError string(bool keep, size_t &len) {
+    next();   // '"'
+    len = 0;
+    for (;;) {
+      int c = next();
+      if (c < 0) return DeserializationError::IncompleteInput;
+      if (c == '"') return DeserializationError::Ok;
+      if (c == '\\') {
+        c = next();
+        uint32_t cp;
+        switch (c) {
+          case 'b': cp = '\b'; break;
+          case 'f': cp = '\f'; break;
+          case 'n': cp = '\n'; break;
+          case 'r': cp = '\r'; break;
+          case 't': cp = '\t'; break;
+          case 'u': {
+            if (!hex4(cp)) return DeserializationError::InvalidInput;
+            if (cp >= 0xD800 && cp < 0xDC00) {   // par sustituto
+              uint32_t lo;
+              if (next() != '\\' || next() != 'u' || !hex4(lo)) return DeserializationError::InvalidInput;
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            }
+            break;
+          }
+          case -1: return DeserializationError::IncompleteInput;
+          default: cp = (uint32_t)c; break;
+        }
+        if (keep && !putUtf8(cp, len)) return DeserializationError::NoMemory;
+        continue;
+      }
+      if (keep && !_doc.stringPut(len++, (char)c)) return DeserializationError::NoMemory;
+    }
+  }
+
+  bool hex4(uint32_t &v) {
+    v = 0;
+    for (int i = 0; i < 4; ++i) {
+      int c = next();
+      if (!isxdigit(c)) return false;
+      v = v * 16 + (uint32_t)(isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+    }
+    return true;
+  }
+
+  bool putUtf8(uint32_t cp, size_t &len) {
+    char b[4];
+    int n;
+    if (cp < 0x80) {
+      b[0] = (char)cp;
+      n = 1;
+    } else if (cp < 0x800) {
+      b[0] = (char)(0xC0 | (cp >> 6));
+      b[1] = (char)(0x80 | (cp & 0x3F));
+      n = 2;
+    } else if (cp < 0x10000) {
+      b[0] = (char)(0xE0 | (cp >> 12));
+      b[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      b[2] = (char)(0x80 | (cp & 0x3F));
+      n = 3;
+    } else {
+      b[0] = (char)(0xF0 | (cp >> 18));
+      b[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+      b[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      b[3] = (char)(0x80 | (cp & 0x3F));
+      n = 4;
+    }
+    for (int i = 0; i < n; ++i) {
+      if (!_doc.stringPut(len++, b[i])) return false;
+    }
+    return true;
+  }
+
+  DeserializationError number(int32_t dst) {
+    char buf[32];
+    size_t n = 0;
+    bool isFloat = false;
+    int c;
+    while ((c = peek()) >= 0 && (isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) {
+      if (n + 1 >= sizeof(buf)) return DeserializationError::InvalidInput;
+      if (c == '.' || c == 'e' || c == 'E') isFloat = true;
+      buf[n++] = (char)next();
+    }
+    buf[n] = '\0';
+    char *end;
+    errno = 0;
+    long long i = isFloat ? 0 : strtoll(buf, &end, 10);
+    if (isFloat || errno == ERANGE) {
+      isFloat = true;
+      double d = strtod(buf, &end);
+      if (dst >= 0) {
+        Node *nd = _doc.node(dst);
+        nd->type = T_FLOAT;
+        nd->v.d = d;
+      }
+    } else if (dst >= 0) {
+      Node *nd = _doc.node(dst);
+      nd->type = T_INT;
+      nd->v.i = i;
+    }
+    return *end ? DeserializationError::InvalidInput : DeserializationError::Ok;
+  }
+
+  DeserializationError literal(int32_t dst) {
+    char buf[6];
+    size_t n = 0;
+    int c;
+    while ((c = peek()) >= 0 && isalpha(c) && n + 1 < sizeof(buf)) buf[n++] = (char)next();
+    buf[n] = '\0';
+    if (c < 0 && n < 4) return DeserializationError::IncompleteInput;
+    Node *nd = _doc.node(dst);
+    if (strcmp(buf, "true") == 0 || strcmp(buf, "false") == 0) {
+      if (nd) {
+        nd->type = T_BOOL;
+        nd->v.b = buf[0] == 't';
+      }
+      return DeserializationError::Ok;
+    }
+    return strcmp(buf, "null") == 0 ? DeserializationError::Ok : DeserializationError::InvalidInput;
+  }
+};
+
+}  // namespace
+
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input) {
+  return Parser(doc, nullptr, &input, nullptr).run();
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input, DeserializationOption::Filter filter) {
+  return Parser(doc, filter.doc(), &input, nullptr).run();
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input) {
+  return Parser(doc, nullptr, nullptr, input).run();
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input, DeserializationOption::Filter filter) {
+  return Parser(doc, filter.doc(), nullptr, input).run();
+}
@@ -0,0 +1,186 @@
+// ArduinoJson.h (host)
+// Lo que usan los sketches de ArduinoJson 6: StaticJsonDocument, acceso con
+// ["clave"][i], "valor | defecto", asignación (para los filtros) y
+// deserializeJson() desde un Stream con DeserializationOption::Filter.
+// Como la librería: el documento es un pool fijo (en la pila si es
+// Static), las cadenas se copian al pool y deserializeJson() lee de uno en
+// uno sólo los bytes del valor, sin consumir lo que va detrás. Los nodos
+// del host ocupan más que en un ESP32 (punteros de 8 B), así que el pool es
+// 3/2 del tamaño pedido.
+#pragma once
+
+#include <Arduino.h>
+#include <limits>
+#include <type_traits>
+
+class JsonDocument;
+
+namespace ArduinoJsonHost {
+
+enum NodeType : uint8_t { T_NULL, T_BOOL, T_INT, T_FLOAT, T_STRING, T_ARRAY, T_OBJECT };
+
+struct Node {
+  const char *key;    // en objetos (literal o copia en el pool)
+  int32_t next;       // siguiente hermano (-1 = ninguno)
+  NodeType type;
+  union {
+    bool b;
+    int64_t i;
+    double d;
+    const char *s;
+    int32_t child;    // primer hijo de arrays y objetos (-1 = vacío)
+  } v;
+};
+
+const int MAX_PENDING = 6;
+
+}  // namespace ArduinoJsonHost
+
+// Referencia a un valor del documento. Si el camino todavía no existe se
+// guarda lo que falta: leer da "nulo" y asignar lo crea.
+class JsonVariant {
+public:
+  JsonVariant(JsonDocument *doc, int32_t node) : _doc(doc), _node(node) {}
+
+  JsonVariant operator[](const char *key) const;
+  JsonVariant operator[](int index) const;
+
+  void operator=(bool v);
+  void operator=(int v) { setInt(v); }
+  void operator=(long v) { setInt(v); }
+  void operator=(unsigned long v) { setInt((int64_t)v); }
+  void operator=(double v);
+  void operator=(const char *v);
+
+  bool isNull() const { return !node(); }
+  bool containsKey(const char *key) const { return !(*this)[key].isNull(); }
+  size_t size() const;
+
+  template <class T>
+  typename std::enable_if<std::is_arithmetic<T>::value, T>::type operator|(T def) const {
+    const ArduinoJsonHost::Node *n = node();
+    return n ? convert(n, def) : def;
+  }
+  const char *operator|(const char *def) const {
+    const ArduinoJsonHost::Node *n = node();
+    return n && n->type == ArduinoJsonHost::T_STRING ? n->v.s : def;
+  }
+
+  template <class T>
+  T as() const { return *this | T(); }
+
+private:
+  struct Segment {
+    const char *key;   // nullptr -> índice
+    int index;
+  };
+  JsonDocument *_doc;
+  int32_t _node;                  // último nodo que existe del camino
+  uint8_t _pending = 0;           // segmentos que faltan por crear
+  Segment _path[ArduinoJsonHost::MAX_PENDING];
+
+  const ArduinoJsonHost::Node *node() const;
+  ArduinoJsonHost::Node *create() const;
+  void setInt(int64_t v);
+  JsonVariant child(Segment s) const;
+
+  static bool convert(const ArduinoJsonHost::Node *n, bool def) {
+    return n->type == ArduinoJsonHost::T_BOOL ? n->v.b : def;
+  }
+  template <class T>
+  static typename std::enable_if<std::is_integral<T>::value, T>::type convert(const ArduinoJsonHost::Node *n, T def) {
+    if (n->type != ArduinoJsonHost::T_INT) return def;
+    int64_t i = n->v.i;
+    if (std::is_unsigned<T>::value ? (i < 0 || (uint64_t)i > (uint64_t)std::numeric_limits<T>::max())
+                                   : (i < (int64_t)std::numeric_limits<T>::min() ||
+                                      i > (int64_t)std::numeric_limits<T>::max())) {
+      return def;
+    }
+    return (T)i;
+  }
+  template <class T>
+  static typename std::enable_if<std::is_floating_point<T>::value, T>::type convert(const ArduinoJsonHost::Node *n,
+                                                                                   T def) {
+    if (n->type == ArduinoJsonHost::T_INT) return (T)n->v.i;
+    if (n->type == ArduinoJsonHost::T_FLOAT) return (T)n->v.d;
+    return def;
+  }
+};
+
+class DeserializationError {
+public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+
+  DeserializationError(Code c = Ok) : _code(c) {}
+  Code code() const { return _code; }
+  explicit operator bool() const { return _code != Ok; }
+  bool operator==(Code c) const { return _code == c; }
+  bool operator!=(Code c) const { return _code != c; }
+  const char *c_str() const;
+
+private:
+  Code _code;
+};
+
+namespace DeserializationOption {
+class Filter {
+public:
+  explicit Filter(const JsonDocument &doc) : _doc(&doc) {}
+  const JsonDocument *doc() const { return _doc; }
+
+private:
+  const JsonDocument *_doc;
+};
+}  // namespace DeserializationOption
+
+class JsonDocument {
+public:
+  JsonDocument(const JsonDocument &) = delete;
+  JsonDocument &operator=(const JsonDocument &) = delete;
+
+  JsonVariant operator[](const char *key) { return root()[key]; }
+  JsonVariant operator[](int index) { return root()[index]; }
+  JsonVariant root() { return JsonVariant(this, 0); }
+  bool containsKey(const char *key) { return root().containsKey(key); }
+  size_t size() { return root().size(); }
+  bool isNull() { return node(0)->type == ArduinoJsonHost::T_NULL; }
+
+  void clear();
+  size_t capacity() const { return _size; }
+  size_t memoryUsage() const { return _used; }
+  bool overflowed() const { return _overflowed; }
+
+  // ---- para JsonVariant y el parser ----
+  ArduinoJsonHost::Node *node(int32_t i) { return i < 0 ? nullptr : (ArduinoJsonHost::Node *)(_pool + i); }
+  const ArduinoJsonHost::Node *node(int32_t i) const {
+    return i < 0 ? nullptr : (const ArduinoJsonHost::Node *)(_pool + i);
+  }
+  int32_t newNode(const char *key);             // -1 si no cabe
+  char *stringBegin() { return _pool + _used; }
+  bool stringPut(size_t at, char c);            // at: bytes ya escritos
+  const char *stringCommit(size_t len);         // nullptr si no cabe
+  void append(int32_t parent, int32_t child);
+
+protected:
+  JsonDocument(char *pool, size_t size) : _pool(pool), _size(size) { clear(); }
+
+private:
+  char *_pool;
+  size_t _size;
+  size_t _used = 0;
+  bool _overflowed = false;
+};
+
+template <size_t N>
+class StaticJsonDocument : public JsonDocument {
+public:
+  StaticJsonDocument() : JsonDocument(_buf, sizeof(_buf)) {}
+
+private:
+  alignas(8) char _buf[N * 3 / 2];
+};
+
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input);
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input, DeserializationOption::Filter filter);
+DeserializationError deserializeJson(JsonDocument &doc, const char *input);
+DeserializationError deserializeJson(JsonDocument &doc, const char *input, DeserializationOption::Filter filter);
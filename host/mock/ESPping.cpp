@@ -0,0 +1,59 @@
+// ESPping.cpp (host)
+#include <ESPping.h>
+#include <poll.h>
+#include "lwip/sockets.h"
+#include "lwip/icmp.h"
+#include "lwip/inet_chksum.h"
+
+PingClass Ping;
+
+bool PingClass::ping(const char *host, uint8_t count) {
+  IPAddress ip;
+  return WiFi.hostByName(host, ip) && ping(ip, count);
+}
+
+bool PingClass::ping(IPAddress ip, uint8_t count) {
+  _avgMs = _minMs = _maxMs = 0;
+  bool raw = false;
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_ICMP);
+  if (fd < 0) {
+    fd = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_ICMP);
+    raw = true;
+  }
+  if (fd < 0) return false;
+  struct sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_addr.s_addr = (uint32_t)ip;
+  uint16_t id = (uint16_t)esp_random();
+  unsigned ok = 0;
+  float total = 0;
+  for (uint8_t i = 0; i < count; ++i) {
+    struct icmp_echo_hdr echo = {};
+    ICMPH_TYPE_SET(&echo, ICMP_ECHO);
+    echo.id = htons(id);
+    echo.seqno = htons(i);
+    echo.chksum = inet_chksum(&echo, sizeof(echo));
+    unsigned long t0 = micros();
+    if (sendto(fd, &echo, sizeof(echo), 0, (struct sockaddr *)&to, sizeof(to)) < 0) continue;
+    // respuesta con el mismo seqno en 1 s (el kernel cambia el id en los de datagramas)
+    while (micros() - t0 < 1000000UL) {
+      struct pollfd p = { fd, POLLIN, 0 };
+      if (poll(&p, 1, 100) != 1) continue;
+      uint8_t buf[128];
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      size_t off = raw ? (size_t)(buf[0] & 0x0f) * 4 : 0;
+      if (n < (ssize_t)(off + sizeof(echo))) continue;
+      struct icmp_echo_hdr *r = (struct icmp_echo_hdr *)(buf + off);
+      if (ICMPH_TYPE(r) != ICMP_ER || ntohs(r->seqno) != i) continue;
+      float ms = (micros() - t0) / 1000.0f;
+      if (!ok || ms < _minMs) _minMs = ms;
+      if (ms > _maxMs) _maxMs = ms;
+      total += ms;
+      ok++;
+      break;
+    }
+  }
+  close(fd);
+  if (ok) _avgMs = total / ok;
+  return ok > 0;
+}
@@ -0,0 +1,19 @@
+// ESPping.h (host)
+// Ping por ICMP con un socket del sistema (de datagramas si el kernel lo
+// permite, si no raw, que necesita root).
+#pragma once
+
+#include <WiFi.h>
+
+class PingClass {
+public:
+  bool ping(IPAddress ip, uint8_t count = 5);
+  bool ping(const char *host, uint8_t count = 5);
+  float averageTime() const { return _avgMs; }
+  float minTime() const { return _minMs; }
+  float maxTime() const { return _maxMs; }
+
+private:
+  float _avgMs = 0, _minMs = 0, _maxMs = 0;
+};
+extern PingClass Ping;
@@ -0,0 +1,342 @@
+// FreeRTOS.cpp (host)
+// Tareas, colas y semáforos de FreeRTOS sobre pthreads.
+//   - Cada tarea es un hilo con pila propia de stackBytes * HOST_STACK_SCALE (2)
+//     (x86-64 gasta más pila que RISC-V), pintada al crearla: lo usado se
+//     mide de verdad, se divide por la escala y se resta de stackBytes.
+//   - La pila cuenta como heap usado mientras vive la tarea, como en IDF.
+//   - Prioridades y núcleos se ignoran: el planificador es el de Linux.
+#include <pthread.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "HostRuntime.h"
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+namespace {
+
+const uint8_t STACK_PAINT = 0xA5;
+
+struct Task {
+  char name[16];
+  TaskFunction_t fn;
+  void *arg;
+  uint8_t *stack;           // mmap, fuera del heap contado
+  size_t stackSize;         // bytes en el host
+  uint32_t stackBytes;      // bytes pedidos (los del ESP32)
+  size_t entryDepth = 0;    // lo que ocupan glibc (TLS, hilo) y taskEntry: no cuenta
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+thread_local Task *current = nullptr;
+Task mainTask;              // el hilo de main() (sin pila medida)
+
+std::recursive_mutex &criticalLock() {
+  static std::recursive_mutex m;
+  return m;
+}
+
+unsigned stackScale() {
+  static unsigned scale = 0;
+  if (!scale) {
+    const char *s = getenv("HOST_STACK_SCALE");
+    scale = (s && atoi(s) > 0) ? (unsigned)atoi(s) : 2;
+  }
+  return scale;
+}
+
+void *taskEntry(void *p) {
+  Task *t = (Task *)p;
+  current = t;
+  t->entryDepth = (size_t)(t->stack + t->stackSize - (uint8_t *)__builtin_frame_address(0));
+  t->fn(t->arg);
+  // en FreeRTOS una tarea no puede volver de su función
+  fprintf(stderr, "[host] la tarea %s ha vuelto sin vTaskDelete\n", t->name);
+  abort();
+}
+
+// Espera en cv hasta que pred() o se acaben los ticks; true si pred()
+template <class Lock, class Pred>
+bool waitTicks(std::condition_variable &cv, Lock &lk, TickType_t ticks, Pred pred) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lk, pred);
+    return true;
+  }
+  return cv.wait_for(lk, std::chrono::milliseconds(ticks), pred);
+}
+
+// tareas creadas (para el informe de pilas al terminar)
+const size_t MAX_TASKS = 16;
+Task *tasks[MAX_TASKS];
+size_t nTasks = 0;
+
+std::mutex &registryLock() {
+  static std::mutex m;
+  return m;
+}
+
+struct Queue {
+  uint8_t *items;           // anillo de length * itemSize (en el heap, como en IDF)
+  size_t itemSize, length, head = 0, count = 0;
+  std::mutex m;
+  std::condition_variable cv;
+};
+
+struct Semaphore {
+  unsigned count, max;
+  std::mutex m;
+  std::condition_variable cv;
+};
+
+}  // namespace
+
+TaskHandle_t hostTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *arg) {
+  Task *t = new Task;
+  strncpy(t->name, name ? name : "", sizeof(t->name) - 1);
+  t->name[sizeof(t->name) - 1] = '\0';
+  t->fn = fn;
+  t->arg = arg;
+  t->stackBytes = stackBytes;
+  size_t page = 4096;
+  t->stackSize = ((size_t)stackBytes * stackScale() + page - 1) / page * page;
+  if (t->stackSize < 64 * 1024) t->stackSize = 64 * 1024;   // mínimo razonable para glibc
+  void *mem = mmap(nullptr, t->stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (mem == MAP_FAILED) {
+    delete t;
+    return nullptr;
+  }
+  t->stack = (uint8_t *)mem;
+  memset(t->stack, STACK_PAINT, t->stackSize);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, t->stack, t->stackSize);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_t th;
+  hostHeapAdjust((long)stackBytes);
+  int err = pthread_create(&th, &attr, taskEntry, t);
+  pthread_attr_destroy(&attr);
+  if (err) {
+    hostHeapAdjust(-(long)stackBytes);
+    munmap(t->stack, t->stackSize);
+    delete t;
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lk(registryLock());
+  if (nTasks < MAX_TASKS) tasks[nTasks++] = t;
+  return t;
+}
+
+void hostEachTask(void (*fn)(const char *name, uint32_t stackBytes, uint32_t minFree)) {
+  std::lock_guard<std::mutex> lk(registryLock());
+  for (size_t i = 0; i < nTasks; ++i) fn(tasks[i]->name, tasks[i]->stackBytes, uxTaskGetStackHighWaterMark(tasks[i]));
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  (void)priority;
+  TaskHandle_t t = hostTaskCreate(fn, name, stackBytes, arg);
+  if (handle) *handle = t;
+  return t ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+  (void)core;
+  return xTaskCreate(fn, name, stackBytes, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  Task *t = (Task *)task;
+  if (t && t != current) {
+    fprintf(stderr, "[host] vTaskDelete de otra tarea no está soportado\n");
+    return;
+  }
+  t = current;
+  if (!t || t == &mainTask) {
+    fprintf(stderr, "[host] vTaskDelete fuera de una tarea\n");
+    abort();
+  }
+  hostHeapAdjust(-(long)t->stackBytes);
+  // la pila y el Task se quedan: el hilo sigue en ella hasta salir
+  pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  delay(ticks);
+}
+
+void vTaskDelayUntil(TickType_t *previous, TickType_t increment) {
+  TickType_t wake = *previous + increment;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(wake - now) > 0) delay(wake - now);
+  *previous = wake;
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return current ? current : &mainTask;
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+  Task *t = task ? (Task *)task : (Task *)xTaskGetCurrentTaskHandle();
+  return t == &mainTask ? "main" : t->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  Task *t = task ? (Task *)task : (Task *)xTaskGetCurrentTaskHandle();
+  if (t == &mainTask) return 8192;   // sin pila propia: lo que da el core al loop
+  // la pila crece hacia abajo: lo no tocado queda al principio
+  size_t untouched = 0;
+  while (untouched < t->stackSize && t->stack[untouched] == STACK_PAINT) untouched++;
+  size_t touched = t->stackSize - untouched;
+  size_t used = (touched > t->entryDepth ? touched - t->entryDepth : 0) / stackScale();
+  return (UBaseType_t)(used < t->stackBytes ? t->stackBytes - used : 0);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  Task *t = (Task *)xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lk(t->m);
+  if (!waitTicks(t->cv, lk, ticks, [t] { return t->notify > 0; })) return 0;
+  uint32_t v = t->notify;
+  t->notify = clearOnExit ? 0 : v - 1;
+  return v;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  Task *t = (Task *)task;
+  {
+    std::lock_guard<std::mutex> lk(t->m);
+    t->notify++;
+  }
+  t->cv.notify_all();
+  return pdPASS;
+}
+
+void portENTER_CRITICAL(portMUX_TYPE *) {
+  criticalLock().lock();
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *) {
+  criticalLock().unlock();
+}
+
+// ---- colas ----
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  Queue *q = new Queue;
+  q->items = new uint8_t[length * itemSize];
+  q->itemSize = itemSize;
+  q->length = length;
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t handle) {
+  Queue *q = (Queue *)handle;
+  delete[] q->items;
+  delete q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks) {
+  Queue *q = (Queue *)handle;
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!waitTicks(q->cv, lk, ticks, [q] { return q->count < q->length; })) return pdFALSE;
+  memcpy(q->items + ((q->head + q->count) % q->length) * q->itemSize, item, q->itemSize);
+  q->count++;
+  lk.unlock();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t handle, const void *item) {
+  Queue *q = (Queue *)handle;
+  {
+    std::lock_guard<std::mutex> lk(q->m);
+    memcpy(q->items + q->head * q->itemSize, item, q->itemSize);   // colas de 1 elemento
+    q->count = 1;
+  }
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+static BaseType_t queueTake(QueueHandle_t handle, void *item, TickType_t ticks, bool remove) {
+  Queue *q = (Queue *)handle;
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!waitTicks(q->cv, lk, ticks, [q] { return q->count > 0; })) return pdFALSE;
+  memcpy(item, q->items + q->head * q->itemSize, q->itemSize);
+  if (remove) {
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+  }
+  lk.unlock();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+  return queueTake(q, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks) {
+  return queueTake(q, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+  Queue *q = (Queue *)handle;
+  std::lock_guard<std::mutex> lk(q->m);
+  return (UBaseType_t)q->count;
+}
+
+// ---- semáforos (el mutex no lleva herencia de prioridad: no hace falta) ----
+
+static SemaphoreHandle_t semaphoreCreate(unsigned count, unsigned max) {
+  Semaphore *s = new Semaphore;
+  s->count = count;
+  s->max = max;
+  return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return semaphoreCreate(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return semaphoreCreate(0, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks) {
+  Semaphore *s = (Semaphore *)handle;
+  std::unique_lock<std::mutex> lk(s->m);
+  if (!waitTicks(s->cv, lk, ticks, [s] { return s->count > 0; })) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle) {
+  Semaphore *s = (Semaphore *)handle;
+  {
+    std::lock_guard<std::mutex> lk(s->m);
+    if (s->count >= s->max) return pdFALSE;
+    s->count++;
+  }
+  s->cv.notify_one();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t handle) {
+  delete (Semaphore *)handle;
+}
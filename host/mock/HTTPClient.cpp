@@ -0,0 +1,86 @@
+// HTTPClient.cpp (host)
+#include <HTTPClient.h>
+
+bool HTTPClient::begin(WiFiClient &client, const String &url) {
+  const char *u = url.c_str();
+  bool https = strncmp(u, "https://", 8) == 0;
+  if (!https && strncmp(u, "http://", 7) != 0) return false;
+  const char *host = u + (https ? 8 : 7);
+  const char *slash = strchr(host, '/');
+  std::string hostPort(host, slash ? (size_t)(slash - host) : strlen(host));
+  uint16_t port = https ? 443 : 80;
+  size_t colon = hostPort.find(':');
+  if (colon != std::string::npos) {
+    port = (uint16_t)atoi(hostPort.c_str() + colon + 1);
+    hostPort.resize(colon);
+  }
+  return begin(client, hostPort.c_str(), port, slash ? slash : "/", https);
+}
+
+bool HTTPClient::begin(WiFiClient &client, const char *host, uint16_t port, const char *uri, bool) {
+  _client = &client;
+  _host = host;
+  _port = port;
+  _uri = uri;
+  _headers = "";
+  _size = -1;
+  return true;
+}
+
+void HTTPClient::addHeader(const char *name, const char *value) {
+  _headers += name;
+  _headers += ": ";
+  _headers += value;
+  _headers += "\r\n";
+}
+
+int HTTPClient::sendRequest(const char *method, const uint8_t *body, size_t len) {
+  if (!_client) return HTTPC_ERROR_CONNECTION_REFUSED;
+  if (!_client->connected() && !_client->connect(_host.c_str(), _port)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  char head[128];
+  snprintf(head, sizeof(head), "Content-Length: %u\r\nConnection: close\r\n\r\n", (unsigned)len);
+  String req = String(method) + " " + _uri + " HTTP/1.0\r\nHost: " + _host + "\r\n" + _headers + head;
+  if (_client->write((const uint8_t *)req.c_str(), req.length()) != req.length() ||
+      (len && _client->write(body, len) != len)) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  _client->setTimeout(_timeoutMs);
+  char line[256];
+  size_t n = _client->readBytesUntil('\n', line, sizeof(line) - 1);
+  line[n] = '\0';
+  const char *sp = strchr(line, ' ');
+  if (!sp) return HTTPC_ERROR_READ_TIMEOUT;
+  int code = atoi(sp + 1);
+  while ((n = _client->readBytesUntil('\n', line, sizeof(line) - 1)) > 0) {
+    line[n] = '\0';
+    if (line[0] == '\r') break;   // fin de cabeceras
+    if (strncasecmp(line, "Content-Length:", 15) == 0) _size = atoi(line + 15);
+  }
+  return code;
+}
+
+String HTTPClient::getString() {
+  String s;
+  if (!_client) return s;
+  char buf[256];
+  size_t n;
+  while ((n = _client->readBytes(buf, _size >= 0 ? std::min(sizeof(buf), (size_t)_size - s.length()) : sizeof(buf))) > 0) {
+    s += String(std::string(buf, n));
+    if (_size >= 0 && s.length() >= (size_t)_size) break;
+  }
+  return s;
+}
+
+void HTTPClient::end() {
+  if (_client) _client->stop();
+  _client = nullptr;
+}
+
+String HTTPClient::errorToString(int code) {
+  switch (code) {
+    case HTTPC_ERROR_CONNECTION_REFUSED: return String("connection refused");
+    case HTTPC_ERROR_SEND_HEADER_FAILED: return String("send header failed");
+    case HTTPC_ERROR_READ_TIMEOUT: return String("read Timeout");
+    default: return String();
+  }
+}
@@ -0,0 +1,38 @@
+// HTTPClient.h (host)
+// Cliente HTTP/1.0 mínimo sobre WiFiClient (una petición por conexión), con
+// la parte de la API del core que se usaba en los sketches.
+#pragma once
+
+#include <WiFiClientSecure.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+#define HTTP_CODE_OK 200
+
+class HTTPClient {
+public:
+  bool begin(WiFiClient &client, const String &url);
+  bool begin(WiFiClient &client, const char *host, uint16_t port, const char *uri = "/", bool https = false);
+  void addHeader(const char *name, const char *value);
+  void setTimeout(uint16_t ms) { _timeoutMs = ms; }
+  void setReuse(bool) {}
+  void useHTTP10(bool) {}
+  int GET() { return sendRequest("GET", nullptr, 0); }
+  int POST(const String &body) { return sendRequest("POST", (const uint8_t *)body.c_str(), body.length()); }
+  int POST(const uint8_t *body, size_t len) { return sendRequest("POST", body, len); }
+  int sendRequest(const char *method, const uint8_t *body, size_t len);
+  int getSize() const { return _size; }
+  WiFiClient *getStreamPtr() { return _client; }
+  WiFiClient &getStream() { return *_client; }
+  String getString();
+  void end();
+  static String errorToString(int code);
+
+private:
+  WiFiClient *_client = nullptr;
+  String _host, _uri, _headers;
+  uint16_t _port = 80;
+  uint16_t _timeoutMs = 5000;
+  int _size = -1;
+};
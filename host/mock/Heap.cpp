@@ -0,0 +1,139 @@
+// Heap.cpp (host)
+// Sustituye malloc/free de glibc (está permitido: ver "Replacing malloc" en
+// su manual) para llevar la cuenta del heap como lo vería el ESP32: bytes y
+// bloques en uso, máximo alcanzado y el hook de reservas de IDF
+// (esp_heap_trace_alloc_hook, si el sketch lo define con
+// CONFIG_HEAP_USE_HOOKS). Lo reservado antes de hostHeapBaseline() (arranque
+// de libstdc++ y del propio mock) no cuenta.
+#include <malloc.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include "HostRuntime.h"
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+void __libc_free(void *p);
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) __attribute__((weak));
+}
+
+namespace {
+
+std::atomic<long> used(0);          // bytes (tamaño útil de cada bloque)
+std::atomic<long> blocks(0);
+std::atomic<long> baseUsed(0);
+std::atomic<long> baseBlocks(0);
+std::atomic<long> peak(0);          // máximo de used - baseUsed
+std::atomic<bool> counting(false);
+thread_local bool inHook = false;
+
+void updatePeak() {
+  long rel = used.load() - baseUsed.load();
+  long p = peak.load();
+  while (rel > p && !peak.compare_exchange_weak(p, rel)) {}
+}
+
+void *track(void *p, size_t size) {
+  if (!p) return p;
+  used += (long)malloc_usable_size(p);
+  blocks++;
+  if (counting.load(std::memory_order_relaxed)) {
+    updatePeak();
+    if (esp_heap_trace_alloc_hook && !inHook) {
+      inHook = true;
+      esp_heap_trace_alloc_hook(p, size, 0);
+      inHook = false;
+    }
+  }
+  return p;
+}
+
+void untrack(void *p) {
+  if (!p) return;
+  used -= (long)malloc_usable_size(p);
+  blocks--;
+}
+
+size_t heapSize() {
+  static size_t size = 0;
+  if (!size) {
+    const char *s = getenv("HOST_HEAP_BYTES");
+    size = (s && atol(s) > 0) ? (size_t)atol(s) : 200 * 1024;   // libre típico de un C3 con WiFi
+  }
+  return size;
+}
+
+}  // namespace
+
+extern "C" {
+
+void *malloc(size_t size) {
+  return track(__libc_malloc(size), size);
+}
+
+void *calloc(size_t n, size_t size) {
+  return track(__libc_calloc(n, size), n * size);
+}
+
+void *realloc(void *p, size_t size) {
+  if (!p) return malloc(size);
+  if (size == 0) {
+    free(p);
+    return nullptr;
+  }
+  long before = (long)malloc_usable_size(p);
+  void *q = __libc_realloc(p, size);
+  if (!q) return nullptr;
+  used += (long)malloc_usable_size(q) - before;
+  if (counting.load(std::memory_order_relaxed)) updatePeak();
+  return q;
+}
+
+void *memalign(size_t align, size_t size) {
+  return track(__libc_memalign(align, size), size);
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+  return memalign(align, size);
+}
+
+int posix_memalign(void **out, size_t align, size_t size) {
+  void *p = memalign(align, size);
+  if (!p) return ENOMEM;
+  *out = p;
+  return 0;
+}
+
+void free(void *p) {
+  untrack(p);
+  __libc_free(p);
+}
+
+}  // extern "C"
+
+void hostHeapBaseline() {
+  baseUsed = used.load();
+  baseBlocks = blocks.load();
+  peak = 0;
+  counting = true;
+}
+
+void hostHeapAdjust(long bytes) {
+  used += bytes;
+  updatePeak();
+}
+
+HostHeap hostHeap() {
+  HostHeap h;
+  long u = used.load() - baseUsed.load();
+  long b = blocks.load() - baseBlocks.load();
+  h.size = heapSize();
+  h.used = u > 0 ? (size_t)u : 0;
+  h.peak = (size_t)peak.load();
+  h.blocks = b > 0 ? (size_t)b : 0;
+  return h;
+}
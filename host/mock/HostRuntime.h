@@ -0,0 +1,36 @@
+// HostRuntime.h (host)
+// Lo que comparten las piezas del mock entre sí y con main(): no es una
+// cabecera de Arduino y los sketches no la incluyen.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// ---- heap simulado (Heap.cpp) ----
+// Todo malloc/free del proceso después de hostHeapBaseline(), más las pilas
+// de las tareas, sobre un heap de HOST_HEAP_BYTES (por defecto el libre de un
+// ESP32-C3 con WiFi arrancado). No modela fragmentación ni TLS.
+struct HostHeap {
+  size_t size;
+  size_t used;
+  size_t peak;              // máximo de used (high-water mark)
+  size_t blocks;
+};
+HostHeap hostHeap();
+void hostHeapBaseline();
+void hostHeapAdjust(long bytes);   // memoria que no pasa por malloc (pilas)
+
+// ---- tareas (FreeRTOS.cpp) ----
+TaskHandle_t hostTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackBytes, void *arg);
+void hostEachTask(void (*fn)(const char *name, uint32_t stackBytes, uint32_t minFree));
+
+// ---- red (WiFi.cpp) ----
+struct HostNet {
+  uint32_t connects;
+  uint32_t connectFailures;
+  uint64_t bytesOut;        // bytes de TCP escritos por los clientes
+  uint64_t bytesIn;
+};
+HostNet hostNet();
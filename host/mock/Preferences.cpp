@@ -0,0 +1,100 @@
+// Preferences.cpp (host)
+// Cada namespace es un fichero de registros [clave][valor]; se lee entero en
+// cada get y se reescribe en cada put (pocas claves y pequeñas, como en NVS).
+#include <Preferences.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::map<std::string, std::vector<uint8_t>> Store;
+
+Store load(const char *path) {
+  Store s;
+  FILE *f = fopen(path, "rb");
+  if (!f) return s;
+  uint8_t klen;
+  while (fread(&klen, 1, 1, f) == 1) {
+    std::string key(klen, '\0');
+    uint16_t vlen;
+    if (fread(&key[0], 1, klen, f) != klen || fread(&vlen, sizeof(vlen), 1, f) != 1) break;
+    std::vector<uint8_t> v(vlen);
+    if (vlen && fread(v.data(), 1, vlen, f) != vlen) break;
+    s[key] = v;
+  }
+  fclose(f);
+  return s;
+}
+
+bool save(const char *path, const Store &s) {
+  std::string tmp = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  for (const auto &kv : s) {
+    uint8_t klen = (uint8_t)kv.first.size();
+    uint16_t vlen = (uint16_t)kv.second.size();
+    fwrite(&klen, 1, 1, f);
+    fwrite(kv.first.data(), 1, klen, f);
+    fwrite(&vlen, sizeof(vlen), 1, f);
+    if (vlen) fwrite(kv.second.data(), 1, vlen, f);
+  }
+  bool ok = fclose(f) == 0;
+  return ok && rename(tmp.c_str(), path) == 0;
+}
+
+}  // namespace
+
+bool Preferences::begin(const char *name, bool readOnly, const char *) {
+  if (!name || strlen(name) > 15) return false;   // límite de NVS
+  const char *dir = getenv("HOST_NVS_DIR");
+  snprintf(_path, sizeof(_path), "%s/nvs-%s.bin", dir && *dir ? dir : ".", name);
+  _open = true;
+  _readOnly = readOnly;
+  return true;
+}
+
+void Preferences::end() {
+  _open = false;
+}
+
+bool Preferences::clear() {
+  if (!_open || _readOnly) return false;
+  return save(_path, Store());
+}
+
+bool Preferences::remove(const char *key) {
+  if (!_open || _readOnly) return false;
+  Store s = load(_path);
+  if (!s.erase(key)) return false;
+  return save(_path, s);
+}
+
+bool Preferences::isKey(const char *key) {
+  if (!_open) return false;
+  Store s = load(_path);
+  return s.count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  if (!_open || _readOnly || !key || strlen(key) > 15 || len > 0xffff) return 0;
+  Store s = load(_path);
+  s[key].assign((const uint8_t *)value, (const uint8_t *)value + len);
+  return save(_path, s) ? len : 0;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  if (!_open) return 0;
+  Store s = load(_path);
+  auto it = s.find(key);
+  return it == s.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  if (!_open) return 0;
+  Store s = load(_path);
+  auto it = s.find(key);
+  if (it == s.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
@@ -0,0 +1,47 @@
+// Preferences.h (host)
+// NVS simulada: un fichero por namespace en HOST_NVS_DIR (por defecto el
+// directorio actual), reescrito en cada put como la flash. Sobrevive a los
+// reinicios y deep sleeps simulados; borrar los ficheros es "borrar la flash".
+#pragma once
+
+#include <Arduino.h>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false, const char *partition = nullptr);
+  void end();
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putUChar(const char *key, uint8_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putUShort(const char *key, uint16_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putInt(const char *key, int32_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putUInt(const char *key, uint32_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putLong(const char *key, int32_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putULong(const char *key, uint32_t v) { return putBytes(key, &v, sizeof(v)); }
+  size_t putBool(const char *key, bool v) { return putUChar(key, v ? 1 : 0); }
+  size_t putString(const char *key, const char *v) { return putBytes(key, v, strlen(v) + 1); }
+  size_t putBytes(const char *key, const void *value, size_t len);
+
+  uint8_t getUChar(const char *key, uint8_t def = 0) { return get(key, def); }
+  uint16_t getUShort(const char *key, uint16_t def = 0) { return get(key, def); }
+  int32_t getInt(const char *key, int32_t def = 0) { return get(key, def); }
+  uint32_t getUInt(const char *key, uint32_t def = 0) { return get(key, def); }
+  int32_t getLong(const char *key, int32_t def = 0) { return get(key, def); }
+  uint32_t getULong(const char *key, uint32_t def = 0) { return get(key, def); }
+  bool getBool(const char *key, bool def = false) { return getUChar(key, def ? 1 : 0) != 0; }
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  char _path[256] = "";
+  bool _open = false;
+  bool _readOnly = false;
+
+  template <class T>
+  T get(const char *key, T def) {
+    T v;
+    return getBytesLength(key) == sizeof(T) && getBytes(key, &v, sizeof(T)) == sizeof(T) ? v : def;
+  }
+};
@@ -0,0 +1,275 @@
+// WiFi.cpp (host)
+// WiFi, WiFiClient y WiFiServer sobre sockets TCP del sistema, con contadores
+// de conexiones y bytes para el informe del banco de pruebas.
+#include <WiFi.h>
+#include <netdb.h>
+#include <poll.h>
+#include <atomic>
+#include "lwip/sockets.h"
+#include "lwip/etharp.h"
+#include "HostRuntime.h"
+
+WiFiClass WiFi;
+
+namespace {
+
+std::atomic<uint32_t> netConnects(0);
+std::atomic<uint32_t> netConnectFailures(0);
+std::atomic<uint64_t> netBytesOut(0);
+std::atomic<uint64_t> netBytesIn(0);
+
+wl_status_t wifiStatus = WL_IDLE_STATUS;
+
+IPAddress envIp(const char *name, const char *def) {
+  const char *s = getenv(name);
+  IPAddress ip;
+  if (!s || !ip.fromString(s)) ip.fromString(def);
+  return ip;
+}
+
+const unsigned long WRITE_TIMEOUT_MS = 5000;
+
+}  // namespace
+
+HostNet hostNet() {
+  HostNet n;
+  n.connects = netConnects;
+  n.connectFailures = netConnectFailures;
+  n.bytesOut = netBytesOut;
+  n.bytesIn = netBytesIn;
+  return n;
+}
+
+// ---- WiFi ----
+
+wl_status_t WiFiClass::begin(const char *, const char *, int32_t, const uint8_t *, bool) {
+  const char *ms = getenv("HOST_WIFI_MS");
+  if (ms && atol(ms) > 0) delay((unsigned long)atol(ms));   // lo que tarda en asociarse
+  netif_default->ip_addr.addr = (uint32_t)localIP();
+  netif_default->netmask.addr = (uint32_t)subnetMask();
+  netif_default->gw.addr = (uint32_t)gatewayIP();
+  wifiStatus = WL_CONNECTED;
+  return wifiStatus;
+}
+
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress, IPAddress) {
+  return true;   // la IP es siempre la del host
+}
+
+bool WiFiClass::disconnect(bool, bool) {
+  wifiStatus = WL_DISCONNECTED;
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  return wifiStatus;
+}
+
+IPAddress WiFiClass::localIP() {
+  return envIp("HOST_IP", "127.0.0.1");
+}
+
+IPAddress WiFiClass::subnetMask() {
+  return envIp("HOST_MASK", "255.255.255.0");
+}
+
+IPAddress WiFiClass::gatewayIP() {
+  return envIp("HOST_GATEWAY", "127.0.0.1");
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t) {
+  return gatewayIP();
+}
+
+uint8_t *WiFiClass::macAddress(uint8_t *mac) {
+  static const uint8_t MAC[6] = { 0x02, 0x00, 0x00, 0xC3, 0x00, 0x01 };
+  memcpy(mac, MAC, 6);
+  return mac;
+}
+
+String WiFiClass::macAddress() {
+  uint8_t m[6];
+  macAddress(m);
+  char t[18];
+  snprintf(t, sizeof(t), "%02X:%02X:%02X:%02X:%02X:%02X", m[0], m[1], m[2], m[3], m[4], m[5]);
+  return String(t);
+}
+
+uint8_t *WiFiClass::BSSID() {
+  static uint8_t bssid[6] = { 0x02, 0x00, 0x00, 0xAA, 0x00, 0x01 };
+  return bssid;
+}
+
+int32_t WiFiClass::channel() {
+  return 6;
+}
+
+int8_t WiFiClass::RSSI() {
+  return (int8_t)(-60 + (int)(esp_random() % 11) - 5);   // -65..-55 dBm
+}
+
+String WiFiClass::SSID() {
+  return String("host");
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &ip) {
+  struct addrinfo hints = {}, *res = nullptr;
+  hints.ai_family = AF_INET;
+  if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res) return 0;
+  ip = IPAddress((uint32_t)((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(res);
+  return 1;
+}
+
+// ---- WiFiClient ----
+
+struct HostSocket {
+  int fd;
+  explicit HostSocket(int f) : fd(f) {}
+  ~HostSocket() { if (fd >= 0) close(fd); }
+};
+
+WiFiClient::WiFiClient(int fd) : _sock(std::make_shared<HostSocket>(fd)) {}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, 3000);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) return 0;
+  return connect(ip, port);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  stop();
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0) return 0;
+  struct sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(port);
+  to.sin_addr.s_addr = (uint32_t)ip;
+  int r = ::connect(fd, (struct sockaddr *)&to, sizeof(to));
+  if (r < 0 && errno == EINPROGRESS) {
+    struct pollfd p = { fd, POLLOUT, 0 };
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (poll(&p, 1, timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) r = 0;
+  }
+  if (r < 0) {
+    close(fd);
+    netConnectFailures++;
+    return 0;
+  }
+  netConnects++;
+  _sock = std::make_shared<HostSocket>(fd);
+  return 1;
+}
+
+int WiFiClient::fd() const {
+  return _sock ? _sock->fd : -1;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t n) {
+  int f = fd();
+  if (f < 0) return 0;
+  size_t done = 0;
+  unsigned long start = millis();
+  while (done < n) {
+    ssize_t k = send(f, buf + done, n - done, MSG_NOSIGNAL);
+    if (k > 0) {
+      done += (size_t)k;
+      continue;
+    }
+    if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && millis() - start < WRITE_TIMEOUT_MS) {
+      struct pollfd p = { f, POLLOUT, 0 };
+      poll(&p, 1, 10);
+      continue;
+    }
+    break;
+  }
+  netBytesOut += done;
+  return done;
+}
+
+int WiFiClient::available() {
+  int f = fd();
+  int n = 0;
+  if (f < 0 || ioctl(f, FIONREAD, &n) < 0) return 0;
+  return n;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t n) {
+  int f = fd();
+  if (f < 0) return -1;
+  ssize_t k = recv(f, buf, n, MSG_DONTWAIT);
+  if (k <= 0) return -1;
+  netBytesIn += (uint64_t)k;
+  return (int)k;
+}
+
+int WiFiClient::peek() {
+  int f = fd();
+  uint8_t c;
+  if (f < 0 || recv(f, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1) return -1;
+  return c;
+}
+
+void WiFiClient::stop() {
+  _sock.reset();
+}
+
+uint8_t WiFiClient::connected() {
+  int f = fd();
+  if (f < 0) return 0;
+  uint8_t c;
+  ssize_t k = recv(f, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (k > 0) return 1;
+  if (k == 0) return 0;   // el otro lado cerró y no queda nada por leer
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : 0;
+}
+
+void WiFiClient::setNoDelay(bool on) {
+  int f = fd(), v = on ? 1 : 0;
+  if (f >= 0) setsockopt(f, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+}
+
+// ---- WiFiServer ----
+
+void WiFiServer::begin(uint16_t port) {
+  if (port) _port = port;
+  end();
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0) return;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in a = {};
+  a.sin_family = AF_INET;
+  a.sin_port = htons(_port);
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(fd, 4) < 0) {
+    fprintf(stderr, "[host] no se puede escuchar en el puerto %u: %s\n", (unsigned)_port, strerror(errno));
+    close(fd);
+    return;
+  }
+  _fd = fd;
+}
+
+WiFiClient WiFiServer::accept() {
+  if (_fd < 0) return WiFiClient();
+  int fd = accept4(_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (fd < 0) return WiFiClient();
+  WiFiClient c(fd);
+  if (_noDelay) c.setNoDelay(true);
+  return c;
+}
+
+void WiFiServer::end() {
+  if (_fd >= 0) close(_fd);
+  _fd = -1;
+}
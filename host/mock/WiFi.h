@@ -0,0 +1,98 @@
+// WiFi.h (host)
+// La "red WiFi" es la del host: se conecta siempre (tras HOST_WIFI_MS), la
+// IP es HOST_IP/HOST_MASK (127.0.0.1/24 por defecto) y los clientes y el
+// servidor son sockets TCP normales.
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <memory>
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t m) { (void)m; return true; }
+  bool persistent(bool) { return true; }
+  bool setSleep(bool) { return true; }
+  bool setAutoReconnect(bool) { return true; }
+  wl_status_t begin(const char *ssid, const char *pass, int32_t channel = 0, const uint8_t *bssid = nullptr,
+                    bool connect = true);
+  bool config(IPAddress ip, IPAddress gateway, IPAddress mask, IPAddress dns1 = IPAddress(),
+              IPAddress dns2 = IPAddress());
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  wl_status_t status();
+
+  IPAddress localIP();
+  IPAddress subnetMask();
+  IPAddress gatewayIP();
+  IPAddress dnsIP(uint8_t i = 0);
+  uint8_t *macAddress(uint8_t *mac);
+  String macAddress();
+  uint8_t *BSSID();
+  int32_t channel();
+  int8_t RSSI();
+  String SSID();
+
+  int hostByName(const char *host, IPAddress &ip);
+};
+extern WiFiClass WiFi;
+
+// Socket compartido entre copias del cliente, como en el core
+struct HostSocket;
+
+class WiFiClient : public Client {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd);
+  ~WiFiClient() override {}
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t n) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t n) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+  void setNoDelay(bool on);
+  int fd() const;
+
+protected:
+  std::shared_ptr<HostSocket> _sock;
+};
+
+class WiFiServer {
+public:
+  WiFiServer(uint16_t port = 80, uint8_t maxClients = 4) : _port(port) { (void)maxClients; }
+  ~WiFiServer() { end(); }
+  void begin(uint16_t port = 0);
+  WiFiClient available() { return accept(); }
+  WiFiClient accept();
+  void setNoDelay(bool on) { _noDelay = on; }
+  void end();
+  void stop() { end(); }
+  operator bool() const { return _fd >= 0; }
+
+private:
+  uint16_t _port;
+  int _fd = -1;
+  bool _noDelay = false;
+};
@@ -0,0 +1,19 @@
+// WiFiClientSecure.h (host)
+// Sin TLS: el servidor de pruebas habla HTTP plano, así que es un WiFiClient
+// que acepta (e ignora) los certificados. Los bytes medidos son los de HTTP.
+#pragma once
+
+#include <WiFi.h>
+
+class WiFiClientSecure : public WiFiClient {
+public:
+  void setInsecure() {}
+  void setCACert(const char *) {}
+  void setHandshakeTimeout(unsigned long seconds) { (void)seconds; }
+  using WiFiClient::connect;
+  int connect(IPAddress ip, uint16_t port, const char *host, const char *caCert, const char *cert,
+              const char *key) {
+    (void)host; (void)caCert; (void)cert; (void)key;
+    return WiFiClient::connect(ip, port);
+  }
+};
@@ -0,0 +1,6 @@
+// esp_random.h (host)
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
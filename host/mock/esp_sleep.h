@@ -0,0 +1,21 @@
+// esp_sleep.h (host)
+// Deep sleep simulado: esp_deep_sleep_start() guarda la memoria RTC y vuelve
+// a lanzar el programa (ver Arduino.cpp).
+#pragma once
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED,
+  ESP_SLEEP_WAKEUP_ALL,
+  ESP_SLEEP_WAKEUP_EXT0,
+  ESP_SLEEP_WAKEUP_EXT1,
+  ESP_SLEEP_WAKEUP_TIMER
+} esp_sleep_wakeup_cause_t;
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void);
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs);
+void esp_deep_sleep_start(void) __attribute__((noreturn));
@@ -0,0 +1,8 @@
+// esp_system.h (host)
+#pragma once
+
+typedef int esp_err_t;
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+void esp_restart(void) __attribute__((noreturn));
@@ -0,0 +1,64 @@
+// lwip.cpp (host)
+// Lo poco de lwIP que no es la API de sockets: checksum, tabla ARP, netif
+// por defecto y tcpip_api_call.
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include "lwip/sockets.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/etharp.h"
+#include "lwip/tcpip.h"
+
+static struct netif hostNetif = {};
+struct netif *netif_default = &hostNetif;
+struct netif *netif_list = &hostNetif;
+
+u16_t inet_chksum(const void *data, u16_t len) {
+  const u8_t *p = (const u8_t *)data;
+  uint32_t sum = 0;
+  for (; len > 1; len -= 2, p += 2) sum += (uint32_t)(p[0] << 8 | p[1]);
+  if (len) sum += (uint32_t)(p[0] << 8);
+  while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+  return htons((u16_t)~sum);
+}
+
+err_t etharp_request(struct netif *, const ip4_addr_t *) {
+  return ERR_OK;
+}
+
+// Entrada i de la tabla: las completas de /proc/net/arp (flags 0x2)
+int etharp_get_entry(size_t i, ip4_addr_t **ip, struct netif **nif, struct eth_addr **eth) {
+  static ip4_addr_t ips[ARP_TABLE_SIZE];
+  static struct eth_addr macs[ARP_TABLE_SIZE];
+  if (i >= ARP_TABLE_SIZE) return 0;
+  FILE *f = fopen("/proc/net/arp", "r");
+  if (!f) return 0;
+  char line[256];
+  size_t n = 0;
+  int found = 0;
+  if (!fgets(line, sizeof(line), f)) line[0] = '\0';   // cabecera
+  while (fgets(line, sizeof(line), f)) {
+    char ipText[32], mac[32];
+    unsigned flags, m[6];
+    if (sscanf(line, "%31s %*s %x %31s", ipText, &flags, mac) != 3 || !(flags & 0x2)) continue;
+    if (sscanf(mac, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) continue;
+    if (n++ != i) continue;
+    struct in_addr a;
+    if (!inet_aton(ipText, &a)) break;
+    ips[i].addr = a.s_addr;
+    for (int k = 0; k < 6; ++k) macs[i].addr[k] = (u8_t)m[k];
+    *ip = &ips[i];
+    *nif = netif_default;
+    *eth = &macs[i];
+    found = 1;
+    break;
+  }
+  fclose(f);
+  return found;
+}
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call) {
+  static std::mutex m;
+  std::lock_guard<std::mutex> lk(m);
+  return fn(call);
+}
@@ -0,0 +1,35 @@
+// lwip/etharp.h (host)
+// La tabla ARP sale de /proc/net/arp; las peticiones no se envían (las hace
+// el kernel cuando hay tráfico).
+#pragma once
+
+#include <stddef.h>
+#include "lwip/sockets.h"
+
+#define ERR_OK 0
+#define ARP_TABLE_SIZE 10
+
+typedef struct {
+  u32_t addr;
+} ip4_addr_t;
+
+struct eth_addr {
+  u8_t addr[6];
+};
+
+struct netif {
+  ip4_addr_t ip_addr;
+  ip4_addr_t netmask;
+  ip4_addr_t gw;
+  struct netif *next;
+};
+
+extern struct netif *netif_default;
+extern struct netif *netif_list;
+
+#define ip4_addr_set_u32(a, v) ((a)->addr = (v))
+#define ip4_addr_get_u32(a) ((a)->addr)
+#define netif_is_up(n) 1
+
+err_t etharp_request(struct netif *nif, const ip4_addr_t *ip);
+int etharp_get_entry(size_t i, ip4_addr_t **ip, struct netif **nif, struct eth_addr **eth);
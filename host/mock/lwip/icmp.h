@@ -0,0 +1,21 @@
+// lwip/icmp.h (host)
+#pragma once
+
+#include "lwip/sockets.h"
+
+#define IP_PROTO_ICMP 1
+#define ICMP_ER 0
+#define ICMP_ECHO 8
+
+struct icmp_echo_hdr {
+  u8_t type;
+  u8_t code;
+  u16_t chksum;
+  u16_t id;
+  u16_t seqno;
+};
+
+#define ICMPH_TYPE(h) ((h)->type)
+#define ICMPH_CODE(h) ((h)->code)
+#define ICMPH_TYPE_SET(h, t) ((h)->type = (t))
+#define ICMPH_CODE_SET(h, c) ((h)->code = (c))
@@ -0,0 +1,6 @@
+// lwip/inet_chksum.h (host)
+#pragma once
+
+#include "lwip/sockets.h"
+
+u16_t inet_chksum(const void *data, u16_t len);
@@ -0,0 +1,23 @@
+// lwip/ip.h (host)
+#pragma once
+
+#include "lwip/sockets.h"
+
+struct ip4_addr_packed {
+  u32_t addr;
+};
+
+struct ip_hdr {
+  u8_t _v_hl;
+  u8_t _tos;
+  u16_t _len;
+  u16_t _id;
+  u16_t _offset;
+  u8_t _ttl;
+  u8_t _proto;
+  u16_t _chksum;
+  struct ip4_addr_packed src;
+  struct ip4_addr_packed dest;
+};
+
+#define IPH_HL(h) ((h)->_v_hl & 0x0f)
@@ -0,0 +1,14 @@
+// lwip/tcpip.h (host)
+// No hay hilo tcpip: la llamada se hace en el hilo que la pide, con un
+// cerrojo para que no se solapen.
+#pragma once
+
+#include "lwip/sockets.h"
+
+struct tcpip_api_call_data {
+  err_t err;
+};
+
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data *call);
+
+err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data *call);
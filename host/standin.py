@@ -0,0 +1,393 @@
+#!/usr/bin/env python3
+"""Servidor de pruebas que hace de api.telegram.org y de api.openweathermap.org.
+
+HTTP plano (sin TLS) en un solo puerto:
+  POST /bot<token>/sendMessage, /bot<token>/editMessageText
+  GET  /bot<token>/getUpdates?offset=..&limit=..&timeout=..   (long-poll)
+  GET  /data/2.5/group?id=a,b,c&units=metric...
+  GET  /data/2.5/forecast?id=..&cnt=..
+
+Las respuestas llevan los mismos campos que las de verdad (también los que
+los sketches no leen) para que los bytes en la red sean representativos.
+El tiempo es determinista: el reloj de OpenWeather avanza WEATHER_STEP_S en
+cada consulta de /group, como si entre una y otra hubiera un ciclo de sueño.
+
+Solo:  python3 standin.py --port 8081
+  cada línea de la entrada estándar se entrega como mensaje del dueño (p. ej.
+  "/status") y los mensajes enviados por el sketch se muestran en la salida.
+Desde bench.py se usa como módulo (StandIn).
+"""
+
+import argparse
+import json
+import math
+import random
+import socket
+import sys
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+CHAT_ID = 123                 # el -DCHAT_ID del Makefile: dueño y chat
+WEATHER_START = 1760000000    # 2025-10-09 08:53 UTC
+WEATHER_STEP_S = 900          # 15 min, el INTERVAL_MS del sketch del tiempo
+TIMEZONE_S = 7200             # hora de verano de España
+
+CITIES = {
+    3117735: ("Madrid", 40.4165, -3.7026, 17.0),
+    3128760: ("Barcelona", 41.3888, 2.159, 19.5),
+    2509954: ("Valencia", 39.4739, -0.3797, 21.0),
+}
+KINDS = [
+    (800, "Clear", "cielo claro", "01"),
+    (801, "Clouds", "algo de nubes", "02"),
+    (802, "Clouds", "nubes dispersas", "03"),
+    (803, "Clouds", "nubes rotas", "04"),
+    (804, "Clouds", "nubes", "04"),
+    (500, "Rain", "lluvia ligera", "10"),
+    (501, "Rain", "lluvia moderada", "10"),
+]
+
+
+class Counting:
+    """Envuelve rfile/wfile para contar los bytes de cada conexión."""
+
+    def __init__(self, f):
+        self._f = f
+        self.count = 0
+
+    def read(self, *a):
+        b = self._f.read(*a)
+        self.count += len(b)
+        return b
+
+    def readline(self, *a):
+        b = self._f.readline(*a)
+        self.count += len(b)
+        return b
+
+    def write(self, b):
+        self.count += len(b)
+        return self._f.write(b)
+
+    def __getattr__(self, name):
+        return getattr(self._f, name)
+
+
+class Endpoint:
+    def __init__(self):
+        self.requests = 0
+        self.bytes_in = 0      # del sketch al servidor
+        self.bytes_out = 0     # del servidor al sketch
+
+    def as_dict(self):
+        return {"requests": self.requests, "bytes_in": self.bytes_in, "bytes_out": self.bytes_out}
+
+
+class Weather:
+    """Tiempo inventado pero estable: ciclo diario y cambios cada pocas horas."""
+
+    def __init__(self):
+        self.clock = WEATHER_START
+
+    def tick(self):
+        self.clock += WEATHER_STEP_S
+        return self.clock
+
+    @staticmethod
+    def city(cid):
+        return CITIES.get(cid, ("Ciudad %d" % cid, 40.0, -3.0, 18.0))
+
+    def sample(self, cid, t):
+        name, lat, lon, base = self.city(cid)
+        rng = random.Random("%d:%d" % (cid, t // 3600))
+        hour = ((t + TIMEZONE_S) % 86400) / 3600.0
+        day = math.sin(2 * math.pi * (hour - 9) / 24)
+        temp = round(base + 7 * day + rng.uniform(-0.6, 0.6), 2)
+        kind = KINDS[random.Random("%d:%d" % (cid, t // 10800)).randrange(len(KINDS))]
+        rainy = kind[0] >= 500 and kind[0] < 600
+        humidity = int(max(15, min(100, 60 - 20 * day + (25 if rainy else 0) + rng.randint(-4, 4))))
+        return {
+            "temp": temp,
+            "feels_like": round(temp - 0.4 + humidity / 100.0, 2),
+            "temp_min": round(temp - 1.2, 2),
+            "temp_max": round(temp + 1.1, 2),
+            "pressure": 1012 + rng.randint(-6, 6),
+            "humidity": humidity,
+            "kind": kind,
+            "wind": round(rng.uniform(0.5, 7.5), 2),
+            "deg": rng.randrange(360),
+            "clouds": 0 if kind[0] == 800 else rng.randint(20, 100),
+            "pop": round(min(1.0, rng.uniform(0.55, 1.0)) if rainy else rng.uniform(0, 0.2), 2),
+            "rain": round(rng.uniform(0.2, 3.5), 2) if rainy else 0,
+        }
+
+    @staticmethod
+    def weather_list(s, night):
+        k = s["kind"]
+        return [{"id": k[0], "main": k[1], "description": k[2], "icon": k[3] + ("n" if night else "d")}]
+
+    def group(self, ids):
+        t = self.tick()
+        out = []
+        for cid in ids:
+            name, lat, lon, _ = self.city(cid)
+            s = self.sample(cid, t)
+            hour = ((t + TIMEZONE_S) % 86400) // 3600
+            out.append({
+                "coord": {"lon": lon, "lat": lat},
+                "sys": {"country": "ES", "timezone": TIMEZONE_S,
+                        "sunrise": t - t % 86400 + 21600, "sunset": t - t % 86400 + 64800},
+                "weather": self.weather_list(s, hour < 8 or hour >= 20),
+                "main": {k: s[k] for k in ("temp", "feels_like", "temp_min", "temp_max", "pressure", "humidity")},
+                "visibility": 10000,
+                "wind": {"speed": s["wind"], "deg": s["deg"]},
+                "clouds": {"all": s["clouds"]},
+                "dt": t,
+                "id": cid,
+                "name": name,
+            })
+        return {"cnt": len(out), "list": out}
+
+    def forecast(self, cid, cnt):
+        name, lat, lon, _ = self.city(cid)
+        t0 = self.clock - self.clock % 10800 + 10800
+        steps = []
+        for k in range(cnt):
+            t = t0 + k * 10800
+            s = self.sample(cid, t)
+            hour = ((t + TIMEZONE_S) % 86400) // 3600
+            step = {
+                "dt": t,
+                "main": {k2: s[k2] for k2 in ("temp", "feels_like", "temp_min", "temp_max", "pressure")},
+                "weather": self.weather_list(s, hour < 8 or hour >= 20),
+                "clouds": {"all": s["clouds"]},
+                "wind": {"speed": s["wind"], "deg": s["deg"], "gust": round(s["wind"] * 1.6, 2)},
+                "visibility": 10000,
+                "pop": s["pop"],
+                "sys": {"pod": "n" if hour < 8 or hour >= 20 else "d"},
+                "dt_txt": time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(t)),
+            }
+            step["main"].update({"sea_level": s["pressure"], "grnd_level": s["pressure"] - 60,
+                                 "humidity": s["humidity"], "temp_kf": 0})
+            if s["rain"]:
+                step["rain"] = {"3h": s["rain"]}
+            steps.append(step)
+        return {
+            "cod": "200", "message": 0, "cnt": len(steps), "list": steps,
+            "city": {"id": cid, "name": name, "coord": {"lat": lat, "lon": lon}, "country": "ES",
+                     "population": 1000000, "timezone": TIMEZONE_S,
+                     "sunrise": t0 - t0 % 86400 + 21600, "sunset": t0 - t0 % 86400 + 64800},
+        }
+
+
+class StandIn:
+    """Estado del servidor: updates pendientes, mensajes recibidos y métricas."""
+
+    def __init__(self, port, on_message=None):
+        self.lock = threading.Condition()
+        self.endpoints = {}
+        self.updates = []            # (update_id, dict)
+        self.next_update = 1000
+        self.next_message = 1
+        self.pending = []            # comandos sin respuesta: [update_id, t, prefijo]
+        self.latencies = []          # s
+        self.messages = []           # (t, método, texto)
+        self.weather = Weather()
+        self.on_message = on_message
+        self.closing = False
+        handler = type("Handler", (Handler,), {"standin": self})
+        self.server = ThreadingHTTPServer(("127.0.0.1", port), handler)
+        self.server.daemon_threads = True
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+
+    def start(self):
+        self.thread.start()
+        return self
+
+    def stop(self):
+        with self.lock:
+            self.closing = True
+            self.lock.notify_all()
+        self.server.shutdown()
+        self.server.server_close()
+
+    def endpoint(self, name):
+        e = self.endpoints.get(name)
+        if e is None:
+            e = self.endpoints[name] = Endpoint()
+        return e
+
+    # ---- Telegram ----
+
+    def inject(self, text, reply_prefix=""):
+        """Mensaje del dueño; la latencia se mide hasta el primer envío que
+        empiece por reply_prefix."""
+        with self.lock:
+            uid = self.next_update
+            self.next_update += 1
+            mid = self.next_message
+            self.next_message += 1
+            now = time.time()
+            self.updates.append((uid, {
+                "update_id": uid,
+                "message": {
+                    "message_id": mid,
+                    "from": {"id": CHAT_ID, "is_bot": False, "first_name": "Dueño", "language_code": "es"},
+                    "chat": {"id": CHAT_ID, "first_name": "Dueño", "type": "private"},
+                    "date": int(now),
+                    "text": text,
+                    "entities": [{"offset": 0, "length": len(text.split()[0]), "type": "bot_command"}]
+                    if text.startswith("/") else [],
+                },
+            }))
+            self.pending.append([uid, time.monotonic(), reply_prefix])
+            self.lock.notify_all()
+            return uid
+
+    def get_updates(self, offset, limit, timeout):
+        deadline = time.monotonic() + timeout
+        with self.lock:
+            while True:
+                self.updates = [u for u in self.updates if u[0] >= offset]
+                if self.updates or self.closing:
+                    return [u[1] for u in self.updates[:limit]]
+                left = deadline - time.monotonic()
+                if left <= 0:
+                    return []
+                self.lock.wait(left)
+
+    def message(self, method, form):
+        text = form.get("text", "")
+        now = time.monotonic()
+        with self.lock:
+            self.messages.append((now, method, text))
+            for p in self.pending:
+                if text.startswith(p[2]):
+                    self.latencies.append(now - p[1])
+                    self.pending.remove(p)
+                    break
+            if method == "editMessageText":
+                mid = int(form.get("message_id", "0") or 0)
+            else:
+                mid = self.next_message
+                self.next_message += 1
+        if self.on_message:
+            self.on_message(method, text)
+        return {
+            "message_id": mid,
+            "from": {"id": 7000000001, "is_bot": True, "first_name": "Banco", "username": "banco_bot"},
+            "chat": {"id": int(form.get("chat_id", CHAT_ID) or CHAT_ID), "first_name": "Dueño", "type": "private"},
+            "date": int(time.time()),
+            "text": text,
+        }
+
+    def report(self):
+        with self.lock:
+            return {
+                "endpoints": {k: v.as_dict() for k, v in sorted(self.endpoints.items())},
+                "latencies_ms": [round(x * 1000, 1) for x in self.latencies],
+                "unanswered": len(self.pending),
+                "messages": len(self.messages),
+            }
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"     # keep-alive, como Telegram
+    server_version = "nginx"
+    sys_version = ""
+    standin = None
+
+    def setup(self):
+        super().setup()
+        # cabeceras y cuerpo van en dos write(): sin esto Nagle los separa 40 ms
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.rfile = Counting(self.rfile)
+        self.wfile = Counting(self.wfile)
+
+    def handle_one_request(self):
+        in0, out0 = self.rfile.count, self.wfile.count
+        self.endpoint_name = None
+        try:
+            super().handle_one_request()
+        except (BrokenPipeError, ConnectionResetError):
+            self.close_connection = True
+        if self.endpoint_name:
+            with self.standin.lock:
+                e = self.standin.endpoint(self.endpoint_name)
+                e.requests += 1
+                e.bytes_in += self.rfile.count - in0
+                e.bytes_out += self.wfile.count - out0
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def reply(self, code, obj):
+        body = json.dumps(obj, ensure_ascii=False, separators=(",", ":")).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        if self.close_connection:
+            self.send_header("Connection", "close")
+        self.end_headers()
+        self.wfile.write(body)
+
+    def route(self, method):
+        url = urllib.parse.urlsplit(self.path)
+        query = dict(urllib.parse.parse_qsl(url.query))
+        parts = url.path.split("/")
+        if len(parts) == 3 and parts[1].startswith("bot"):
+            self.endpoint_name = parts[2]
+            length = int(self.headers.get("Content-Length", "0") or 0)
+            form = dict(urllib.parse.parse_qsl(self.rfile.read(length).decode("utf-8", "replace"))) if length else {}
+            form.update(query)
+            if parts[2] in ("sendMessage", "editMessageText") and method == "POST":
+                return self.reply(200, {"ok": True, "result": self.standin.message(parts[2], form)})
+            if parts[2] == "getUpdates":
+                result = self.standin.get_updates(int(form.get("offset", 0) or 0), int(form.get("limit", 100) or 100),
+                                                  min(int(form.get("timeout", 0) or 0), 50))
+                return self.reply(200, {"ok": True, "result": result})
+            return self.reply(404, {"ok": False, "error_code": 404, "description": "Not Found"})
+        if url.path == "/data/2.5/group" and method == "GET":
+            self.endpoint_name = "weather/group"
+            ids = [int(x) for x in query.get("id", "").split(",") if x.isdigit()]
+            return self.reply(200, self.standin.weather.group(ids))
+        if url.path == "/data/2.5/forecast" and method == "GET":
+            self.endpoint_name = "weather/forecast"
+            cid = int(query.get("id", "0") or 0)
+            return self.reply(200, self.standin.weather.forecast(cid, min(int(query.get("cnt", "40") or 40), 40)))
+        self.endpoint_name = "other"
+        return self.reply(404, {"cod": "404", "message": "not found"})
+
+    def do_GET(self):
+        self.route("GET")
+
+    def do_POST(self):
+        self.route("POST")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=8081)
+    args = ap.parse_args()
+
+    def show(method, text):
+        print("<- %s: %s" % (method, text), flush=True)
+
+    s = StandIn(args.port, on_message=show).start()
+    print("Escuchando en 127.0.0.1:%d; escribe comandos (p. ej. /status), Ctrl-D para terminar" % args.port,
+          flush=True)
+    try:
+        for line in sys.stdin:
+            line = line.strip()
+            if line:
+                s.inject(line)
+    except KeyboardInterrupt:
+        pass
+    print(json.dumps(s.report(), indent=2, ensure_ascii=False))
+    s.stop()
+
+
+if __name__ == "__main__":
+    main()